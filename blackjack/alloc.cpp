@@ -0,0 +1,185 @@
+/** **********************************************************************
+* @file
+*
+* @brief This file contains the debug allocation counter and the alloccheck
+*        command, which confirms that the simulation runs without touching
+*        the heap once its workers have warmed up.
+************************************************************************/
+
+#include "blackjack.h"
+
+/** ***************************************************************************
+*                          Allocation Definitions
+******************************************************************************/
+
+#ifdef BJ_COUNT_ALLOCATIONS
+
+atomic<uint64_t> allocations(0); // Every call to operator new so far
+
+/** **********************************************************************
+ * @brief Replaces the global operator new so that every heap allocation
+ *        made by the program, including those of the standard library
+ *        containers, is counted.
+ *
+ * @details Array new and the nothrow forms call this one by default, so
+ *          they are counted too.
+ *
+ * @param[in] size The number of bytes requested.
+ *
+ * @returns The allocated memory.
+ ************************************************************************/
+void* operator new(size_t size)
+{
+    allocations.fetch_add(1, memory_order_relaxed);
+
+    void* memory = malloc(size > 0 ? size : 1);
+    if (memory == nullptr)
+        throw bad_alloc();
+    return memory;
+}
+
+/** **********************************************************************
+ * @brief Replaces the global operator delete to match operator new.
+ *
+ * @param[in] memory The memory to release.
+ ************************************************************************/
+void operator delete(void* memory) noexcept
+{
+    free(memory);
+}
+
+/** **********************************************************************
+ * @brief Replaces the sized global operator delete to match operator new.
+ *
+ * @param[in] memory The memory to release.
+ ************************************************************************/
+void operator delete(void* memory, size_t) noexcept
+{
+    free(memory);
+}
+
+#endif
+
+/** **********************************************************************
+ * @brief Returns whether this build counts heap allocations.
+ *
+ * @returns `true` if the program was built with BJ_COUNT_ALLOCATIONS.
+ *
+ * @par Example
+ * @code{.cpp}
+ * if (!countingAllocations())
+ *     cerr << "Allocation counting is not built in" << endl;
+ * @endcode
+ ************************************************************************/
+bool countingAllocations()
+{
+#ifdef BJ_COUNT_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+/** **********************************************************************
+ * @brief Returns the number of heap allocations made so far.
+ *
+ * @returns The count, which is always 0 unless the program was built with
+ *          BJ_COUNT_ALLOCATIONS.
+ *
+ * @par Example
+ * @code{.cpp}
+ * uint64_t before = allocationCount();
+ * @endcode
+ ************************************************************************/
+uint64_t allocationCount()
+{
+#ifdef BJ_COUNT_ALLOCATIONS
+    return allocations.load(memory_order_relaxed);
+#else
+    return 0;
+#endif
+}
+
+/** **********************************************************************
+ * @brief Runs the alloccheck command, which fails if simulated rounds
+ *        allocate once the worker has warmed up.
+ *
+ * @details One worker plays its first block as a warm-up, then plays
+ *          `--simulate` more rounds (1,000,000 by default) block by block
+ *          exactly as runWorker() does, while the allocation counter is
+ *          watched. The usual simulation options choose the shoe, rules
+ *          and shuffler being checked. The program must be built with
+ *          BJ_COUNT_ALLOCATIONS, which the Debug configurations define.
+ *
+ * @param[in] argc The number of arguments after the program name.
+ * @param[in] argv The arguments, starting with the command word.
+ *
+ * @returns 0 if no allocation happened, 1 otherwise or if the check could
+ *          not be run.
+ *
+ * @par Example
+ * @code{.cpp}
+ * return runAllocCheckCommand(argc - 1, argv + 1);
+ * @endcode
+ ************************************************************************/
+int runAllocCheckCommand(int argc, char* argv[])
+{
+    SimConfig config;
+    string resumeFile;
+    SimWorkerState state;
+    Strategy strategy;
+    uint64_t before = 0;
+
+    if (!parseSimArgs(argc, argv, config, resumeFile) || !resumeFile.empty())
+    {
+        printUsage();
+        return 1;
+    }
+    if (config.insurance != INSURANCE_NEVER || config.shardCount > 1
+        || config.precision > 0.0 || config.perfCounters
+        || !config.checkpointFile.empty() || !config.resultFile.empty()
+        || !config.transcriptFile.empty())
+    {
+        cerr << "alloccheck plays plain rounds and takes no insurance,"
+            << " shard, precision, checkpoint, result or transcript options"
+            << endl;
+        return 1;
+    }
+
+    if (!countingAllocations())
+    {
+        cerr << "alloccheck needs a build with BJ_COUNT_ALLOCATIONS defined"
+            << endl;
+        return 1;
+    }
+
+    basicStrategy(strategy);
+
+    for (uint64_t round = 0; round < config.blockRounds + config.rounds;
+        round++)
+    {
+        if (round % config.blockRounds == 0)
+        {
+            state.block = round / config.blockRounds;
+            startBlock(state, config);
+        }
+        if (round == config.blockRounds)
+            before = allocationCount();
+
+        simulateRound(state.shoe, state.engine, state.player, strategy,
+            config.bet, config.rules, state.stats);
+    }
+
+    uint64_t allocated = allocationCount() - before;
+
+    cout << "Rounds checked: " << config.rounds << " after "
+        << config.blockRounds << " warm-up rounds\n";
+    cout << "Allocations:    " << allocated << endl;
+
+    if (allocated > 0)
+    {
+        cerr << "Simulated rounds allocated from the heap" << endl;
+        return 1;
+    }
+    return 0;
+}
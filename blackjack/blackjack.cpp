@@ -32,6 +32,11 @@
 * @par Compiling Instructions:
 *      None
 *
+* @par Usage:
+*      Run without arguments to play interactively. Run with --simulate N
+*      to play N rounds automatically with basic strategy; see printUsage()
+*      for every option.
+*
 * @section todo_bugs_modification_section Modifications & Development Timeline
 *
 * @todo Implement functionality for splitting hands (up to 4 times).
@@ -60,54 +65,75 @@
  *          with options to either play a round or quit the game. The game
  *          continues until the player chooses to quit or runs out of tokens.
  *          It handles betting, shuffling a deck of cards, and playing rounds.
- *          The player's total tokens are tracked throughout the game.
+ *          The player's tokens, deck and round in progress are kept in a
+ *          GameSession, so the game can be snapshotted between any two
+ *          prompts and carried on after restoreSession().
+ *          When command line arguments are given, the game is not played
+ *          interactively and the arguments are passed to runCommand().
+ *          Otherwise cout is bound to a FrameBuffer for the whole game, so
+ *          everything shown between two prompts reaches the console in a
+ *          single write when cin flushes it.
+ *
+ * @param[in] argc The number of command line arguments.
+ * @param[in] argv The command line arguments.
  *
  * @returns 0 when the function exits upon successful completion of the game.
  *
  * @par Example
  * @code{.cpp}
- * main();
+ * main(argc, argv);
  * @endcode
  ************************************************************************/
-int main() 
+int main(int argc, char* argv[]) 
 {
+    if (argc > 1)
+        return runCommand(argc, argv);
+
     int choice;
-    queue<card> deck;
-    Player player(500); // Initialize player with 500 tokens
+    GameSession session(500); // Initialize player with 500 tokens
+    Player& player = session.player;
+    FrameBuffer screen(stdout, FRAME_BYTES);
+
+    setvbuf(stdout, nullptr, _IONBF, 0); // The frame is the only buffer
+    streambuf* console = cout.rdbuf(&screen);
 
     do 
     {
-        cout << "Total Tokens: " << player.totalTokens << endl;
-        cout << "   1) Play Round " << endl;
-        cout << "   2) Quit " << endl;
+        cout << "Total Tokens: " << player.totalTokens << "\n";
+        cout << "   1) Play Round \n";
+        cout << "   2) Quit \n";
         cout << "Enter Choice: ";
 
         while (!(cin >> choice) || choice > 2 || choice < 0) 
         {
-            cout << "Incorrect option. Please specify 1 or 2." << endl;
+            cout << "Incorrect option. Please specify 1 or 2.\n";
             cin.clear();
             cin.ignore(256, '\n');
         }
 
-        cout << endl;
+        cout << "\n";
 
         switch (choice) 
         {
             case 1:
                 betMenu(player.totalTokens, player.bet);
-                generateDeck(deck);
-                playRound(deck, player);
+                generateDeck(session.deck, randNumber());
+                dealRound(session);
+                playRound(session);
                 player.totalTokens += player.bet;
+                player.bet = 0;
                 break;
             case 2:
-                cout << "Total tokens: " << player.totalTokens << endl;
+                cout << "Total tokens: " << player.totalTokens << "\n";
                 break;
         }
     } while (choice != 2 && !(player.totalTokens < 10));
 
     if (player.totalTokens < 10)
-        cout << "Out of tokens - game over!" << endl;
+        cout << "Out of tokens - game over!\n";
 
+    cout.flush();
+    cout.rdbuf(console);
     return 0;
 }
 
@@ -136,19 +162,19 @@ void betMenu(int tokenCount, int& bet)
     bet = 0;
     do
     {
-        cout << "Total tokens: " << tokenCount << endl;
+        cout << "Total tokens: " << tokenCount << "\n";
         cout << "Your bet: ";
 
         while (!(cin >> bet) || (bet % 10) != 0 
             || bet < 10 || bet > tokenCount)
         {
             cout << "Insufficient bet. Must be a min and/or increment of 10, "
-                << "and within your total." << endl;
+                << "and within your total.\n";
             cin.clear();
             cin.ignore(256, '\n');
             // ^ clearing the false input and preparing to loop
         }
-        cout << endl;
+        cout << "\n";
     } while (bet == 0);
 }
 
@@ -160,52 +186,50 @@ void betMenu(int tokenCount, int& bet)
  *          displaying the player's and dealer's hands, presenting the player
  *          with options to hit, stand, or double down, and processing the 
  *          player's choices. It also checks for early wins and calls the 
- *          appropriate functions based on the player's actions.
- *
- * @param[in,out] deck The deck of cards being used for the game. This is 
- *                     modified during the round as cards are drawn.
- * @param[in,out] pHand The player's hand. This is modified as the player draws
- *                      cards or stands.
- * @param[in,out] dHand The dealer's hand. This is modified as cards are drawn.
- * @param[out] whoWon A reference to an integer representing the outcome of the
- *                    round. Set to 1 if the player wins, 3 if the dealer wins, 
- *                    2 if a push, or 0 if the round continues.
- * @param[in,out] player The player object, which tracks the player's tokens 
- *                       and bet.
+ *          appropriate functions based on the player's actions. Everything
+ *          the round depends on is kept in the session, so the menu carries
+ *          on from wherever a restored session left off.
+ *
+ * @param[in,out] session The session of the round, whose deck, hands,
+ *                        outcome and phase are updated as the player
+ *                        chooses. Its whoWon is set to 1 if the player
+ *                        wins, 3 if the dealer wins, 2 if a push, or left
+ *                        0 if the round continues.
+ * @param[in,out] script The recorded decisions to play instead of asking
+ *                       the player, or nullptr to read them from cin.
  *
  * @par Example
  * @code{.cpp}
- * queue<card> deck, playerHand, dealerHand;
- * int roundResult = 0;
- * Player player(500);
- * roundMenu(deck, playerHand, dealerHand, roundResult, player);
+ * GameSession session(500);
+ * roundMenu(session, nullptr);
  * @endcode
  ************************************************************************/
-void roundMenu(queue<card>& deck, queue<card>& pHand, queue<card>& dHand, 
-    int& whoWon, Player& player) 
+void roundMenu(GameSession& session, RoundScript* script) 
 {
     int choice;
-    bool initialPhase = true;
-    bool canDoubleDown = true;
 
     do 
     {
-        displayHands(dHand, pHand, initialPhase);
+        displayHands(session.dHand, session.pHand, session.initialPhase);
 
-        if (checkEarlyWin(pHand, dHand, whoWon)) 
+        if (checkEarlyWin(session.pHand, session.dHand, session.whoWon)) 
         {
-            whoWon = stand(deck, pHand, dHand, whoWon, player.bet);
+            session.whoWon = stand(session.deck, session.pHand, session.dHand,
+                session.whoWon, session.player.bet);
             return;
         }
 
         displayOptions();
 
-        if (!getValidChoice(choice)) continue;
+        if (script)
+            choice = nextScriptAction(*script);
+        else if (!getValidChoice(choice)) continue;
 
-        processChoice(choice, deck, pHand, dHand, whoWon, player, initialPhase,
-            canDoubleDown);
+        processChoice(choice, session.deck, session.pHand, session.dHand,
+            session.whoWon, session.player, session.initialPhase,
+            session.canDoubleDown, script);
 
-    } while (choice != 3 && whoWon == 0);
+    } while (choice != 3 && session.whoWon == 0);
 }
 
 /** **********************************************************************
@@ -225,20 +249,23 @@ void roundMenu(queue<card>& deck, queue<card>& pHand, queue<card>& dHand,
  *
  * @par Example
  * @code{.cpp}
- * queue<card> dealerHand, playerHand;
+ * CardQueue dealerHand, playerHand;
  * bool gamePhase = true;
  * displayHands(dealerHand, playerHand, gamePhase);
  * @endcode
  ************************************************************************/
-void displayHands(queue<card>& dHand, queue<card>& pHand, bool initialPhase) 
+void displayHands(CardQueue& dHand, CardQueue& pHand, bool initialPhase) 
 {
+    if (!cout)
+        return; // Switched off by a replay, so skip the formatting
+
     cout << "Dealer: ";
     if (initialPhase)
         displayDealerInitial(dHand);
     else
-        cout << dHand << endl;
+        cout << dHand << "\n";
 
-    cout << "Player: " << pHand << " (" << sumHand(pHand) << ")" << endl;
+    cout << "Player: " << pHand << " (" << sumHand(pHand) << ")\n";
 }
 
 /** **********************************************************************
@@ -256,10 +283,13 @@ void displayHands(queue<card>& dHand, queue<card>& pHand, bool initialPhase)
  ************************************************************************/
 void displayOptions() 
 {
-    cout << "   1) Hit " << endl;
-    cout << "   2) Double Down " << endl;
-    cout << "   3) Stand " << endl;
-    cout << "Enter Choice: ";
+    if (!cout)
+        return;
+
+    cout << "   1) Hit \n"
+        "   2) Double Down \n"
+        "   3) Stand \n"
+        "Enter Choice: ";
 }
 
 /** **********************************************************************
@@ -290,7 +320,7 @@ bool getValidChoice(int& choice)
 {
     if (!(cin >> choice) || choice < 1 || choice > 3) 
     {
-        cout << "Incorrect option. Please specify a number 1-3." << endl;
+        cout << "Incorrect option. Please specify a number 1-3.\n";
         cin.clear();
         cin.ignore(256, '\n');
         return false;
@@ -328,48 +358,50 @@ bool getValidChoice(int& choice)
  *                             dealer reveals both cards).
  * @param[in,out] canDoubleDown A boolean flag that indicates whether the 
  *                              player is allowed to double down.
+ * @param[in,out] script The recorded decisions, which supply the insurance
+ *                       choice, or nullptr to ask the player.
  *
  * @par Example
  * @code{.cpp}
- * queue<card> deck, playerHand, dealerHand;
+ * CardQueue deck, playerHand, dealerHand;
  * int roundResult = 0;
  * Player player(500);
  * bool gamePhase = true, doubleDownAllowed = true;
  * processChoice(1, deck, playerHand, dealerHand, roundResult, player,
- * gamePhase, doubleDownAllowed);
+ * gamePhase, doubleDownAllowed, nullptr);
  * @endcode
  ************************************************************************/
-void processChoice(int choice, queue<card>& deck, queue<card>& pHand, 
-    queue<card>& dHand, int& whoWon, Player& player, bool& initialPhase, 
-    bool& canDoubleDown) 
+void processChoice(int choice, CardQueue& deck, CardQueue& pHand, 
+    CardQueue& dHand, int& whoWon, Player& player, bool& initialPhase, 
+    bool& canDoubleDown, RoundScript* script) 
 {
     switch (choice) 
     {
         case 1:
             playerHit(deck, pHand, whoWon);
             canDoubleDown = false;
-            cout << endl;
+            cout << "\n";
             break;
         case 2:
             if (canDoubleDown) 
             {
                 doubleDown(deck, pHand, dHand, whoWon, player);
                 initialPhase = false;
-                cout << endl;
+                cout << "\n";
             }
             else 
             {
-                cout << endl;
-                cout << "You can't double down anymore!" << endl;
-                cout << endl;
+                cout << "\n";
+                cout << "You can't double down anymore!\n";
+                cout << "\n";
             }
             break;
         case 3:
             if (canPurchaseInsurance(dHand, player))
-                insuranceOffer(pHand, dHand, whoWon, player);
+                insuranceOffer(deck, dHand, player, script);
             whoWon = stand(deck, pHand, dHand, whoWon, player.bet);
             initialPhase = false;
-            cout << endl;
+            cout << "\n";
             break;
     }
 }
@@ -411,46 +443,42 @@ int randNumber()
  * @brief Generates a shuffled deck of 52 unique cards.
  *
  * @details This function creates a deck of 52 unique cards, ensuring each card
- *          is randomly selected without repetition. The deck is generated by
- *          using a random engine and a uniform integer distribution to select
- *          card indices. It then populates a queue with `card` objects 
- *          representing the cards, ensuring that the card values (face and 
- *          suit) are unique across the deck. The function uses a boolean 
- *          vector to track used cards and prevent duplicates.
+ *          is randomly selected without repetition. The cards are put in
+ *          order straight into the queue's buffer and then shuffled in
+ *          place with a Fisher-Yates shuffle, whose random numbers come
+ *          from the SplitMix64 mix of the seed and the step (blockSeed()).
+ *          Unlike the standard distributions, this gives the same deck for
+ *          a seed on every compiler, and it needs exactly 51 random
+ *          numbers.
  *
  * @param[out] deck The queue where the generated deck of cards is stored.
  *                  Each card is represented by a `card` object with a face 
  *                  value and suit.
+ * @param[in] seed The seed of the random engine. The same seed always
+ *                 gives the same deck, which lets recorded rounds be
+ *                 replayed.
  *
  * @par Example
  * @code{.cpp}
- * queue<card> deck;
- * generateDeck(deck); // Generates a shuffled deck and stores it in the queue
+ * CardQueue deck;
+ * generateDeck(deck, randNumber()); // Stores a shuffled deck in the queue
  * @endcode
  ************************************************************************/
-void generateDeck(queue<card>& deck)
+void generateDeck(CardQueue& deck, unsigned seed)
 {
-    card aCard;
-    vector<bool> used(52, false); // Automatically initializes all to false
-
-    // Random card generator using random engine
-    default_random_engine generator(randNumber()); //71, 184
-    uniform_int_distribution<int> distribution(0, 51);
+    deck.head = 0; // Start each round from a full deck
+    deck.count = DECK_CARDS;
 
-    for (int i = 0; i < 52; i++)
+    for (int i = 0; i < DECK_CARDS; i++)
     {
-        int cardValue = distribution(generator);
-        // Ensure cardValue is unique
-        while (used[cardValue])
-        {
-            cardValue = distribution(generator);
-        }
-
-        aCard.faceValue = (cardValue % 13) + 1; // Obtain face value
-        aCard.suit = cardValue / 13;           // Obtain suit value
-        used[cardValue] = true;                // Mark as used
-        deck.push(aCard);                      // Enqueue the unique card
+        deck.cards[i].faceValue = (i % 13) + 1; // Obtain face value
+        deck.cards[i].suit = i / 13;            // Obtain suit value
     }
+
+    // Scale the top 32 random bits to [0, i], which needs no division
+    for (int i = DECK_CARDS - 1; i > 0; i--)
+        swap(deck.cards[i],
+            deck.cards[((blockSeed(seed, i) >> 32) * (i + 1)) >> 32]);
 }
 
 /** **********************************************************************
@@ -468,39 +496,17 @@ void generateDeck(queue<card>& deck)
  *
  * @par Example
  * @code{.cpp}
- * queue<card> dealer;
+ * CardQueue dealer;
  * // Assuming dealer's queue is populated
  * displayDealerInitial(dealer); 
  * // Displays the dealer's first card in a shortened format
  * @endcode
  ************************************************************************/
 
-void displayDealerInitial(const queue<card>& dealer)
+void displayDealerInitial(const CardQueue& dealer)
 {
-    queue<card> dealerCopy = dealer;
-    card firstCard = dealerCopy.front(); // Get the first card
-
-    if (firstCard.faceValue == 1)
-        cout << "A";
-    else if (firstCard.faceValue == 11)
-        cout << "J";
-    else if (firstCard.faceValue == 12)
-        cout << "Q";
-    else if (firstCard.faceValue == 13)
-        cout << "K";
-    else
-        cout << firstCard.faceValue;
-
-    if (firstCard.suit == 0)
-        cout << "H";
-    else if (firstCard.suit == 1)
-        cout << "D";
-    else if (firstCard.suit == 2)
-        cout << "C";
-    else if (firstCard.suit == 3)
-        cout << "S";
-
-    cout << " XX" << endl;
+    writeCard(cout, dealer[0]); // Show only the first card
+    cout << " XX\n";
 }
 
 /** **********************************************************************
@@ -519,22 +525,20 @@ void displayDealerInitial(const queue<card>& dealer)
  *
  * @par Example
  * @code{.cpp}
- * queue<card> hand;
+ * CardQueue hand;
  * // Assuming hand is populated
  * int handValue = sumHand(hand); // Returns the sum of the hand's values
  * @endcode
  ************************************************************************/
-int sumHand(queue<card>& hand)
+int sumHand(const CardQueue& hand)
 {
-    queue<card> handCopy = hand; // Make a copy to iterate through
     card aCard;
     int handSum = 0;
     int aceCount = 0;
 
-    while (!handCopy.empty())
+    for (int i = 0; i < hand.size(); i++)
     {
-        aCard = handCopy.front();
-        handCopy.pop();
+        aCard = hand[i]; // Read in place rather than copying the hand
 
         if (aCard.faceValue > 10)
             aCard.faceValue = 10; // Face cards (J, Q, K) are worth 10
@@ -570,21 +574,14 @@ int sumHand(queue<card>& hand)
  *
  * @par Example
  * @code{.cpp}
- * queue<card> hand;
+ * CardQueue hand;
  * // Assuming hand is populated
  * int numCards = cardCount(hand); // Returns the total number of cards
  * @endcode
  ************************************************************************/
-int cardCount(queue<card>& hand)
+int cardCount(const CardQueue& hand)
 {
-    int cardTotal = 0;
-    queue<card> handCopy = hand;
-    while (!handCopy.empty())
-    {
-        cardTotal++;
-        handCopy.pop();
-    }
-    return cardTotal;
+    return hand.size();
 }
 
 /** **********************************************************************
@@ -607,13 +604,13 @@ int cardCount(queue<card>& hand)
  *
  * @par Example
  * @code{.cpp}
- * queue<card> player, dealer;
+ * CardQueue player, dealer;
  * // Assuming hands are populated
  * int winner;
  * bool isEarlyWin = checkEarlyWin(player, dealer, winner);
  * @endcode
  ************************************************************************/
-bool checkEarlyWin(queue<card>& player, queue<card>& dealer, int& whoWon)
+bool checkEarlyWin(CardQueue& player, CardQueue& dealer, int& whoWon)
 {
     // Check for initial 21 (Blackjack) for player or dealer
     int pSum = sumHand(player);
@@ -633,7 +630,7 @@ bool checkEarlyWin(queue<card>& player, queue<card>& dealer, int& whoWon)
         {
             whoWon = 0; // Dealer Blackjack, push at best
         }
-        cout << endl;
+        cout << "\n";
         return true;
     }
     return false;
@@ -659,12 +656,12 @@ bool checkEarlyWin(queue<card>& player, queue<card>& dealer, int& whoWon)
  *
  * @par Example
  * @code{.cpp}
- * queue<card> deck, player;
+ * CardQueue deck, player;
  * int winner;
  * playerHit(deck, player, winner);
  * @endcode
  ************************************************************************/
-void playerHit(queue<card>& deck, queue<card>& player, int& whoWon)
+void playerHit(CardQueue& deck, CardQueue& player, int& whoWon)
 {
     card deckCard = deck.front();
     deck.pop();
@@ -696,12 +693,12 @@ void playerHit(queue<card>& deck, queue<card>& player, int& whoWon)
  *
  * @par Example
  * @code{.cpp}
- * queue<card> deck, dealer;
+ * CardQueue deck, dealer;
  * int winner;
  * dealerHit(deck, dealer, winner);
  * @endcode
  ************************************************************************/
-void dealerHit(queue<card>& deck, queue<card>& dealer, int& whoWon)
+void dealerHit(CardQueue& deck, CardQueue& dealer, int& whoWon)
 {
     card deckCard = deck.front();
     deck.pop();
@@ -739,14 +736,14 @@ void dealerHit(queue<card>& deck, queue<card>& dealer, int& whoWon)
  *
  * @par Example
  * @code{.cpp}
- * queue<card> deck, player, dealer;
+ * CardQueue deck, player, dealer;
  * int winner;
  * Player p(100);
  * doubleDown(deck, player, dealer, winner, p);
  * @endcode
  ************************************************************************/
-void doubleDown(queue<card>& deck, queue<card>& pHand, 
-    queue<card>& dHand, int& whoWon, Player& player) 
+void doubleDown(CardQueue& deck, CardQueue& pHand, 
+    CardQueue& dHand, int& whoWon, Player& player) 
 {
     if (player.totalTokens >= (player.bet * 2)) 
     {
@@ -757,7 +754,7 @@ void doubleDown(queue<card>& deck, queue<card>& pHand,
             player.bet = player.bet * 2;
     }
     else
-        cout << "Not enough to double down!" << endl;
+        cout << "Not enough to double down!\n";
 }
 
 /** **********************************************************************
@@ -782,12 +779,12 @@ void doubleDown(queue<card>& deck, queue<card>& pHand,
  *
  * @par Example
  * @code{.cpp}
- * queue<card> dealerHand;
+ * CardQueue dealerHand;
  * Player p(100);
  * bool canBuy = canPurchaseInsurance(dealerHand, p);
  * @endcode
  ************************************************************************/
-bool canPurchaseInsurance(queue<card>& dHand, Player& player)
+bool canPurchaseInsurance(CardQueue& dHand, Player& player)
 {
     int pTokens = player.totalTokens;
     int pBet = player.bet;
@@ -801,71 +798,99 @@ bool canPurchaseInsurance(queue<card>& dHand, Player& player)
 }
 
 /** **********************************************************************
- * @brief Prompts the player to purchase insurance and adjusts the bet
- *        accordingly based on the dealer's hand and the outcome of the
- *        game.
+ * @brief Prompts the player to purchase insurance and settles the
+ *        insurance bet.
  *
  * @details This function displays an option to the player to purchase
- *          insurance when the dealer shows an Ace. If the player chooses
- *          to purchase insurance, the bet is adjusted based on the game
- *          result. The player's bet is either refunded, reduced, or
- *          increased depending on the dealer's hand and the game's outcome.
+ *          insurance when the dealer shows an Ace, or takes the choice from
+ *          the recorded decisions when a script is given. The offer shows
+ *          the chance of a ten in the hole, worked out from the cards the
+ *          player has not seen, and what each unit insured is worth. The
+ *          choice is then settled by applyInsurance().
  *
- * @param[in] pHand A reference to a queue of `card` objects representing
- *                  the player's hand.
+ * @param[in] deck The cards not yet dealt.
  * @param[in] dHand A reference to a queue of `card` objects representing
  *                  the dealer's hand.
- * @param[inout] whoWon A reference to an integer representing the outcome
- *                      of the round. It is updated based on the game result.
  * @param[inout] player A reference to a `Player` object representing the
- *                      player. The player's bet is modified if they purchase
- *                      insurance.
+ *                      player. The player's tokens are settled if they
+ *                      purchase insurance.
+ * @param[in,out] script The recorded decisions, or nullptr to ask the
+ *                       player.
  *
  * @par Example
  * @code{.cpp}
- * queue<card> playerHand, dealerHand;
+ * CardQueue deck, dealerHand;
  * Player p(100);
- * insuranceOffer(playerHand, dealerHand, whoWon, p);
+ * insuranceOffer(deck, dealerHand, p, nullptr);
  * @endcode
  ************************************************************************/
-void insuranceOffer(queue<card>& pHand, queue<card>& dHand, int& whoWon, 
-    Player& player)
+void insuranceOffer(const CardQueue& deck, const CardQueue& dHand,
+    Player& player, RoundScript* script)
 {
+    InsuranceEV ev = deckInsuranceEV(deck, dHand, RULES_S17);
     int choice = 0;
     do 
     {
-        cout << endl;
-        cout << "Would you like to purchase insurance? " << endl;
-        cout << "   1) Yes " << endl;
-        cout << "   2) No " << endl;
+        cout << "\n";
+        cout << "Chance of a ten in the hole: " << fixed << setprecision(1)
+            << ev.tenChance * 100.0 << "%, insurance EV "
+            << showpos << ev.insurance * 100.0 << noshowpos
+            << "% of the insurance bet" << defaultfloat << "\n";
+        cout << "Would you like to purchase insurance? \n";
+        cout << "   1) Yes \n";
+        cout << "   2) No \n";
         cout << "Enter Choice: ";
 
-        while (!(cin >> choice) || choice > 2 || choice < 0) 
+        if (script)
+            choice = script->insurance;
+        else
         {
-            cout << "Incorrect option. Please specify 1 or 2." << endl;
-            cin.clear();
-            cin.ignore(256, '\n');
+            while (!(cin >> choice) || choice > 2 || choice < 0) 
+            {
+                cout << "Incorrect option. Please specify 1 or 2.\n";
+                cin.clear();
+                cin.ignore(256, '\n');
+            }
         }
 
-        switch (choice) 
-        {
-            case 1:
-                if (whoWon == 0 && sumHand(dHand) == 21)
-                    player.bet = 0;
-                else if (whoWon == 0 && sumHand(dHand) == 21 
-                    && sumHand(pHand) == 21)
-                    player.bet = player.bet;
-                else if (whoWon == 3)
-                    player.bet = (player.bet * 3) / 2;
-                else
-                    player.bet = player.bet - player.bet / 2;
-                break;
-            case 2:
-                break;
-        }
+        applyInsurance(dHand, player, choice);
     } while (choice == 0 && player.totalTokens != 0);
 }
 
+/** **********************************************************************
+ * @brief Settles the insurance bet for the player's answer to the
+ *        insurance offer.
+ *
+ * @details Insurance is half the bet and pays 2 to 1 when the dealer's
+ *          hole card is worth ten, the same as in simulateRound(). It is
+ *          settled into the player's tokens at once, apart from the main
+ *          bet, which the round goes on to settle as usual. Declining
+ *          changes nothing.
+ *
+ * @param[in] dHand The dealer's hand, hole card second.
+ * @param[in,out] player The player, whose tokens are settled.
+ * @param[in] choice 1 if insurance was purchased, 2 if it was declined.
+ *
+ * @par Example
+ * @code{.cpp}
+ * applyInsurance(dHand, player, 1);
+ * @endcode
+ ************************************************************************/
+void applyInsurance(const CardQueue& dHand, Player& player, int choice)
+{
+    switch (choice) 
+    {
+        case 1:
+            if (cardRank(dHand[1]) == 10)
+                player.totalTokens += player.bet;
+            else
+                player.totalTokens -= player.bet / 2;
+            break;
+        case 2:
+            break;
+    }
+}
+
 /** **********************************************************************
  * @brief Determines the outcome of the player's turn by having the dealer
  *        hit until their hand value reaches 17 or higher, and then compares
@@ -896,13 +921,13 @@ void insuranceOffer(queue<card>& pHand, queue<card>& dHand, int& whoWon,
  *
  * @par Example
  * @code{.cpp}
- * queue<card> playerHand, dealerHand;
+ * CardQueue playerHand, dealerHand;
  * int whoWon = 0;
  * int bet = 50;
  * stand(deck, playerHand, dealerHand, whoWon, bet);
  * @endcode
  ************************************************************************/
-int stand(queue<card>& deck, queue<card>& pHand, queue<card>& dHand, 
+int stand(CardQueue& deck, CardQueue& pHand, CardQueue& dHand, 
     int& whoWon, int& bet)
 {
     int dBust = 0;
@@ -938,70 +963,109 @@ int stand(queue<card>& deck, queue<card>& pHand, queue<card>& dHand,
 }
 
 /** **********************************************************************
- * @brief Simulates a round of the game, where the player and dealer are
- *        dealt cards and the winner is determined based on the player's
- *        choices and the final hand values.
+ * @brief Starts a new round of a session by dealing two cards each to the
+ *        player and the dealer.
  *
- * @details This function manages the flow of a single round of the game. It
- *          deals two cards to both the player and the dealer, displays the
- *          round menu, and determines the winner based on the hand values.
- *          The player's bet is adjusted accordingly based on the outcome of
- *          the round.
+ * @details The hands left from the last round are emptied and the round's
+ *          outcome and phase are reset. The cards are dealt alternately
+ *          from the front of the deck, player first. With an empty deck
+ *          the hands stay empty and playRound() does nothing.
  *
- * @param[inout] deck A reference to a queue of `card` objects representing
- *                    the deck of cards.
- * @param[inout] player A reference to the `Player` object representing the
- *                      current player.
- *
- * @return None
+ * @param[in,out] session The session, whose bet has already been placed.
  *
  * @par Example
  * @code{.cpp}
- * queue<card> deck;
- * Player player;
- * playRound(deck, player);
+ * generateDeck(session.deck, randNumber());
+ * dealRound(session);
  * @endcode
  ************************************************************************/
-void playRound(queue<card>& deck, Player& player) 
+void dealRound(GameSession& session)
 {
-    int whoWon = 0;
     card deckCard;
-    queue<card> pHand, dHand;
 
-    if (!deck.empty()) 
+    session.pHand.clear();
+    session.dHand.clear();
+    session.whoWon = 0;
+    session.initialPhase = true;
+    session.canDoubleDown = true;
+
+    if (!session.deck.empty()) 
     {
         for (int i = 0; i < 2; i++) 
         {
-            deckCard = deck.front();
-            deck.pop();
-            pHand.push(deckCard);
+            deckCard = session.deck.front();
+            session.deck.pop();
+            session.pHand.push(deckCard);
 
-            deckCard = deck.front();
-            deck.pop();
-            dHand.push(deckCard);
+            deckCard = session.deck.front();
+            session.deck.pop();
+            session.dHand.push(deckCard);
         }
+    }
+}
+
+/** **********************************************************************
+ * @brief Plays the round in progress in a session to its end, where the
+ *        winner is determined based on the player's choices and the final
+ *        hand values.
+ *
+ * @details This function manages the flow of a single round of the game
+ *          once dealRound() has dealt it. It displays the round menu and
+ *          determines the winner based on the hand values. The player's bet
+ *          is adjusted accordingly based on the outcome of the round. A
+ *          session restored in the middle of a round carries on from its
+ *          last choice, and one whose outcome is already decided is only
+ *          settled.
+ *
+ * @param[in,out] session The session, whose bet is replaced by the tokens
+ *                        won or lost.
+ * @param[in,out] script The recorded decisions to play, or nullptr to ask
+ *                       the player through cin.
+ *
+ * @return None
+ *
+ * @par Example
+ * @code{.cpp}
+ * GameSession session(500);
+ * session.player.bet = 10;
+ * generateDeck(session.deck, randNumber());
+ * dealRound(session);
+ * playRound(session, nullptr);
+ * @endcode
+ ************************************************************************/
+void playRound(GameSession& session, RoundScript* script) 
+{
+    Player& player = session.player;
 
-        roundMenu(deck, pHand, dHand, whoWon, player);
+    if (!session.pHand.empty()) 
+    {
+        if (session.whoWon == 0)
+            roundMenu(session, script);
 
-        if (whoWon == 1) 
+        if (session.whoWon == 1) 
         {
-            if (sumHand(pHand) == 21 && cardCount(pHand) == 2)
+            if (sumHand(session.pHand) == 21 && cardCount(session.pHand) == 2)
                 player.bet = (player.bet * 3) / 2;
-            cout << "Player won" << endl;
+            cout << "Player won\n";
         }
-        else if (whoWon == 2) 
+        else if (session.whoWon == 2) 
         {
             player.bet = 0;
-            cout << "Push" << endl;
+            cout << "Push\n";
         }
-        else if (whoWon == 3) 
+        else if (session.whoWon == 3) 
         {
             player.bet *= -1;
-            cout << "Dealer won" << endl;
+            cout << "Dealer won\n";
+        }
+        if (cout)
+        {
+            cout << "Dealer: " << session.dHand << "("
+                << sumHand(session.dHand) << ")\n";
+            cout << "Player: " << session.pHand << "("
+                << sumHand(session.pHand) << ")\n";
+            cout << "\n";
         }
-        cout << "Dealer: " << dHand << "(" << sumHand(dHand) << ")" << endl;
-        cout << "Player: " << pHand << "(" << sumHand(pHand) << ")" << endl;
-        cout << endl;
     }
 }
 
@@ -1009,12 +1073,12 @@ void playRound(queue<card>& deck, Player& player)
  * @brief Overloads the << operator to print the contents of a queue of
  *        `card` objects.
  *
- * @details This function allows the `queue<card>` type to be printed to an
- *          output stream. It iterates through the queue and prints each card's
- *          face value and suit. Face values of 1, 11, 12, and 13 are replaced
- *          with "A", "J", "Q", and "K" respectively. Suits are represented
- *          by "H", "D", "C", and "S" for Hearts, Diamonds, Clubs, and
- *          Spades, respectively.
+ * @details This function allows the `CardQueue` type to be printed to an
+ *          output stream. It reads the queue in place and prints each
+ *          card's face value and suit with formatCard(). Face values of 1,
+ *          11, 12, and 13 are replaced with "A", "J", "Q", and "K"
+ *          respectively. Suits are represented by "H", "D", "C", and "S"
+ *          for Hearts, Diamonds, Clubs, and Spades, respectively.
  *
  * @param[in,out] out The output stream to which the queue of cards will be
  *                    printed.
@@ -1024,45 +1088,20 @@ void playRound(queue<card>& deck, Player& player)
  *
  * @par Example
  * @code{.cpp}
- * queue<card> cards;
+ * CardQueue cards;
  * cout << cards;
  * @endcode
  ************************************************************************/
-template<class TY>
-ostream& operator<<(ostream& out, queue<TY> q)
+ostream& operator<<(ostream& out, const CardQueue& q)
 {
-    TY data;
+    char text[DECK_CARDS * 4];
+    int length = 0;
 
-    if (q.empty())
-        return out;
-
-    while (!(q.empty()))
+    for (int i = 0; i < q.size(); i++)
     {
-        data = q.front();
-
-        if ((data.faceValue) == 1) // Changing 1 to A for Ace
-            out << "A";
-        else if ((data.faceValue) == 11) // Changing 11 to J for Jack
-            out << "J";
-        else if ((data.faceValue) == 12) // Changing 12 to Q for Queen
-            out << "Q";
-        else if ((data.faceValue) == 13) // Changing 13 to K for King
-            out << "K";
-        else
-            out << (data.faceValue); // Output the card # otherwise
-
-        if (data.suit == 0) // Suit 0 is Hearts
-            out << "H";
-        if (data.suit == 1) // Suit 1 is Diamonds
-            out << "D";
-        if (data.suit == 2) // Suit 2 is Clubs
-            out << "C";
-        if (data.suit == 3) // Suit 3 is Spades
-            out << "S";
-
-        out << " ";
-        q.pop();
+        length += formatCard(text + length, q[i]);
+        text[length++] = ' ';
     }
 
-    return out;
+    return out.write(text, length); // One write for the whole hand
 }
\ No newline at end of file
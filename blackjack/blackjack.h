@@ -16,6 +16,34 @@
 #include <sstream>
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <map>
+#include <unordered_map>
+#include <new>
+#include <cstdlib>
+#include <memory>
+#include <functional>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
 
 using namespace std;
 
@@ -45,50 +73,1559 @@ struct Player
     Player(int tokens = 500) : totalTokens(tokens), bet(0) {} 
 };
 
+const int DECK_CARDS = 52; /**< Cards in one deck */
+
+/**
+* @brief Structure that holds a first-in first-out run of cards in fixed
+* storage, used for the interactive deck and hands. It offers the parts of
+* queue<card> the game relies on, but never allocates, and its cards can be
+* read in place by position instead of by copying and popping the queue.
+*/
+struct CardQueue
+{
+    card cards[DECK_CARDS]; /**< Ring buffer holding the cards */
+    int head; /**< Index of the front card */
+    int count; /**< Number of cards held */
+
+    /**< CardQueue constructor for an empty queue */
+    CardQueue() : head(0), count(0) {}
+
+    /**< Returns whether the queue holds no cards */
+    bool empty() const { return count == 0; }
+
+    /**< Returns the number of cards held */
+    int size() const { return count; }
+
+    /**< Returns the card at the front of the queue */
+    const card& front() const { return cards[head]; }
+
+    /**< Returns the card at a position, 0 being the front */
+    const card& operator[](int i) const
+    {
+        return cards[(head + i) % DECK_CARDS];
+    }
+
+    /**< Adds a card to the back of the queue, which must not be full */
+    void push(card aCard)
+    {
+        cards[(head + count) % DECK_CARDS] = aCard;
+        count++;
+    }
+
+    /**< Removes the card at the front of the queue */
+    void pop()
+    {
+        head = (head + 1) % DECK_CARDS;
+        count--;
+    }
+
+    /**< Removes every card */
+    void clear() { head = 0; count = 0; }
+};
+
+const int MAX_SCRIPT_ACTIONS = 32; /**< Most choices a round may record */
+
+/**
+* @brief Structure that supplies the player's choices for one round from a
+* recording instead of cin. When replaying, the actions point straight into
+* the decision file. When recording, the chooser draws each choice at random
+* and it is kept in recorded.
+*/
+struct RoundScript
+{
+    const unsigned char* actions; /**< Menu choices in the order asked */
+    int actionCount; /**< Number of choices available or recorded */
+    int nextAction; /**< Index of the next choice to play */
+    int insurance; /**< 1 to buy insurance when offered, 2 to decline */
+    bool failed; /**< Set when the game asked for a choice not recorded */
+    mt19937_64* chooser; /**< Random source when recording, else nullptr */
+    unsigned char recorded[MAX_SCRIPT_ACTIONS]; /**< Choices made recording */
+
+    /**< RoundScript constructor for an empty script */
+    RoundScript() : actions(recorded), actionCount(0), nextAction(0),
+        insurance(2), failed(false), chooser(nullptr), recorded() {}
+};
+
+/**
+* @brief Structure that holds everything needed to carry on an interactive
+* session: the player, the deck being dealt, both hands and the phase of the
+* round in progress.
+*/
+struct GameSession
+{
+    Player player; /**< The player's tokens and current bet */
+    CardQueue deck; /**< Cards not yet dealt, next card at the front */
+    CardQueue pHand; /**< The player's hand */
+    CardQueue dHand; /**< The dealer's hand, upcard first */
+    int whoWon; /**< 0 while the round goes on, else 1 win, 2 push, 3 loss */
+    bool initialPhase; /**< Whether the dealer's hole card is still hidden */
+    bool canDoubleDown; /**< Whether the player may still double down */
+
+    /**< GameSession constructor for a player waiting for a round */
+    GameSession(int tokens = 500) : player(tokens), whoWon(0),
+        initialPhase(true), canDoubleDown(true) {}
+};
 
 void betMenu(int tokenCount, int& bet);
 
-void roundMenu(queue<card>& deck, queue<card>& pHand, queue<card>& dHand,
-    int& whoWon, Player& player);
+void roundMenu(GameSession& session, RoundScript* script = nullptr);
 
-void displayHands(queue<card>& dHand, queue<card>& pHand, bool initialPhase);
+void displayHands(CardQueue& dHand, CardQueue& pHand, bool initialPhase);
 
 void displayOptions();
 
 bool getValidChoice(int& choice);
 
-void processChoice(int choice, queue<card>& deck, queue<card>& pHand,
-    queue<card>& dHand, int& whoWon, Player& player, bool& initialPhase,
-    bool& canDoubleDown);
+void processChoice(int choice, CardQueue& deck, CardQueue& pHand,
+    CardQueue& dHand, int& whoWon, Player& player, bool& initialPhase,
+    bool& canDoubleDown, RoundScript* script = nullptr);
 
 int randNumber();
 
-void generateDeck(queue<card>& deck);
+void generateDeck(CardQueue& deck, unsigned seed);
 
-void displayDealerInitial(const queue<card>& dealer);
+void displayDealerInitial(const CardQueue& dealer);
 
-int sumHand(queue<card>& hand);
+int sumHand(const CardQueue& hand);
 
-int cardCount(queue<card>& hand);
+int cardCount(const CardQueue& hand);
 
-bool checkEarlyWin(queue<card>& pHand, queue<card>& dHand, int& whoWon);
+bool checkEarlyWin(CardQueue& pHand, CardQueue& dHand, int& whoWon);
 
-void playerHit(queue<card>& deck, queue<card>& pHand, int& whoWon);
+void playerHit(CardQueue& deck, CardQueue& pHand, int& whoWon);
 
-void dealerHit(queue<card>& deck, queue<card>& dHand, int& whoWon);
+void dealerHit(CardQueue& deck, CardQueue& dHand, int& whoWon);
 
-void doubleDown(queue<card>& deck, queue<card>& pHand, queue<card>& dHand,
+void doubleDown(CardQueue& deck, CardQueue& pHand, CardQueue& dHand,
     int& whoWon, Player& player);
 
-bool canPurchaseInsurance(queue<card>& dHand, Player& player);
+bool canPurchaseInsurance(CardQueue& dHand, Player& player);
+
+void insuranceOffer(const CardQueue& deck, const CardQueue& dHand,
+    Player& player, RoundScript* script = nullptr);
 
-void insuranceOffer(queue<card>& pHand, queue<card>& dHand, int& whoWon,
-    Player& player);
+void applyInsurance(const CardQueue& dHand, Player& player, int choice);
 
-int stand(queue<card>& deck, queue<card>& pHand, queue<card>& dHand,
+int stand(CardQueue& deck, CardQueue& pHand, CardQueue& dHand,
     int& whoWon, int& bet);
 
-void playRound(queue<card>& deck, Player& player);
+void dealRound(GameSession& session);
+
+void playRound(GameSession& session, RoundScript* script = nullptr);
+
+ostream& operator<<(ostream& out, const CardQueue& q);
+
+/** ***************************************************************************
+*                     Renderer Declarations and Prototypes
+******************************************************************************/
+
+const size_t FRAME_BYTES = 1 << 12; /**< Room for any console screen */
+
+/**
+* @brief Stream buffer that collects everything written to it in storage
+* allocated once, and hands it to a C stream in a single write when the
+* stream is flushed or the buffer fills. Bound to cout it turns each console
+* screen into one frame, since cin flushes cout only before reading input.
+*/
+struct FrameBuffer : public streambuf
+{
+    vector<char> storage; /**< The frame being built */
+    FILE* target; /**< Where finished frames are written */
+    mutex* lock; /**< Held while writing to a shared target, or nullptr */
+    bool failed; /**< Set once any write has failed */
+
+    /**< FrameBuffer constructor that allocates the whole buffer */
+    FrameBuffer(FILE* out, size_t capacity, mutex* writeLock = nullptr);
+
+    /**< FrameBuffer destructor that writes out the last frame */
+    ~FrameBuffer();
+
+    bool writeFrame();
+
+    void makeRoom(size_t reserve);
+
+    int overflow(int c) override;
+
+    int sync() override;
+};
+
+/**
+* @brief Structure that holds the transcript file shared by every worker of
+* a simulation, together with the lock that keeps their writes whole.
+*/
+struct TranscriptFile
+{
+    FILE* file; /**< The open transcript, or nullptr when none is written */
+    mutex lock; /**< Held by a worker while it writes a frame */
+    atomic<bool> failed; /**< Set once any worker's write has failed */
+
+    /**< TranscriptFile constructor for a run without a transcript */
+    TranscriptFile() : file(nullptr), failed(false) {}
+};
+
+int formatCard(char* text, card aCard);
+
+void writeCard(ostream& out, card aCard);
+
+bool openTranscript(TranscriptFile& transcript, const string& fileName);
+
+/** ***************************************************************************
+*                    Simulation Declarations and Prototypes
+******************************************************************************/
+
+const int ACTION_HIT = 1;          /**< Matches menu choice 1 (Hit) */
+const int ACTION_DOUBLE = 2;       /**< Double down, otherwise hit */
+const int ACTION_STAND = 3;        /**< Matches menu choice 3 (Stand) */
+const int ACTION_DOUBLE_STAND = 4; /**< Double down, otherwise stand */
+
+const int MAX_HAND_CARDS = 22; /**< No legal hand can hold more cards */
+
+const int RULES_S17 = 0; /**< Dealer stands on soft 17, as stand() does */
+const int RULES_H17 = 1; /**< Dealer hits soft 17 */
+const int RULE_VARIANTS = 2; /**< Number of dealer rule variants */
+
+const int INSURANCE_NEVER = 0; /**< Insurance and even money always declined */
+const int INSURANCE_PERFECT = 1; /**< Taken whenever the unseen cards
+                                       favour it */
+
+const int SIM_ENGINE_VERSION = 1; /**< Bumped whenever results change */
+const uint64_t PRECISION_ROUND_LIMIT = 1000000000000ULL; /**< Precision cap */
+const uint64_t WAVE_BLOCKS = 64; /**< Blocks between precision checks */
+
+const int RANKS = 10; /**< Card ranks by value, ace through ten */
+const int MAX_RANK_COUNT = 8 * 16; /**< Ten-value cards in an 8-deck shoe */
+
+/**
+* @brief Structure that holds how many cards of each rank remain, together
+* with a Zobrist hash of those counts that is updated as cards come and go.
+* Copying it is a cheap snapshot, and it can be used directly as the key of
+* an unordered_map with CompositionHash.
+*/
+struct Composition
+{
+    int counts[RANKS]; /**< Remaining cards by rank, index 0 for aces */
+    int remaining; /**< Total remaining cards */
+    uint64_t hash; /**< XOR of the Zobrist keys of every rank's count */
+
+    /**< Composition constructor for an empty shoe */
+    Composition();
+};
+
+/**
+* @brief Structure that hashes a Composition for unordered containers by
+* returning its precomputed Zobrist hash.
+*/
+struct CompositionHash
+{
+    /**< Returns the composition's hash */
+    size_t operator()(const Composition& composition) const
+    {
+        return (size_t)composition.hash;
+    }
+};
+
+bool operator==(const Composition& first, const Composition& second);
+
+/**
+* @brief Structure that models a continuous shuffling machine. Returned cards
+* are dropped into randomly chosen slots, and whenever the delivery tray runs
+* low a random slot's stack is released onto it. Cards are dealt from the
+* tray.
+*/
+struct ShuffleMachine
+{
+    int slotCount; /**< Number of slots, 0 when no machine is used */
+    int slotCapacity; /**< Cards each slot can hold */
+    vector<card> slots; /**< Slot stacks, slotCapacity cards per slot */
+    vector<int> slotSizes; /**< Cards currently held by each slot */
+    vector<int> filled; /**< Indices of the slots that hold cards */
+    vector<int> filledIndex; /**< Position of each slot in filled, or -1 */
+    vector<card> tray; /**< Ring buffer of cards waiting to be dealt */
+    int trayHead; /**< Index of the next card in the tray */
+    int trayCount; /**< Cards in the tray */
+
+    /**< ShuffleMachine constructor for a shoe without a machine */
+    ShuffleMachine() : slotCount(0), slotCapacity(0), trayHead(0),
+        trayCount(0) {}
+};
+
+/**
+* @brief Structure that represents a multi-deck shoe dealt in a fixed order,
+* along with the Hi-Lo running count of the cards already dealt from it. The
+* shoe can instead feed a continuous shuffling machine, in which case the
+* cards are dealt from the machine and returned to it after every round.
+*/
+struct Shoe
+{
+    vector<card> cards; /**< Every card in the shoe, in dealing order */
+    int position; /**< Index of the next card to be dealt */
+    int decks; /**< Number of 52-card decks in the shoe */
+    int cutCard; /**< Position at which the shoe is reshuffled */
+    int runningCount; /**< Hi-Lo running count of the dealt cards */
+    Composition composition; /**< Ranks of the cards not yet dealt */
+    bool continuous; /**< Whether a continuous shuffling machine is used */
+    ShuffleMachine machine; /**< The shuffling machine, if used */
+    const unsigned char* recorded; /**< Recorded shoes dealt in place of
+                                        shuffles, or nullptr */
+    uint32_t recordedShoes; /**< Number of recorded shoes */
+    uint32_t nextShoe; /**< Recorded shoe loaded by the next shuffle */
+
+    /**< Shoe constructor with a single deck dealt to 75% penetration */
+    Shoe(int deckCount = 1, double penetration = 0.75, int machineSlots = 0);
+};
+
+/**
+* @brief Structure that holds the cards and running total of one hand during
+* a headless (simulated) round.
+*/
+struct SimHand
+{
+    card cards[MAX_HAND_CARDS]; /**< Cards in the order they were dealt */
+    int count; /**< Number of cards held */
+    int total; /**< Hand total, matching sumHand() */
+    int softAces; /**< Aces still counted as 11 */
+
+    /**< SimHand constructor for an empty hand */
+    SimHand() : count(0), total(0), softAces(0) {}
+};
+
+/**
+* @brief Structure that holds a basic strategy chart. Entries are ACTION_*
+* codes indexed by the hand total and the dealer's upcard (1 = Ace, 10 = any
+* ten-value card).
+*/
+struct Strategy
+{
+    int hard[22][11]; /**< Actions for hard totals */
+    int soft[22][11]; /**< Actions for soft totals */
+};
+
+/**
+* @brief Structure that accumulates the results of simulated rounds. Every
+* field is an integer so that partial results can be merged in any order
+* and still produce identical totals.
+*/
+struct SimStats
+{
+    uint64_t rounds; /**< Rounds played */
+    uint64_t wins; /**< Rounds won by the player */
+    uint64_t pushes; /**< Rounds pushed */
+    uint64_t losses; /**< Rounds lost by the player */
+    uint64_t blackjacks; /**< Rounds won with a natural 21 */
+    uint64_t doubles; /**< Rounds where the player doubled down */
+    int64_t wagered; /**< Sum of the initial bets */
+    int64_t net; /**< Sum of the per-round net results */
+    uint64_t netSquares; /**< Sum of the squared per-round net results */
+
+    /**< SimStats constructor with every total cleared */
+    SimStats() : rounds(0), wins(0), pushes(0), losses(0), blackjacks(0),
+        doubles(0), wagered(0), net(0), netSquares(0) {}
+};
+
+/**
+* @brief Structure that holds the parameters of a simulation run. Rounds are
+* grouped into fixed-size blocks, and each block draws from its own random
+* stream, so results do not depend on the number of threads.
+*/
+struct SimConfig
+{
+    uint64_t rounds; /**< Total rounds to simulate */
+    uint64_t blockRounds; /**< Rounds per independently seeded block */
+    uint64_t seed; /**< Master seed for every block's random stream */
+    int threads; /**< Worker threads */
+    int decks; /**< Decks in the shoe */
+    double penetration; /**< Fraction of the shoe dealt before a shuffle */
+    int bet; /**< Flat bet placed every round */
+    int bankroll; /**< Tokens each block's player starts with */
+    int machineSlots; /**< Shuffling machine slots, 0 for a dealt shoe */
+    int rules; /**< Dealer rule variant, RULES_S17 or RULES_H17 */
+    int insurance; /**< Insurance policy, INSURANCE_NEVER or _PERFECT */
+    bool perfCounters; /**< Whether to profile the run with counters */
+    double precision; /**< Margin of error that ends the run, 0 for none */
+    uint64_t shardIndex; /**< Slice of the blocks this process plays */
+    uint64_t shardCount; /**< Number of slices the blocks are split into */
+    string checkpointFile; /**< Checkpoint destination, empty for none */
+    int checkpointSeconds; /**< Seconds between checkpoints */
+    string resultFile; /**< Mergeable result destination, empty for none */
+    string transcriptFile; /**< Round log destination, empty for none */
+
+    /**< SimConfig constructor with the default run parameters */
+    SimConfig() : rounds(1000000), blockRounds(10000), seed(1),
+        threads((int)max(1u, thread::hardware_concurrency())), decks(6),
+        penetration(0.75), bet(10),
+        bankroll(1000000), machineSlots(0), rules(RULES_S17),
+        insurance(INSURANCE_NEVER), perfCounters(false), precision(0.0),
+        shardIndex(0), shardCount(1),
+        checkpointSeconds(60) {}
+};
+
+/**
+* @brief Structure that holds everything one simulation worker needs to
+* continue from where it left off.
+*/
+struct SimWorkerState
+{
+    uint64_t block; /**< Block currently being played */
+    uint64_t blockRound; /**< Rounds already played in that block */
+    bool done; /**< True once the worker has no blocks left */
+    mt19937_64 engine; /**< Random stream of the current block */
+    Shoe shoe; /**< Shoe of the current block */
+    Player player; /**< Player of the current block */
+    SimStats stats; /**< Totals of every round the worker finished */
+
+    /**< SimWorkerState constructor for a worker that has not started */
+    SimWorkerState() : block(0), blockRound(0), done(false) {}
+};
+
+/**
+* @brief Structure that double-buffers a worker's published state. The worker
+* only ever writes the slot that is not at the front, and skips a publish
+* rather than wait if the checkpoint writer still holds that slot.
+*/
+struct SnapshotBuffer
+{
+    SimWorkerState slots[2]; /**< Front and back copies of the state */
+    mutex locks[2]; /**< Guards each slot while it is copied */
+    atomic<int> front; /**< Index of the most recently published slot */
+
+    /**< SnapshotBuffer constructor with slot 0 at the front */
+    SnapshotBuffer() : front(0) {}
+};
+
+/**
+* @brief Structure that holds the workers of a run with a precision target at
+* each wave boundary. A worker may not start a block beyond the current wave
+* until every worker has reached it; the last one to arrive checks the
+* margin of error of all rounds so far and either ends the run or opens the
+* next wave. The totals checked therefore always cover the same blocks.
+*/
+struct WaveGate
+{
+    uint64_t waveEnd; /**< First block of the next wave */
+    int active; /**< Workers that still have blocks to play */
+    int waiting; /**< Workers waiting at the current boundary */
+    uint64_t generation; /**< Incremented each time a wave is checked */
+    bool stop; /**< Whether the precision target has been reached */
+    vector<SimWorkerState>* workers; /**< Every worker, for the check */
+    mutex lock; /**< Guards everything in the gate */
+    condition_variable released; /**< Signalled after each check */
+
+    /**< WaveGate constructor for a gate that has not been set up */
+    WaveGate() : waveEnd(0), active(0), waiting(0), generation(0),
+        stop(false), workers(nullptr) {}
+};
+
+int runCommand(int argc, char* argv[]);
+
+void printUsage();
+
+bool parseCount(const char* text, uint64_t& value);
+
+bool parseReal(const char* text, double& value);
+
+bool parseShard(const char* text, uint64_t& index, uint64_t& count);
+
+bool parseRules(const char* text, int& rules);
+
+bool parseSimOption(const string& option, const char* value,
+    SimConfig& config);
+
+bool parseSimArgs(int argc, char* argv[], SimConfig& config,
+    string& resumeFile);
+
+/** **********************************************************************
+ * @brief Derives the seed of one block's random stream.
+ *
+ * @details The master seed and block index are mixed with the SplitMix64
+ *          finalizer, so neighbouring blocks receive unrelated streams
+ *          and any block can be replayed without playing the ones
+ *          before it. It is defined inline here because the interactive
+ *          deck shuffle also draws its random numbers from it, one call
+ *          per card.
+ *
+ * @param[in] seed The master seed of the run.
+ * @param[in] block The block index.
+ *
+ * @returns The seed for that block's Mersenne Twister engine.
+ *
+ * @par Example
+ * @code{.cpp}
+ * mt19937_64 engine(blockSeed(42, 7));
+ * @endcode
+ ************************************************************************/
+inline uint64_t blockSeed(uint64_t seed, uint64_t block)
+{
+    uint64_t z = seed + 0x9E3779B97F4A7C15ULL * (block + 1);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+uint64_t randBelow(mt19937_64& engine, uint64_t bound);
+
+void resetShoe(Shoe& shoe, double penetration);
+
+void shuffleShoe(Shoe& shoe, mt19937_64& engine);
+
+card drawCard(Shoe& shoe, mt19937_64& engine);
+
+int hiLoValue(card aCard);
+
+int trueCountBucket(const Shoe& shoe);
+
+int cardRank(card aCard);
+
+uint64_t zobristKey(int rank, int count);
+
+void fillComposition(Composition& composition, int decks);
+
+void removeRank(Composition& composition, int rank);
+
+void addRank(Composition& composition, int rank);
+
+void rebuildComposition(Shoe& shoe);
+
+void loadMachine(Shoe& shoe, mt19937_64& engine);
+
+void returnCard(Shoe& shoe, mt19937_64& engine, card aCard);
+
+void returnHand(Shoe& shoe, mt19937_64& engine, const SimHand& hand);
+
+void releaseSlot(ShuffleMachine& machine, mt19937_64& engine);
+
+card machineDraw(Shoe& shoe, mt19937_64& engine);
+
+void addCard(SimHand& hand, card aCard);
+
+void basicStrategy(Strategy& strategy);
+
+int strategyAction(const Strategy& strategy, const SimHand& hand,
+    int upcard, bool canDoubleDown);
+
+int dealerPlay(Shoe& shoe, mt19937_64& engine, SimHand& dHand, int rules);
+
+int settleHands(SimHand& pHand, SimHand& dHand);
+
+int simulateRound(Shoe& shoe, mt19937_64& engine, Player& player,
+    const Strategy& strategy, int bet, int rules, SimStats& stats,
+    ostream* transcript = nullptr, RoundScript* script = nullptr,
+    int insurance = INSURANCE_NEVER);
+
+ostream& operator<<(ostream& out, const SimHand& hand);
+
+void writeRoundLog(ostream& transcript, const SimHand& pHand,
+    const SimHand& dHand, int whoWon, int net);
+
+void mergeStats(SimStats& total, const SimStats& part);
+
+void startBlock(SimWorkerState& state, const SimConfig& config);
+
+void runWorker(SimWorkerState& state, const SimConfig& config,
+    const Strategy& strategy, SnapshotBuffer* snapshots, WaveGate* gate,
+    TranscriptFile* transcript);
+
+uint64_t firstWaveEnd(const SimConfig& config,
+    const vector<SimWorkerState>& workers);
+
+bool waitForWave(WaveGate& gate, const SimConfig& config,
+    const SimWorkerState& state);
+
+void checkWave(WaveGate& gate, const SimConfig& config);
+
+void leaveWave(WaveGate& gate, const SimConfig& config);
+
+SimStats runSimulation(const SimConfig& config,
+    vector<SimWorkerState>& workers, TranscriptFile* transcript = nullptr);
+
+double houseEdge(const SimStats& stats);
+
+double edgeMargin(const SimStats& stats);
+
+void printSimReport(const SimStats& stats, const SimConfig& config);
+
+void publishSnapshot(SnapshotBuffer& snapshots, const SimWorkerState& state,
+    bool wait);
+
+void writeStats(ostream& out, const SimStats& stats);
+
+bool readStats(istream& in, SimStats& stats);
+
+void writeWorkerState(ostream& out, const SimWorkerState& state);
+
+bool readWorkerState(istream& in, SimWorkerState& state);
+
+void writeMachine(ostream& out, const ShuffleMachine& machine);
+
+bool readMachine(istream& in, ShuffleMachine& machine, int shoeSize);
+
+bool saveCheckpoint(const string& fileName, const SimConfig& config,
+    vector<SnapshotBuffer>& snapshots);
+
+bool loadCheckpoint(const string& fileName, SimConfig& config,
+    vector<SimWorkerState>& workers);
+
+void checkpointLoop(const SimConfig& config, vector<SnapshotBuffer>& snapshots,
+    mutex& doneLock, condition_variable& doneSignal, bool& allDone);
+
+bool saveResult(const string& fileName, const SimConfig& config,
+    const SimStats& stats);
+
+bool loadResult(const string& fileName, SimConfig& config, SimStats& stats);
+
+bool sameRun(const SimConfig& first, const SimConfig& second);
+
+int runMergeCommand(int argc, char* argv[]);
+
+/** ***************************************************************************
+*                  Index Play Declarations and Prototypes
+******************************************************************************/
+
+const int TC_MIN = -10; /**< Lowest true count bucket */
+const int TC_MAX = 10; /**< Highest true count bucket */
+const int TC_BUCKETS = TC_MAX - TC_MIN + 1; /**< Number of true count buckets */
+
+const int CELL_HIT_STAND = 0; /**< Cell compares standing with hitting */
+const int CELL_DOUBLE = 1; /**< Cell compares doubling with not doubling */
+const int CELL_INSURANCE = 2; /**< Cell compares insuring with not insuring */
+
+/**
+* @brief Structure that accumulates, per true count bucket, the results of
+* each action tried from one player-total by dealer-upcard cell. Results are
+* kept as integer sums of the net units won so that partial results merge
+* identically in any order.
+*/
+struct IndexCell
+{
+    int kind; /**< CELL_HIT_STAND, CELL_DOUBLE or CELL_INSURANCE */
+    int total; /**< Player hand total */
+    bool soft; /**< Whether the player's total is soft */
+    int upcard; /**< Dealer upcard value (1 = Ace, 10 = ten-value) */
+    bool cached; /**< Whether the results came from the cache file */
+    uint64_t samples[TC_BUCKETS]; /**< Samples played in each bucket */
+    int64_t stand[TC_BUCKETS]; /**< Net units from standing */
+    int64_t hit[TC_BUCKETS]; /**< Net units from hitting */
+    int64_t doubled[TC_BUCKETS]; /**< Net units from doubling or insuring */
+
+    /**< IndexCell constructor for a cell with no samples yet */
+    IndexCell(int cellKind = CELL_HIT_STAND, int cellTotal = 0,
+        bool cellSoft = false, int cellUpcard = 0);
+};
+
+/**
+* @brief Structure that deals the undealt part of a shoe while skipping the
+* cards already placed in an index cell's starting position.
+*/
+struct CellDeck
+{
+    const Shoe* shoe; /**< The shoe being dealt, which is never modified */
+    int position; /**< Index of the next card to consider */
+    int skip[3]; /**< Positions of the cell's cards, in ascending order */
+    int skipCount; /**< Number of positions to skip */
+};
+
+int runIndexCommand(int argc, char* argv[]);
+
+void buildIndexCells(vector<IndexCell>& cells);
+
+string indexCacheKey(const SimConfig& config);
+
+void loadIndexCache(const string& fileName, const string& key,
+    vector<IndexCell>& cells);
+
+bool saveIndexCache(const string& fileName, const string& key,
+    const vector<IndexCell>& cells);
+
+int cellRanks(const IndexCell& cell, int ranks[3]);
+
+int chooseCellCards(const IndexCell& cell, int start,
+    const vector<int> rankPositions[10], const uint64_t picks[3],
+    CellDeck& deck);
+
+card cellDraw(CellDeck& deck);
+
+int playCellAction(CellDeck deck, const IndexCell& cell,
+    const Strategy& strategy, int action);
+
+void sampleIndexCells(Shoe& shoe, mt19937_64& engine,
+    const Strategy& strategy, vector<IndexCell>& cells,
+    vector<int> rankPositions[10]);
+
+void runIndexWorker(int worker, const SimConfig& config,
+    vector<IndexCell>& cells);
+
+void mergeIndexCell(IndexCell& total, const IndexCell& part);
+
+bool findIndex(const IndexCell& cell, double& index, bool& rising);
+
+void printIndexTable(const vector<IndexCell>& cells);
+
+/** ***************************************************************************
+*                 Infinite Deck Declarations and Prototypes
+******************************************************************************/
+
+const int DEALER_NATURAL = 5; /**< Outcome index of a dealer two-card 21 */
+const int DEALER_BUST = 6; /**< Outcome index of a dealer bust */
+const int DEALER_OUTCOMES = 7; /**< 17 through 21, natural and bust */
+
+/**
+* @brief Structure that holds the infinite-deck tables of one rule variant:
+* the dealer's final total distribution by upcard and the player's standing
+* and hitting EVs by total and upcard. Upcards are indexed 1 (Ace) through
+* 10, and totals by their value.
+*/
+struct EvTables
+{
+    double dealer[11][DEALER_OUTCOMES]; /**< Final total probabilities */
+    double stand[22][11]; /**< EV of standing on a total */
+    double hardHit[22][11]; /**< EV of hitting a hard total, then playing on */
+    double softHit[22][11]; /**< EV of hitting a soft total, then playing on */
+};
+
+double dealerOutcome(int rules, int upcard, int outcome);
+
+double standEV(int rules, int total, int upcard);
+
+double hitEV(int rules, int total, bool soft, int upcard);
+
+int bestAction(int rules, int total, bool soft, int upcard);
+
+int runEvCommand(int argc, char* argv[]);
+
+/** ***************************************************************************
+*                      Sweep Declarations and Prototypes
+******************************************************************************/
+
+/**
+* @brief Structure that tracks the blocks of a run shared out block by block
+* to worker threads, such as a sweep cell or a daemon job. Blocks finish in
+* any order, but only the unbroken run of finished blocks from block 0 is
+* counted, so the totals and the stopping point do not depend on timing.
+*/
+struct BlockRun
+{
+    uint64_t blocks; /**< Blocks in the run if it is never stopped early */
+    uint64_t nextBlock; /**< Next block to hand to a worker */
+    uint64_t doneBlocks; /**< Blocks counted in stats, all from block 0 */
+    SimStats stats; /**< Totals of the counted blocks */
+    map<uint64_t, SimStats> pending; /**< Finished blocks not yet counted */
+
+    /**< BlockRun constructor for a run that has not started */
+    BlockRun() : blocks(0), nextBlock(0), doneBlocks(0) {}
+};
+
+/**
+* @brief Structure that holds a bet ramp: the bet placed at each true count
+* bucket from TC_MIN to TC_MAX.
+*/
+struct BetRamp
+{
+    int bets[TC_BUCKETS]; /**< Bet by true count, TC_MIN first */
+
+    /**< BetRamp constructor for a flat bet */
+    BetRamp(int bet = 10)
+    {
+        for (int b = 0; b < TC_BUCKETS; b++)
+            bets[b] = bet;
+    }
+};
+
+/**
+* @brief Structure that tracks one cell of a parameter sweep.
+*/
+struct SweepCell
+{
+    SimConfig config; /**< Parameters of this cell */
+    string rampText; /**< Bet ramp from the grid, empty for a flat bet */
+    BetRamp ramp; /**< The bet at each true count when rampText is set */
+    string key; /**< Text of every parameter that affects the results */
+    uint64_t hash; /**< Hash of the key, used as the cache key */
+    BlockRun run; /**< The cell's blocks and their totals */
+    bool finished; /**< Whether the cell needs no more blocks */
+    bool cached; /**< Whether the results came from the cache file */
+
+    /**< SweepCell constructor for a cell that has not started */
+    SweepCell() : hash(0), finished(false), cached(false) {}
+};
+
+/**
+* @brief Structure that holds the shared queue of a sweep. Workers take the
+* next block of the earliest unfinished cell, so every core stays busy until
+* the last cell is done, and finished cells are written out right away.
+*/
+struct SweepQueue
+{
+    vector<SweepCell> cells; /**< Every cell of the grid, in grid order */
+    double precision; /**< Margin of error that stops a cell, 0 for none */
+    size_t firstOpen; /**< No cell before this one has blocks to hand out */
+    mutex lock; /**< Guards everything in the queue */
+    condition_variable changed; /**< Signalled whenever a block finishes */
+    ofstream cacheFile; /**< Cache that finished cells are appended to */
+    ofstream outFile; /**< Report that finished cells are appended to */
+
+    /**< SweepQueue constructor for an empty sweep */
+    SweepQueue() : precision(0.0), firstOpen(0) {}
+};
+
+int runSweepCommand(int argc, char* argv[]);
+
+bool readSweepGrid(const string& fileName, vector<SweepCell>& grid,
+    double& precision);
+
+string sweepKey(const SimConfig& config, double precision,
+    const string& ramp = "");
+
+uint64_t hashText(const string& text);
+
+bool loadSweepCache(const string& fileName, vector<SweepCell>& cells);
+
+void finishSweepCell(SweepQueue& queue, SweepCell& cell);
+
+uint64_t runBlocks(const SimConfig& config);
+
+bool blockAvailable(const BlockRun& run, double precision);
+
+bool countRunBlock(BlockRun& run, uint64_t block, const SimStats& stats,
+    double precision);
+
+bool nextSweepBlock(SweepQueue& queue, size_t& cell, uint64_t& block);
+
+void countSweepBlock(SweepQueue& queue, size_t cell, uint64_t block,
+    const SimStats& stats);
+
+SimStats playBlock(SimWorkerState& state, const SimConfig& config,
+    const Strategy& strategy, uint64_t block,
+    const BetRamp* ramp = nullptr);
+
+SimStats playBlock(const SimConfig& config, const Strategy& strategy,
+    uint64_t block);
+
+void runSweepWorker(SweepQueue& queue, const Strategy& strategy);
+
+void writeSweepLine(ostream& out, const SweepCell& cell);
+
+/** ***************************************************************************
+*                  Exact Enumeration Declarations and Prototypes
+******************************************************************************/
+
+/**
+* @brief Structure that holds the chance of each way the dealer's hand can
+* finish. A 21 is also broken down by the number of cards in the hand,
+* since settleHands() compares card counts when both hands hold 21.
+*/
+struct DealerDist
+{
+    double bust; /**< Chance the dealer busts */
+    double totals[5]; /**< Chance of finishing on 17 through 21 */
+    double twentyOne[MAX_HAND_CARDS + 1]; /**< Chance of 21 by card count */
+
+    /**< DealerDist constructor with every chance at zero */
+    DealerDist() : bust(0.0), totals(), twentyOne() {}
+};
+
+/**
+* @brief Structure that holds the exact result of a position: the expected
+* net result per unit bet and the chance the round is won, pushed or lost.
+*/
+struct ExactOutcome
+{
+    double ev; /**< Expected net result per unit of initial bet */
+    double win; /**< Chance the player wins */
+    double push; /**< Chance of a push */
+    double loss; /**< Chance the player loses */
+
+    /**< ExactOutcome constructor with every value at zero */
+    ExactOutcome() : ev(0.0), win(0.0), push(0.0), loss(0.0) {}
+};
+
+/**
+* @brief Structure that identifies a memoized position: the composition of
+* the undealt cards together with a packed description of the hands.
+*/
+struct ExactKey
+{
+    Composition composition; /**< Undealt cards */
+    int state; /**< Packed hand totals, softness, card count and upcard */
+};
+
+/**
+* @brief Structure that hashes an ExactKey from the composition's Zobrist
+* hash and the packed state.
+*/
+struct ExactKeyHash
+{
+    /**< Returns the key's hash */
+    size_t operator()(const ExactKey& key) const
+    {
+        return (size_t)(key.composition.hash
+            ^ ((uint64_t)key.state * 0x9E3779B97F4A7C15ULL));
+    }
+};
+
+bool operator==(const ExactKey& first, const ExactKey& second);
+
+/**
+* @brief Structure that holds one worker's memoization tables. Each worker
+* keeps its own, so no locking is needed while enumerating.
+*/
+struct ExactMemo
+{
+    const Strategy* strategy; /**< The chart the player follows */
+    int rules; /**< Dealer rule variant, RULES_S17 or RULES_H17 */
+    unordered_map<ExactKey, DealerDist, ExactKeyHash> dealer; /**< Dealer */
+    unordered_map<ExactKey, ExactOutcome, ExactKeyHash> player; /**< Player */
+};
+
+int runExactCommand(int argc, char* argv[]);
+
+card rankCard(int rank);
+
+int handState(const SimHand& hand, int upcard);
+
+DealerDist dealerDist(Composition& composition, const SimHand& dHand,
+    ExactMemo& memo);
+
+ExactOutcome standResult(const DealerDist& dist, const SimHand& pHand);
+
+ExactOutcome playerOutcome(Composition& composition, const SimHand& pHand,
+    const SimHand& dHand, bool firstAction, ExactMemo& memo);
+
+void addOutcome(ExactOutcome& total, const ExactOutcome& part,
+    double weight);
+
+void runExactWorker(const Composition& start, const Strategy& strategy,
+    int rules, atomic<int>& nextDeal, vector<ExactOutcome>& deals);
+
+/** ***************************************************************************
+*                    Allocation Declarations and Prototypes
+******************************************************************************/
+
+bool countingAllocations();
+
+uint64_t allocationCount();
+
+int runAllocCheckCommand(int argc, char* argv[]);
+
+/** ***************************************************************************
+*                      Replay Declarations and Prototypes
+******************************************************************************/
+
+/**
+* @brief Structure that holds a whole file in memory, mapped read-only where
+* the system allows it and read into a buffer otherwise.
+*/
+struct MappedFile
+{
+    const unsigned char* data; /**< The file's bytes */
+    size_t size; /**< Length of the file */
+    bool mapped; /**< Whether data must be unmapped rather than freed */
+    vector<unsigned char> buffer; /**< The file's bytes when not mapped */
+
+    /**< MappedFile constructor for no file */
+    MappedFile() : data(nullptr), size(0), mapped(false) {}
+};
+
+uint64_t readLittle(const unsigned char* bytes, int count);
+
+void writeLittle(ostream& out, uint64_t value, int count);
+
+bool mapFile(const string& fileName, MappedFile& file);
+
+void unmapFile(MappedFile& file);
+
+int nextScriptAction(RoundScript& script);
+
+void playScriptedRound(GameSession& session, RoundScript& script,
+    unsigned seed, int bet);
+
+int runRecordCommand(int argc, char* argv[]);
+
+int runReplayCommand(int argc, char* argv[]);
+
+/** ***************************************************************************
+*                   Strategy Chart Declarations and Prototypes
+******************************************************************************/
+
+bool parseChartAction(const string& text, int& action);
+
+bool readStrategyChart(istream& in, Strategy& strategy);
+
+void writeStrategyChart(ostream& out, const Strategy& strategy);
+
+bool loadStrategyChart(const string& fileName, Strategy& strategy);
+
+int runChartCommand(int argc, char* argv[]);
+
+/** ***************************************************************************
+*                      What-if Declarations and Prototypes
+******************************************************************************/
+
+/**
+* @brief Structure that holds a recorded history: every shoe in the order it
+* was dealt, followed by the original player's bet and choices for each
+* round. The file is mapped once and read in place by every replay.
+*/
+struct History
+{
+    MappedFile file; /**< The history file */
+    int decks; /**< Decks in each shoe */
+    int rules; /**< Dealer rule variant, RULES_S17 or RULES_H17 */
+    int cutCard; /**< Position at which each shoe was reshuffled */
+    int bankroll; /**< Tokens the player started with */
+    uint32_t shoeCount; /**< Number of recorded shoes */
+    uint64_t roundCount; /**< Number of recorded rounds */
+    const unsigned char* shoes; /**< One byte per card, shoe after shoe */
+    const unsigned char* rounds; /**< The round records */
+    size_t roundBytes; /**< Length of the round records */
+
+    /**< History constructor for no history */
+    History() : decks(0), rules(RULES_S17), cutCard(0), bankroll(0),
+        shoeCount(0), roundCount(0), shoes(nullptr), rounds(nullptr),
+        roundBytes(0) {}
+};
+
+/**
+* @brief Structure that holds one strategy and bet ramp to try against a
+* history, and the totals of its replay.
+*/
+struct WhatIfCandidate
+{
+    string name; /**< Chart file and ramp, as given on the command line */
+    Strategy strategy; /**< The chart the player follows */
+    BetRamp ramp; /**< The bet at each true count, 0 for the original's */
+    bool recordedChoices; /**< Replays the original bets and choices */
+    SimStats stats; /**< Totals of the replay */
+    string problem; /**< Why a replay of the original failed, or empty */
+
+    /**< WhatIfCandidate constructor for a flat-betting candidate */
+    WhatIfCandidate() : ramp(0), recordedChoices(false) {}
+};
+
+int runHistoryCommand(int argc, char* argv[]);
+
+void saveShoe(vector<unsigned char>& shoes, const Shoe& shoe);
+
+int runWhatIfCommand(int argc, char* argv[]);
+
+bool loadHistory(const string& fileName, History& history);
+
+void loadRecordedShoe(Shoe& shoe);
+
+bool parseBetRamp(const char* text, BetRamp& ramp);
+
+int rampBet(const BetRamp& ramp, const Shoe& shoe);
+
+void replayHistory(const History& history, WhatIfCandidate& candidate);
+
+void runWhatIfWorker(const History& history,
+    vector<WhatIfCandidate>& candidates, atomic<size_t>& next);
+
+/** ***************************************************************************
+*                     Learning Declarations and Prototypes
+******************************************************************************/
+
+const int LEARN_STATES = 22 * 2 * 11 * 2; /**< Total, soft, upcard, double */
+const int LEARN_ACTIONS = 3; /**< Hit, double down and stand */
+const int64_t LEARN_SCALE = 1 << 20; /**< Fixed-point units per bet */
+
+/**
+* @brief Structure that holds the shared Q-table: the estimated value, in
+* bets, of each action in each decision state, and how often it has been
+* tried. States are numbered by learnState() and actions by their ACTION_*
+* code minus one.
+*/
+struct QTable
+{
+    double values[LEARN_STATES][LEARN_ACTIONS]; /**< Estimated values */
+    uint64_t visits[LEARN_STATES][LEARN_ACTIONS]; /**< Times each was tried */
+
+    /**< QTable constructor with every value and visit cleared */
+    QTable() : values(), visits() {}
+};
+
+/**
+* @brief Structure that holds one actor's learning targets for an epoch. The
+* targets are kept in fixed point so that the actors' tables add up to the
+* same totals in any order.
+*/
+struct QSums
+{
+    int64_t targets[LEARN_STATES][LEARN_ACTIONS]; /**< Sums of the targets */
+    uint64_t visits[LEARN_STATES][LEARN_ACTIONS]; /**< Targets summed */
+
+    /**< QSums constructor with every sum cleared */
+    QSums() : targets(), visits() {}
+};
+
+int runLearnCommand(int argc, char* argv[]);
+
+int learnState(int total, bool soft, int upcard, bool canDoubleDown);
+
+double bestValue(const QTable& table, int state, bool canDoubleDown);
+
+void addTarget(QSums& sums, int state, int action, double target);
+
+void learnRound(Shoe& shoe, mt19937_64& engine, int rules,
+    const QTable& table, QSums& sums);
+
+void runLearnWorker(const SimConfig& config, uint64_t epoch, int worker,
+    const QTable& table, QSums& sums);
+
+double updateQTable(QTable& table, const vector<QSums>& actors);
+
+void learnedStrategy(const QTable& table, Strategy& strategy);
+
+/** ***************************************************************************
+*                     Side Bet Declarations and Prototypes
+******************************************************************************/
+
+const int SIDE_PERFECT_PAIRS = 0; /**< Pair in the player's two cards */
+const int SIDE_21_PLUS_3 = 1; /**< Poker hand of player cards and upcard */
+const int SIDE_LUCKY_LADIES = 2; /**< Player's two cards totalling 20 */
+const int SIDE_BETS = 3; /**< Number of side bets */
+const int SIDE_BATCH = 1024; /**< Deals scored together */
+const int SIDE_CARDS = 52; /**< Distinct cards, by face value and suit */
+
+/**
+* @brief Structure that holds the side bet lookup tables, indexed by
+* sideIndex() of each card, which are worked out at compile time.
+*/
+struct SideTables
+{
+    short pairs[SIDE_CARDS][SIDE_CARDS]; /**< Perfect Pairs net result */
+    short ladies[SIDE_CARDS][SIDE_CARDS]; /**< Lucky Ladies net result when
+                                               the dealer has no natural */
+    bool straights[1 << 14]; /**< Whether a mask of three face value bits
+                                  makes a straight */
+};
+
+/**
+* @brief Structure that holds the opening cards of many rounds for scoring
+* together. Each row holds one card of every deal, in dealing order: the
+* player's first card, the dealer's upcard, the player's second card and the
+* dealer's hole card.
+*/
+struct SideBatch
+{
+    unsigned char cards[4][SIDE_BATCH]; /**< sideIndex() of each card */
+    unsigned char buckets[SIDE_BATCH]; /**< True count bucket of each deal */
+    int count; /**< Deals held */
+
+    /**< SideBatch constructor for an empty batch */
+    SideBatch() : count(0) {}
+};
+
+/**
+* @brief Structure that accumulates side bet results by true count bucket.
+* Every field is an integer, so that workers' totals merge exactly.
+*/
+struct SideStats
+{
+    uint64_t rounds[TC_BUCKETS]; /**< Deals scored */
+    int64_t net[SIDE_BETS][TC_BUCKETS]; /**< Sum of net results per bet */
+    uint64_t netSquares[SIDE_BETS][TC_BUCKETS]; /**< Sum of squared results */
+
+    /**< SideStats constructor with every total cleared */
+    SideStats() : rounds(), net(), netSquares() {}
+};
+
+int runSideBetCommand(int argc, char* argv[]);
+
+int sideIndex(card aCard);
+
+bool parseCard(const string& text, card& aCard);
+
+int twentyOnePlusThree(int first, int second, int upcard);
+
+bool dealerNatural(int upcard, int hole);
+
+void addDeal(SideBatch& batch, const Shoe& shoe);
+
+void scoreSideBatch(SideBatch& batch, SideStats& stats);
+
+void runSideBetWorker(const SimConfig& config, int worker,
+    SideStats& stats);
+
+void exactSideBets(const int counts[SIDE_CARDS], double edges[SIDE_BETS]);
+
+/** ***************************************************************************
+*                     Insurance Declarations and Prototypes
+******************************************************************************/
+
+/**
+* @brief Structure that holds the value of the offers made against a dealer
+* ace, worked out from the cards the player has not seen.
+*/
+struct InsuranceEV
+{
+    double tenChance; /**< Chance of a ten-value hole card */
+    double insurance; /**< EV per unit insured, positive when worth taking */
+    double evenMoney; /**< EV per unit bet of taking even money over
+                           declining it, or a bound with the same sign,
+                           positive when worth taking */
+};
+
+void followDealerDraws(Composition& unseen, const SimHand& dHand, int rules,
+    int cards, double& made, double& other);
+
+void dealerDraw21Bounds(Composition& unseen, int rules, int cards,
+    double& low, double& high);
+
+double dealerDraw21Chance(Composition& unseen, int rules);
+
+InsuranceEV insuranceEV(Composition& unseen, bool natural, int rules);
+
+InsuranceEV deckInsuranceEV(const CardQueue& deck, const CardQueue& dHand,
+    int rules);
+
+InsuranceEV shoeInsuranceEV(const Shoe& shoe, const SimHand& dHand,
+    bool natural, int rules);
+
+bool parseInsurance(const char* text, int& insurance);
+
+/** ***************************************************************************
+*                      Session Declarations and Prototypes
+******************************************************************************/
+
+const int SESSION_IMAGE_BYTES = 128; /**< Size of one session image */
+
+/**
+* @brief Structure that holds a session as a flat image with every field at
+* a fixed offset, so it can be copied and read in place without parsing.
+* Cards are stored as their face value plus 16 times their suit.
+*/
+struct SessionImage
+{
+    int32_t totalTokens; /**< The player's total tokens */
+    int32_t bet; /**< The player's current bet */
+    int32_t whoWon; /**< The round's outcome so far */
+    uint8_t initialPhase; /**< 1 while the hole card is hidden */
+    uint8_t canDoubleDown; /**< 1 while the player may double down */
+    uint8_t deckCount; /**< Cards left in the deck */
+    uint8_t playerCount; /**< Cards in the player's hand */
+    uint8_t dealerCount; /**< Cards in the dealer's hand */
+    uint8_t deck[DECK_CARDS]; /**< The deck, next card first */
+    uint8_t player[MAX_HAND_CARDS]; /**< The player's cards */
+    uint8_t dealer[MAX_HAND_CARDS]; /**< The dealer's cards */
+    uint8_t reserved[SESSION_IMAGE_BYTES - 17 - DECK_CARDS
+        - 2 * MAX_HAND_CARDS]; /**< Unused, always zero */
+};
+
+int packCards(uint8_t* bytes, const CardQueue& queue, int capacity);
+
+bool unpackCards(CardQueue& queue, const uint8_t* bytes, int count);
+
+void snapshotSession(const GameSession& session, SessionImage& image);
+
+bool restoreSession(const SessionImage& image, GameSession& session);
+
+bool sameSession(const GameSession& first, const GameSession& second);
+
+bool saveSessionFile(const string& fileName,
+    const vector<SessionImage>& images);
+
+bool findSessionImages(const MappedFile& file, const SessionImage*& images,
+    uint64_t& count);
+
+GameSession randomSession(mt19937_64& chooser);
+
+bool playsOnAlike(GameSession& first, GameSession& second, uint64_t seed);
+
+int runSessionCommand(int argc, char* argv[]);
+
+/** ***************************************************************************
+*                     Lockstep Declarations and Prototypes
+******************************************************************************/
+
+const int LOCKSTEP_LANES = 32; /**< Games played together on one thread */
+
+/**
+* @brief Structure that holds a batch of games played in lockstep, one per
+* lane. Each field of the round is an array with one entry per lane, and the
+* masks hold 0 or 1. Shoes are kept as card ranks, 1 (Ace) through 10.
+*/
+struct LockstepBatch
+{
+    int32_t pos[LOCKSTEP_LANES]; /**< Deal position in each lane's shoe */
+    int32_t pTotal[LOCKSTEP_LANES]; /**< Player hand totals */
+    int32_t pSoft[LOCKSTEP_LANES]; /**< Player aces counted as 11 */
+    int32_t pCount[LOCKSTEP_LANES]; /**< Player hand sizes */
+    int32_t dTotal[LOCKSTEP_LANES]; /**< Dealer hand totals */
+    int32_t dSoft[LOCKSTEP_LANES]; /**< Dealer aces counted as 11 */
+    int32_t dCount[LOCKSTEP_LANES]; /**< Dealer hand sizes */
+    int32_t upcard[LOCKSTEP_LANES]; /**< Dealer upcards, 1 through 10 */
+    int32_t tokens[LOCKSTEP_LANES]; /**< Each lane's player tokens */
+    int32_t active[LOCKSTEP_LANES]; /**< Mask of lanes playing a block */
+    int32_t acting[LOCKSTEP_LANES]; /**< Mask of hands still drawing */
+    int32_t hitting[LOCKSTEP_LANES]; /**< Mask of hands taking a card */
+    int32_t canDouble[LOCKSTEP_LANES]; /**< Mask of first decisions */
+    int32_t doubled[LOCKSTEP_LANES]; /**< Mask of doubled hands */
+    uint64_t block[LOCKSTEP_LANES]; /**< Block each lane is playing */
+    uint64_t roundsLeft[LOCKSTEP_LANES]; /**< Rounds left in that block */
+    mt19937_64 engines[LOCKSTEP_LANES]; /**< Each block's random stream */
+    uint8_t chart[2][22][11]; /**< Actions by softness, total and upcard */
+    vector<uint8_t> shoes; /**< Every lane's shoe, shoeSize + 1 ranks each */
+    int shoeSize; /**< Cards in each shoe */
+    int cutCard; /**< Position at which a shoe is reshuffled */
+
+    /**< LockstepBatch constructor for a batch with no shoes */
+    LockstepBatch() : shoeSize(0), cutCard(0) {}
+};
+
+/**
+* @brief Returns the ranks of one lane's shoe, followed by a spare rank that
+* masked lanes may read past the end.
+*/
+inline uint8_t* laneShoe(LockstepBatch& batch, int lane)
+{
+    return batch.shoes.data() + (size_t)lane * (batch.shoeSize + 1);
+}
+
+void shuffleLane(LockstepBatch& batch, int lane);
+
+void startLane(LockstepBatch& batch, int lane, uint64_t block,
+    const SimConfig& config);
+
+void prepareBatch(LockstepBatch& batch, const SimConfig& config,
+    const Strategy& strategy);
+
+void drawLanes(LockstepBatch& batch, int32_t* total, int32_t* soft,
+    int32_t* count, const int32_t* mask);
+
+bool anyLane(const int32_t* mask);
+
+void playLockstepRound(LockstepBatch& batch, const SimConfig& config,
+    SimStats& stats);
+
+void runLockstepWorker(const SimConfig& config, const Strategy& strategy,
+    int worker, SimStats& stats);
+
+SimStats runLockstep(const SimConfig& config, const Strategy& strategy);
+
+bool sameStats(const SimStats& first, const SimStats& second);
+
+int runLockstepCommand(int argc, char* argv[]);
+
+/** ***************************************************************************
+*                     Daemon Declarations and Prototypes
+******************************************************************************/
+
+const int JOB_QUEUED = 0; /**< Job waiting for its first block */
+const int JOB_RUNNING = 1; /**< Job with blocks handed to workers */
+const int JOB_DONE = 2; /**< Job whose totals are final */
+const int JOB_CANCELLED = 3; /**< Job stopped by a client */
+
+/**
+* @brief Structure that tracks one job of the simulation daemon. Like a sweep
+* cell, it is played as a BlockRun, so its totals do not depend on how many
+* jobs share the workers.
+*/
+struct DaemonJob
+{
+    int id; /**< Number the job is known by to clients */
+    int priority; /**< Higher priorities are served first */
+    SimConfig config; /**< Parameters of the run */
+    double precision; /**< Margin of error that stops the job, 0 for none */
+    Strategy strategy; /**< Chart the player follows */
+    string key; /**< Text of every parameter that affects the results */
+    uint64_t hash; /**< Hash of the key, used as the cache key */
+    BlockRun run; /**< The job's blocks and their totals */
+    int state; /**< One of the JOB_* codes */
+    bool cached; /**< Whether the results came from the cache */
+
+    /**< DaemonJob constructor for a job that has not been submitted */
+    DaemonJob() : id(0), priority(0), precision(0.0), hash(0),
+        state(JOB_QUEUED), cached(false) {}
+};
+
+/**
+* @brief Structure that holds the daemon's jobs, its open jobs in the order
+* they are served and its cache of finished results, all behind one lock.
+*/
+struct JobQueue
+{
+    map<int, shared_ptr<DaemonJob>> jobs; /**< Every job, by number */
+    vector<DaemonJob*> open; /**< Unfinished jobs, highest priority first */
+    unordered_map<uint64_t, SimStats> cache; /**< Finished totals, by hash */
+    unordered_map<uint64_t, int> running; /**< Open job of each hash */
+    int nextId; /**< Number of the next job submitted */
+    int connections; /**< Connections still being served */
+    bool stopping; /**< Set once a shutdown has been requested */
+    mutex lock; /**< Guards everything in the queue */
+    condition_variable work; /**< Signalled when blocks may be available */
+    condition_variable progress; /**< Signalled whenever a job changes */
+    ofstream cacheFile; /**< Cache that finished jobs are appended to */
+
+    /**< JobQueue constructor for a daemon with no jobs */
+    JobQueue() : nextId(1), connections(0), stopping(false) {}
+};
+
+string parseJobSpec(const vector<string>& words, DaemonJob& job,
+    string& chart);
+
+string jobKey(const DaemonJob& job, const string& chart);
+
+string jobStatus(const DaemonJob& job);
+
+void finishJob(JobQueue& queue, DaemonJob& job);
+
+string submitJob(JobQueue& queue, const DaemonJob& job);
+
+bool nextJobBlock(JobQueue& queue, shared_ptr<DaemonJob>& job,
+    uint64_t& block);
+
+void countJobBlock(JobQueue& queue, DaemonJob& job, uint64_t block,
+    const SimStats& stats);
+
+string cancelJob(JobQueue& queue, int id);
+
+void runDaemonWorker(JobQueue& queue);
+
+bool loadJobCache(const string& fileName, JobQueue& queue);
+
+void handleRequest(JobQueue& queue, const string& request,
+    const function<bool(const string&)>& reply);
+
+#ifndef _WIN32
+bool socketAddress(const string& path, sockaddr_un& address);
+
+bool writeAll(int handle, const string& text);
+
+void serveConnection(JobQueue& queue, int handle);
+#endif
+
+int runDaemonCommand(int argc, char* argv[]);
+
+int runJobCommand(int argc, char* argv[]);
+
+/** ***************************************************************************
+*                      Variance Declarations and Prototypes
+******************************************************************************/
+
+void runSampleWorker(const SimConfig& config, const Strategy& strategy,
+    int worker, vector<SimStats>& samples);
+
+double sampleMargin(const vector<SimStats>& samples);
+
+int runVarianceCommand(int argc, char* argv[]);
+
+/** ***************************************************************************
+*                Performance Counter Declarations and Prototypes
+******************************************************************************/
+
+const int PHASE_OTHER = 0; /**< Everything outside the named phases */
+const int PHASE_SHUFFLE = 1; /**< shuffleShoe() */
+const int PHASE_SCORING = 2; /**< addCard() and settleHands() */
+const int PHASE_DEALER = 3; /**< dealerPlay(), apart from its scoring */
+const int PHASES = 4; /**< Number of phases */
+
+const int COUNTER_CYCLES = 0; /**< CPU cycles */
+const int COUNTER_INSTRUCTIONS = 1; /**< Instructions retired */
+const int COUNTER_BRANCH_MISSES = 2; /**< Mispredicted branches */
+const int COUNTER_L1D_MISSES = 3; /**< Level 1 data cache read misses */
+const int COUNTER_LLC_MISSES = 4; /**< Last level cache read misses */
+const int COUNTER_TASK_CLOCK = 5; /**< Nanoseconds on the CPU */
+const int COUNTER_EVENTS = 6; /**< Number of counted events */
+
+/**
+* @brief Structure that holds one thread's group of performance counters and
+* the counts of each phase of a round so far. Each phase is counted in a play
+* of its own, with the group running only while that phase is.
+*/
+struct PerfCounters
+{
+    int handles[COUNTER_EVENTS]; /**< Counter of each event, -1 if missing */
+    int slots[COUNTER_EVENTS]; /**< Place of each event in a group read */
+    int leader; /**< Counter that leads the group, -1 before any opened */
+    int opened; /**< Number of events in the group */
+    string problem; /**< Why some events are missing, or empty */
+    int phase; /**< Phase running now, one of the PHASE_* codes */
+    int target; /**< Phase counted in this play, -1 for none */
+    uint64_t lastAllocations; /**< Allocations when the target was entered */
+    double counts[PHASES][COUNTER_EVENTS]; /**< Counts of each phase */
+    uint64_t allocations[PHASES]; /**< Allocations of each phase */
+    uint64_t entries[PHASES]; /**< Times the group was started for each */
+    double switchCost[COUNTER_EVENTS]; /**< Counts of one start and stop */
+    bool resolved[PHASES][COUNTER_EVENTS]; /**< Counts above the switch cost */
+
+    /**< PerfCounters constructor with nothing opened or counted */
+    PerfCounters() : leader(-1), opened(0), phase(PHASE_OTHER), target(-1),
+        lastAllocations(0), counts(), allocations(), entries(), switchCost(),
+        resolved()
+    {
+        fill(handles, handles + COUNTER_EVENTS, -1);
+        fill(slots, slots + COUNTER_EVENTS, -1);
+    }
+};
+
+extern thread_local PerfCounters* phaseCounters;
+
+void switchPhase(PerfCounters& counters, int phase) noexcept;
+
+#ifdef BJ_PROFILE_PHASES
+/**
+* @brief Structure that charges the work of one scope to a phase while a
+* profile is being recorded on this thread, and costs one test otherwise.
+* The phase that was running before is restored when the scope ends.
+*/
+struct PhaseScope
+{
+    int previous; /**< Phase to go back to, or -1 when not profiling */
+
+    /**< PhaseScope constructor that enters a phase */
+    PhaseScope(int phase) : previous(-1)
+    {
+        if (phaseCounters)
+        {
+            previous = phaseCounters->phase;
+            switchPhase(*phaseCounters, phase);
+        }
+    }
+
+    /**< PhaseScope destructor that goes back to the previous phase */
+    ~PhaseScope()
+    {
+        if (previous >= 0)
+            switchPhase(*phaseCounters, previous);
+    }
+};
+#else
+/**
+* @brief Structure that marks a phase of a round. Phases are only profiled
+* in builds with BJ_PROFILE_PHASES, since even the test for a profile slows
+* the hottest functions, so here it does nothing.
+*/
+struct PhaseScope
+{
+    /**< PhaseScope constructor that ignores the phase */
+    PhaseScope(int) {}
+};
+#endif
+
+bool profilingPhases();
+
+bool openPerfCounters(PerfCounters& counters);
+
+void closePerfCounters(PerfCounters& counters);
+
+void enablePerfCounters(PerfCounters& counters, bool enable);
+
+void runPerfCounters(const PerfCounters& counters, bool run);
+
+void readPerfCounters(const PerfCounters& counters,
+    double values[COUNTER_EVENTS]);
+
+void measureSwitchCost(PerfCounters& counters);
+
+void removeSwitchCost(PerfCounters& counters);
+
+SimStats playRunInOrder(const SimConfig& config, const Strategy& strategy);
+
+SimStats playPhase(PerfCounters& counters, const SimConfig& config,
+    const Strategy& strategy, int phase);
+
+void writePerfLine(const string& name, const double counts[COUNTER_EVENTS],
+    uint64_t allocations, const PerfCounters& counters, uint64_t rounds,
+    const bool resolved[COUNTER_EVENTS] = nullptr);
 
-template<class TY>
-ostream& operator<<(ostream& out, queue<TY> q);
+int runPerfProfile(const SimConfig& config);
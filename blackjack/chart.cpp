@@ -0,0 +1,209 @@
+/** **********************************************************************
+* @file
+*
+* @brief This file contains the definitions for reading and writing
+*        strategy charts as text files, so that strategies other than the
+*        built-in basic strategy can be tried.
+*
+* @details A chart file has one line per hand, such as
+*          "hard 11  D D D D D D D D D H" or "soft 18  S Ds Ds Ds Ds S S H H H".
+*          The hand is "hard" with a total from 4 to 21 or "soft" with a
+*          total from 12 to 21, and the ten actions are for a dealer
+*          upcard of 2 through 9, ten and ace, in that order. The actions
+*          are H (hit), S (stand), D (double down, otherwise hit) and Ds
+*          (double down, otherwise stand). Text after a '#' is ignored, and
+*          hands that are not listed keep their basic strategy action.
+************************************************************************/
+
+#include "blackjack.h"
+
+/** ***************************************************************************
+*                          Strategy Chart Definitions
+******************************************************************************/
+
+/** **********************************************************************
+ * @brief Reads one action of a chart file.
+ *
+ * @param[in] text The action text.
+ * @param[out] action The matching ACTION_* code.
+ *
+ * @returns `true` if the text is H, S, D or Ds.
+ *
+ * @par Example
+ * @code{.cpp}
+ * int action;
+ * parseChartAction("Ds", action);
+ * @endcode
+ ************************************************************************/
+bool parseChartAction(const string& text, int& action)
+{
+    if (text == "H")
+        action = ACTION_HIT;
+    else if (text == "S")
+        action = ACTION_STAND;
+    else if (text == "D")
+        action = ACTION_DOUBLE;
+    else if (text == "Ds")
+        action = ACTION_DOUBLE_STAND;
+    else
+        return false;
+    return true;
+}
+
+/** **********************************************************************
+ * @brief Reads a strategy chart in the chart file format.
+ *
+ * @details Only the hands listed are changed, so the chart should be
+ *          filled with a starting strategy first.
+ *
+ * @param[in,out] in The stream to read.
+ * @param[in,out] strategy The chart to update.
+ *
+ * @returns `true` if every line was understood.
+ *
+ * @par Example
+ * @code{.cpp}
+ * Strategy strategy;
+ * basicStrategy(strategy);
+ * readStrategyChart(file, strategy);
+ * @endcode
+ ************************************************************************/
+bool readStrategyChart(istream& in, Strategy& strategy)
+{
+    string line;
+
+    while (getline(in, line))
+    {
+        istringstream fields(line.substr(0, line.find('#')));
+        string hand, value;
+        int total = 0;
+        int actions[10];
+
+        if (!(fields >> hand))
+            continue;
+        if ((hand != "hard" && hand != "soft") || !(fields >> total)
+            || total > 21 || total < (hand == "hard" ? 4 : 12))
+            return false;
+
+        for (int column = 0; column < 10; column++)
+            if (!(fields >> value) || !parseChartAction(value,
+                actions[column]))
+                return false;
+        if (fields >> value)
+            return false;
+
+        for (int column = 0; column < 10; column++)
+        {
+            int upcard = column == 9 ? 1 : column + 2;
+
+            if (hand == "hard")
+                strategy.hard[total][upcard] = actions[column];
+            else
+                strategy.soft[total][upcard] = actions[column];
+        }
+    }
+    return in.eof();
+}
+
+/** **********************************************************************
+ * @brief Writes every hand of a strategy chart in the chart file format.
+ *
+ * @param[in,out] out The stream to write to.
+ * @param[in] strategy The chart.
+ *
+ * @par Example
+ * @code{.cpp}
+ * writeStrategyChart(cout, strategy);
+ * @endcode
+ ************************************************************************/
+void writeStrategyChart(ostream& out, const Strategy& strategy)
+{
+    const char* names[] = { "", "H", "D", "S", "Ds" };
+
+    out << "# H hit, S stand, D double or hit, Ds double or stand\n"
+        << "#        2  3  4  5  6  7  8  9  T  A\n";
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        bool soft = (pass == 1);
+
+        for (int total = soft ? 12 : 4; total <= 21; total++)
+        {
+            out << (soft ? "soft " : "hard ") << setw(2) << total << "  ";
+            for (int column = 0; column < 10; column++)
+            {
+                int upcard = column == 9 ? 1 : column + 2;
+                int action = soft ? strategy.soft[total][upcard]
+                    : strategy.hard[total][upcard];
+
+                out << left << setw(column == 9 ? 0 : 3) << names[action]
+                    << right;
+            }
+            out << "\n";
+        }
+    }
+}
+
+/** **********************************************************************
+ * @brief Loads a strategy chart file on top of basic strategy.
+ *
+ * @param[in] fileName The chart file, or "basic" for basic strategy
+ *                     alone.
+ * @param[out] strategy The chart.
+ *
+ * @returns `true` if the file was read and every line was understood.
+ *
+ * @par Example
+ * @code{.cpp}
+ * Strategy strategy;
+ * loadStrategyChart("aggressive.chart", strategy);
+ * @endcode
+ ************************************************************************/
+bool loadStrategyChart(const string& fileName, Strategy& strategy)
+{
+    basicStrategy(strategy);
+    if (fileName == "basic")
+        return true;
+
+    ifstream file(fileName);
+    return file && readStrategyChart(file, strategy);
+}
+
+/** **********************************************************************
+ * @brief Runs the chart command, which prints basic strategy in the chart
+ *        file format, or checks a chart file and prints it in full.
+ *
+ * @details The output is a complete chart file, which makes a starting
+ *          point for writing a new one.
+ *
+ * @param[in] argc The number of arguments after the program name.
+ * @param[in] argv The arguments, starting with the command word.
+ *
+ * @returns 0 if the chart was printed, 1 if it could not be read.
+ *
+ * @par Example
+ * @code{.cpp}
+ * return runChartCommand(argc - 1, argv + 1);
+ * @endcode
+ ************************************************************************/
+int runChartCommand(int argc, char* argv[])
+{
+    Strategy strategy;
+    string fileName = argc == 2 ? argv[1] : "basic";
+
+    if (argc > 2)
+    {
+        printUsage();
+        return 1;
+    }
+
+    if (!loadStrategyChart(fileName, strategy))
+    {
+        cerr << "Unable to read chart " << fileName << endl;
+        return 1;
+    }
+
+    writeStrategyChart(cout, strategy);
+    cout.flush();
+    return 0;
+}
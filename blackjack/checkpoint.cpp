@@ -0,0 +1,448 @@
+/** **********************************************************************
+* @file
+*
+* @brief This file contains the definitions for checkpointing a running
+*        simulation to disk and restoring it, so that an interrupted run
+*        can be resumed with results identical to an uninterrupted one.
+************************************************************************/
+
+#include "blackjack.h"
+
+/** ***************************************************************************
+*                           Checkpoint Definitions
+******************************************************************************/
+
+const int CHECKPOINT_VERSION = 2; // Bumped whenever the layout changes
+
+/** **********************************************************************
+ * @brief Publishes a copy of a worker's state to its snapshot buffer.
+ *
+ * @details The state is copied into the slot that is not at the front and
+ *          the front index is then flipped. The checkpoint writer only
+ *          ever reads the front slot, so a worker is normally never held
+ *          up. If the writer is still copying the back slot the publish is
+ *          skipped, unless the caller asks to wait for it.
+ *
+ * @param[in,out] snapshots The worker's snapshot buffer.
+ * @param[in] state The worker's current state.
+ * @param[in] wait Whether to block until the slot is free, used for the
+ *                 final publish of a finished worker.
+ *
+ * @par Example
+ * @code{.cpp}
+ * publishSnapshot(snapshots, state, false);
+ * @endcode
+ ************************************************************************/
+void publishSnapshot(SnapshotBuffer& snapshots, const SimWorkerState& state,
+    bool wait)
+{
+    int back = 1 - snapshots.front.load(memory_order_acquire);
+
+    if (wait)
+        snapshots.locks[back].lock();
+    else if (!snapshots.locks[back].try_lock())
+        return; // Checkpoint writer is busy with this slot, try next time
+
+    snapshots.slots[back] = state;
+    snapshots.locks[back].unlock();
+    snapshots.front.store(back, memory_order_release);
+}
+
+/** **********************************************************************
+ * @brief Writes a set of simulation totals as one line of text.
+ *
+ * @param[in,out] out The output stream.
+ * @param[in] stats The totals to write.
+ *
+ * @par Example
+ * @code{.cpp}
+ * writeStats(cout, stats);
+ * @endcode
+ ************************************************************************/
+void writeStats(ostream& out, const SimStats& stats)
+{
+    out << "stats " << stats.rounds << " " << stats.wins << " "
+        << stats.pushes << " " << stats.losses << " " << stats.blackjacks
+        << " " << stats.doubles << " " << stats.wagered << " " << stats.net
+        << " " << stats.netSquares << "\n";
+}
+
+/** **********************************************************************
+ * @brief Reads a set of simulation totals written by writeStats().
+ *
+ * @param[in,out] in The input stream.
+ * @param[out] stats The totals read.
+ *
+ * @returns `true` if the totals were read successfully.
+ *
+ * @par Example
+ * @code{.cpp}
+ * SimStats stats;
+ * readStats(in, stats);
+ * @endcode
+ ************************************************************************/
+bool readStats(istream& in, SimStats& stats)
+{
+    string tag;
+
+    in >> tag >> stats.rounds >> stats.wins >> stats.pushes >> stats.losses
+        >> stats.blackjacks >> stats.doubles >> stats.wagered >> stats.net
+        >> stats.netSquares;
+    return in && tag == "stats";
+}
+
+/** **********************************************************************
+ * @brief Writes the full state of one simulation worker as text.
+ *
+ * @details The random engine is written with its standard stream
+ *          operator, which records its complete internal state. The shoe
+ *          is written card by card together with its deal position and
+ *          running count, followed by its shuffling machine.
+ *
+ * @param[in,out] out The output stream.
+ * @param[in] state The worker state to write.
+ *
+ * @par Example
+ * @code{.cpp}
+ * writeWorkerState(file, state);
+ * @endcode
+ ************************************************************************/
+void writeWorkerState(ostream& out, const SimWorkerState& state)
+{
+    const Shoe& shoe = state.shoe;
+
+    out << "worker " << state.block << " " << state.blockRound << " "
+        << (state.done ? 1 : 0) << "\n";
+    out << "engine " << state.engine << "\n";
+    out << "shoe " << shoe.decks << " " << shoe.cutCard << " "
+        << shoe.position << " " << shoe.runningCount << " "
+        << shoe.cards.size();
+    for (const card& aCard : shoe.cards)
+        out << " " << aCard.faceValue << " " << aCard.suit;
+    out << "\n";
+    writeMachine(out, shoe.machine);
+    out << "player " << state.player.totalTokens << " " << state.player.bet
+        << "\n";
+    writeStats(out, state.stats);
+}
+
+/** **********************************************************************
+ * @brief Reads the state of one simulation worker written by
+ *        writeWorkerState().
+ *
+ * @param[in,out] in The input stream.
+ * @param[out] state The restored worker state.
+ *
+ * @returns `true` if the state was read successfully and is consistent.
+ *
+ * @par Example
+ * @code{.cpp}
+ * SimWorkerState state;
+ * readWorkerState(file, state);
+ * @endcode
+ ************************************************************************/
+bool readWorkerState(istream& in, SimWorkerState& state)
+{
+    string tag;
+    int done = 0;
+    size_t size = 0;
+    Shoe& shoe = state.shoe;
+
+    in >> tag >> state.block >> state.blockRound >> done;
+    if (!in || tag != "worker")
+        return false;
+    state.done = (done != 0);
+
+    in >> tag >> state.engine;
+    if (!in || tag != "engine")
+        return false;
+
+    in >> tag >> shoe.decks >> shoe.cutCard >> shoe.position
+        >> shoe.runningCount >> size;
+    if (!in || tag != "shoe" || size > 52 * 8)
+        return false;
+
+    shoe.cards.resize(size);
+    for (card& aCard : shoe.cards)
+        in >> aCard.faceValue >> aCard.suit;
+    if (!in || shoe.position < 0 || shoe.position > (int)size)
+        return false;
+
+    if (!readMachine(in, shoe.machine, (int)size))
+        return false;
+    shoe.continuous = (shoe.machine.slotCount > 0);
+    rebuildComposition(shoe);
+
+    in >> tag >> state.player.totalTokens >> state.player.bet;
+    if (!in || tag != "player")
+        return false;
+
+    return readStats(in, state.stats);
+}
+
+/** **********************************************************************
+ * @brief Writes the contents of a shuffling machine as one line of text.
+ *
+ * @details The tray is written from its next card onward, then the order
+ *          of the non-empty slot list, which decides the slot released by
+ *          a given random number, then every slot's stack.
+ *
+ * @param[in,out] out The output stream.
+ * @param[in] machine The machine to write, which may be unused.
+ *
+ * @par Example
+ * @code{.cpp}
+ * writeMachine(file, shoe.machine);
+ * @endcode
+ ************************************************************************/
+void writeMachine(ostream& out, const ShuffleMachine& machine)
+{
+    int traySize = (int)machine.tray.size();
+
+    out << "machine " << machine.slotCount << " " << machine.slotCapacity;
+    if (machine.slotCount > 0)
+    {
+        out << " " << machine.trayCount;
+        for (int i = 0; i < machine.trayCount; i++)
+        {
+            const card& aCard = machine.tray[(machine.trayHead + i) % traySize];
+            out << " " << aCard.faceValue << " " << aCard.suit;
+        }
+
+        out << " " << machine.filled.size();
+        for (int slot : machine.filled)
+            out << " " << slot;
+
+        for (int slot = 0; slot < machine.slotCount; slot++)
+        {
+            out << " " << machine.slotSizes[slot];
+            for (int i = 0; i < machine.slotSizes[slot]; i++)
+            {
+                const card& aCard
+                    = machine.slots[slot * machine.slotCapacity + i];
+                out << " " << aCard.faceValue << " " << aCard.suit;
+            }
+        }
+    }
+    out << "\n";
+}
+
+/** **********************************************************************
+ * @brief Reads the contents of a shuffling machine written by
+ *        writeMachine().
+ *
+ * @param[in,out] in The input stream.
+ * @param[out] machine The restored machine.
+ * @param[in] shoeSize The number of cards in the shoe.
+ *
+ * @returns `true` if the machine was read successfully and is consistent.
+ *
+ * @par Example
+ * @code{.cpp}
+ * readMachine(file, shoe.machine, (int)shoe.cards.size());
+ * @endcode
+ ************************************************************************/
+bool readMachine(istream& in, ShuffleMachine& machine, int shoeSize)
+{
+    string tag;
+    size_t filledCount = 0;
+
+    machine = ShuffleMachine();
+    in >> tag >> machine.slotCount >> machine.slotCapacity;
+    if (!in || tag != "machine" || machine.slotCount < 0
+        || machine.slotCount > 64 || machine.slotCapacity < 0
+        || machine.slotCapacity > shoeSize * 2 + 4)
+        return false;
+    if (machine.slotCount == 0)
+        return true;
+
+    machine.tray.resize(shoeSize);
+    in >> machine.trayCount;
+    if (!in || machine.trayCount < 0 || machine.trayCount > shoeSize)
+        return false;
+    for (int i = 0; i < machine.trayCount; i++)
+        in >> machine.tray[i].faceValue >> machine.tray[i].suit;
+
+    machine.slotSizes.assign(machine.slotCount, 0);
+    machine.filledIndex.assign(machine.slotCount, -1);
+    in >> filledCount;
+    if (!in || filledCount > (size_t)machine.slotCount)
+        return false;
+    machine.filled.resize(filledCount);
+    for (size_t i = 0; i < filledCount; i++)
+    {
+        in >> machine.filled[i];
+        if (!in || machine.filled[i] < 0
+            || machine.filled[i] >= machine.slotCount)
+            return false;
+        machine.filledIndex[machine.filled[i]] = (int)i;
+    }
+
+    machine.slots.resize(machine.slotCount * machine.slotCapacity);
+    for (int slot = 0; slot < machine.slotCount; slot++)
+    {
+        in >> machine.slotSizes[slot];
+        if (!in || machine.slotSizes[slot] < 0
+            || machine.slotSizes[slot] > machine.slotCapacity)
+            return false;
+        for (int i = 0; i < machine.slotSizes[slot]; i++)
+        {
+            card& aCard = machine.slots[slot * machine.slotCapacity + i];
+            in >> aCard.faceValue >> aCard.suit;
+        }
+    }
+    return (bool)in;
+}
+
+/** **********************************************************************
+ * @brief Saves the most recently published state of every worker.
+ *
+ * @details Each worker's front snapshot is copied while holding only that
+ *          slot's lock, then the whole checkpoint is written to a
+ *          temporary file that replaces the previous checkpoint once it is
+ *          complete. An interruption while writing therefore never leaves
+ *          a damaged checkpoint behind.
+ *
+ * @param[in] fileName The checkpoint file.
+ * @param[in] config The simulation parameters.
+ * @param[in,out] snapshots The snapshot buffer of every worker.
+ *
+ * @returns `true` if the checkpoint was written successfully.
+ *
+ * @par Example
+ * @code{.cpp}
+ * saveCheckpoint("run.ckpt", config, snapshots);
+ * @endcode
+ ************************************************************************/
+bool saveCheckpoint(const string& fileName, const SimConfig& config,
+    vector<SnapshotBuffer>& snapshots)
+{
+    vector<SimWorkerState> states(snapshots.size());
+    string tempName = fileName + ".tmp";
+
+    for (size_t w = 0; w < snapshots.size(); w++)
+    {
+        int front = snapshots[w].front.load(memory_order_acquire);
+        lock_guard<mutex> lock(snapshots[w].locks[front]);
+        states[w] = snapshots[w].slots[front];
+    }
+
+    ofstream file(tempName);
+    if (!file)
+        return false;
+
+    file << "BJCHECKPOINT " << CHECKPOINT_VERSION << "\n";
+    file << "config " << config.rounds << " " << config.blockRounds << " "
+        << config.seed << " " << config.threads << " " << config.decks << " "
+        << setprecision(17) << config.penetration << " " << config.bet
+        << " " << config.bankroll << " " << config.machineSlots << " "
+        << config.rules << " " << config.precision << " "
+        << config.shardIndex << " " << config.shardCount << " "
+        << config.insurance << "\n";
+    for (const SimWorkerState& state : states)
+        writeWorkerState(file, state);
+
+    file.close();
+    if (!file)
+        return false;
+
+#ifdef _WIN32
+    remove(fileName.c_str()); // rename() will not replace a file on Windows
+#endif
+    return rename(tempName.c_str(), fileName.c_str()) == 0;
+}
+
+/** **********************************************************************
+ * @brief Loads a checkpoint written by saveCheckpoint().
+ *
+ * @details The run's parameters are taken from the checkpoint rather than
+ *          the command line, including the thread count, since each
+ *          worker's remaining blocks depend on it.
+ *
+ * @param[in] fileName The checkpoint file.
+ * @param[out] config The simulation parameters of the saved run.
+ * @param[out] workers The restored state of every worker.
+ *
+ * @returns `true` if the checkpoint was read successfully.
+ *
+ * @par Example
+ * @code{.cpp}
+ * SimConfig config;
+ * vector<SimWorkerState> workers;
+ * loadCheckpoint("run.ckpt", config, workers);
+ * @endcode
+ ************************************************************************/
+bool loadCheckpoint(const string& fileName, SimConfig& config,
+    vector<SimWorkerState>& workers)
+{
+    ifstream file(fileName);
+    string tag;
+    int version = 0;
+
+    file >> tag >> version;
+    if (!file || tag != "BJCHECKPOINT" || version < 1
+        || version > CHECKPOINT_VERSION)
+        return false;
+
+    file >> tag >> config.rounds >> config.blockRounds >> config.seed
+        >> config.threads >> config.decks >> config.penetration >> config.bet
+        >> config.bankroll >> config.machineSlots >> config.rules
+        >> config.precision >> config.shardIndex
+        >> config.shardCount;
+    config.insurance = INSURANCE_NEVER; // Version 1 always declined it
+    if (version >= 2)
+        file >> config.insurance;
+    if (!file || tag != "config" || config.threads < 1
+        || config.threads > 1024 || config.blockRounds < 1
+        || config.shardCount < 1 || config.shardIndex >= config.shardCount
+        || config.insurance < INSURANCE_NEVER
+        || config.insurance > INSURANCE_PERFECT)
+        return false;
+
+    workers.assign(config.threads, SimWorkerState());
+    for (SimWorkerState& state : workers)
+    {
+        if (!readWorkerState(file, state))
+            return false;
+    }
+    return true;
+}
+
+/** **********************************************************************
+ * @brief Periodically writes checkpoints until the simulation finishes.
+ *
+ * @details This function runs on its own thread. It sleeps for the
+ *          configured interval, or until the workers signal that they are
+ *          done, and writes one last checkpoint before returning.
+ *
+ * @param[in] config The simulation parameters.
+ * @param[in,out] snapshots The snapshot buffer of every worker.
+ * @param[in,out] doneLock Guards allDone.
+ * @param[in,out] doneSignal Signalled once every worker has finished.
+ * @param[in] allDone Set to true once every worker has finished.
+ *
+ * @par Example
+ * @code{.cpp}
+ * thread writer(checkpointLoop, cref(config), ref(snapshots),
+ *     ref(doneLock), ref(doneSignal), ref(allDone));
+ * @endcode
+ ************************************************************************/
+void checkpointLoop(const SimConfig& config, vector<SnapshotBuffer>& snapshots,
+    mutex& doneLock, condition_variable& doneSignal, bool& allDone)
+{
+    unique_lock<mutex> lock(doneLock);
+
+    while (!doneSignal.wait_for(lock, chrono::seconds(config.checkpointSeconds),
+        [&allDone] { return allDone; }))
+    {
+        lock.unlock();
+        if (!saveCheckpoint(config.checkpointFile, config, snapshots))
+            cerr << "Unable to write checkpoint " << config.checkpointFile
+                << endl;
+        lock.lock();
+    }
+    lock.unlock();
+
+    if (!saveCheckpoint(config.checkpointFile, config, snapshots))
+        cerr << "Unable to write checkpoint " << config.checkpointFile << endl;
+}
@@ -0,0 +1,231 @@
+/** **********************************************************************
+* @file
+*
+* @brief This file contains the definitions for tracking the rank
+*        composition of the undealt cards, which lets counting and exact
+*        probability code ask how many cards of a rank are left in O(1).
+************************************************************************/
+
+#include "blackjack.h"
+
+/** ***************************************************************************
+*                          Composition Definitions
+******************************************************************************/
+
+/**
+* @brief Structure that holds one random Zobrist key for every possible count
+* of every rank.
+*/
+struct ZobristTable
+{
+    uint64_t keys[RANKS][MAX_RANK_COUNT + 1]; /**< Key by rank and count */
+
+    /**< ZobristTable constructor that fills the table from a fixed seed */
+    ZobristTable()
+    {
+        for (int rank = 0; rank < RANKS; rank++)
+        {
+            for (int count = 0; count <= MAX_RANK_COUNT; count++)
+                keys[rank][count] = blockSeed(0x5A0B41C7ULL,
+                    (uint64_t)(rank * (MAX_RANK_COUNT + 1) + count));
+        }
+    }
+};
+
+const ZobristTable ZOBRIST; // Same keys in every run, so hashes can be saved
+
+/** **********************************************************************
+ * @brief Composition constructor for an empty shoe.
+ *
+ * @details The hash of an empty shoe is the XOR of every rank's key for a
+ *          count of zero, so that adding and removing cards only ever has
+ *          to swap one rank's key.
+ *
+ * @par Example
+ * @code{.cpp}
+ * Composition composition;
+ * @endcode
+ ************************************************************************/
+Composition::Composition() : counts(), remaining(0), hash(0)
+{
+    for (int rank = 1; rank <= RANKS; rank++)
+        hash ^= zobristKey(rank, 0);
+}
+
+/** **********************************************************************
+ * @brief Compares two compositions rank by rank.
+ *
+ * @details Equal hashes almost always mean equal compositions; the counts
+ *          are still compared so that a memoization table never confuses
+ *          two shoes.
+ *
+ * @param[in] first The first composition.
+ * @param[in] second The second composition.
+ *
+ * @returns `true` if both hold the same number of cards of every rank.
+ *
+ * @par Example
+ * @code{.cpp}
+ * if (shoe.composition == saved)
+ *     reuseResult();
+ * @endcode
+ ************************************************************************/
+bool operator==(const Composition& first, const Composition& second)
+{
+    if (first.hash != second.hash || first.remaining != second.remaining)
+        return false;
+
+    for (int i = 0; i < RANKS; i++)
+    {
+        if (first.counts[i] != second.counts[i])
+            return false;
+    }
+    return true;
+}
+
+/** **********************************************************************
+ * @brief Returns the rank of a card by its Blackjack value.
+ *
+ * @param[in] aCard The card.
+ *
+ * @returns 1 for an ace, 2 through 9 for pip cards and 10 for tens and
+ *          face cards.
+ *
+ * @par Example
+ * @code{.cpp}
+ * removeRank(shoe.composition, cardRank(aCard));
+ * @endcode
+ ************************************************************************/
+int cardRank(card aCard)
+{
+    return min(aCard.faceValue, 10);
+}
+
+/** **********************************************************************
+ * @brief Returns the Zobrist key of one rank holding a given count.
+ *
+ * @param[in] rank The rank, 1 through 10.
+ * @param[in] count The number of cards of that rank, 0 through
+ *                  MAX_RANK_COUNT.
+ *
+ * @returns The key, which is the same in every run of the program.
+ *
+ * @par Example
+ * @code{.cpp}
+ * uint64_t key = zobristKey(10, 96);
+ * @endcode
+ ************************************************************************/
+uint64_t zobristKey(int rank, int count)
+{
+    return ZOBRIST.keys[rank - 1][count];
+}
+
+/** **********************************************************************
+ * @brief Sets a composition to that of a full shoe.
+ *
+ * @param[out] composition The composition to fill.
+ * @param[in] decks The number of 52-card decks in the shoe.
+ *
+ * @par Example
+ * @code{.cpp}
+ * fillComposition(shoe.composition, shoe.decks);
+ * @endcode
+ ************************************************************************/
+void fillComposition(Composition& composition, int decks)
+{
+    composition = Composition();
+
+    for (int rank = 1; rank <= RANKS; rank++)
+    {
+        int count = (rank == 10 ? 16 : 4) * decks;
+
+        composition.hash ^= zobristKey(rank, 0) ^ zobristKey(rank, count);
+        composition.counts[rank - 1] = count;
+    }
+    composition.remaining = 52 * decks;
+}
+
+/** **********************************************************************
+ * @brief Takes one card of a rank out of a composition.
+ *
+ * @details Only the old and new keys of that rank are swapped in the hash,
+ *          so this is O(1).
+ *
+ * @param[in,out] composition The composition, which must hold a card of
+ *                            the rank.
+ * @param[in] rank The rank being removed, 1 through 10.
+ *
+ * @par Example
+ * @code{.cpp}
+ * removeRank(shoe.composition, cardRank(aCard));
+ * @endcode
+ ************************************************************************/
+void removeRank(Composition& composition, int rank)
+{
+    int& count = composition.counts[rank - 1];
+
+    composition.hash ^= zobristKey(rank, count) ^ zobristKey(rank, count - 1);
+    count--;
+    composition.remaining--;
+}
+
+/** **********************************************************************
+ * @brief Puts one card of a rank back into a composition.
+ *
+ * @param[in,out] composition The composition.
+ * @param[in] rank The rank being added, 1 through 10.
+ *
+ * @par Example
+ * @code{.cpp}
+ * addRank(shoe.composition, cardRank(aCard));
+ * @endcode
+ ************************************************************************/
+void addRank(Composition& composition, int rank)
+{
+    int& count = composition.counts[rank - 1];
+
+    composition.hash ^= zobristKey(rank, count) ^ zobristKey(rank, count + 1);
+    count++;
+    composition.remaining++;
+}
+
+/** **********************************************************************
+ * @brief Recomputes a shoe's composition from the cards it still holds.
+ *
+ * @details This is only needed after a shoe has been restored from a
+ *          file, since every draw and return keeps the composition up to
+ *          date. The undealt cards are those from the deal position
+ *          onward, or those in the tray and slots of a shuffling machine.
+ *
+ * @param[in,out] shoe The shoe.
+ *
+ * @par Example
+ * @code{.cpp}
+ * rebuildComposition(state.shoe);
+ * @endcode
+ ************************************************************************/
+void rebuildComposition(Shoe& shoe)
+{
+    Composition& composition = shoe.composition;
+    const ShuffleMachine& machine = shoe.machine;
+
+    composition = Composition();
+
+    if (!shoe.continuous)
+    {
+        for (int i = shoe.position; i < (int)shoe.cards.size(); i++)
+            addRank(composition, cardRank(shoe.cards[i]));
+        return;
+    }
+
+    for (int i = 0; i < machine.trayCount; i++)
+        addRank(composition, cardRank(machine.tray[(machine.trayHead + i)
+            % machine.tray.size()]));
+
+    for (int slot = 0; slot < machine.slotCount; slot++)
+    {
+        for (int i = 0; i < machine.slotSizes[slot]; i++)
+            addRank(composition,
+                cardRank(machine.slots[slot * machine.slotCapacity + i]));
+    }
+}
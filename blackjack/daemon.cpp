@@ -0,0 +1,806 @@
+/** **********************************************************************
+* @file
+*
+* @brief This file contains the definitions for the simulation daemon,
+*        which takes simulation jobs over a Unix domain socket and runs
+*        them on one warm pool of worker threads, and for the job command
+*        that talks to it.
+*
+* @details Each connection carries one request line and gets back one or
+*          more reply lines before the daemon closes it. The requests are:
+*          - "submit [priority=N] [strategy=FILE] [NAME=VALUE]..." queues a
+*            job, where the names are those of a sweep grid (simulate,
+*            seed, decks, penetration, bet, block, csm, rules, precision).
+*            The reply is "job ID queued", or the finished job's status
+*            line if the same job is already in the cache.
+*          - "status ID" replies with the job's status line.
+*          - "watch ID" replies with a status line whenever another block
+*            of the job is counted, until it finishes.
+*          - "cancel ID" stops a job that has not finished.
+*          - "list" replies with the status line of every job.
+*          - "shutdown" stops the daemon once the running blocks end.
+*          Errors are replied to with a line starting with "error".
+*          Jobs are played block by block, exactly as a sweep cell is, so a
+*          job's totals are the same as those of a plain run with the same
+*          parameters, including where a precision target stops it, and
+*          identical jobs share one cache entry. A job
+*          submitted while the same job is still running is given the
+*          running job instead of a new one.
+************************************************************************/
+
+#include "blackjack.h"
+
+/** ***************************************************************************
+*                              Daemon Definitions
+******************************************************************************/
+
+const size_t DAEMON_REQUEST_BYTES = 4096; // Longest request line accepted
+const int DAEMON_POLL_MS = 200; // Longest wait to notice a shutdown
+
+/** **********************************************************************
+ * @brief Reads a job's parameters from the words of a submit request.
+ *
+ * @details A precision target without a round count makes the rounds a
+ *          cap, as it does for a plain run.
+ *
+ * @param[in] words The request's words after "submit".
+ * @param[out] job The job, whose configuration, precision, priority and
+ *                 strategy are filled in.
+ * @param[out] chart The strategy file, or "basic".
+ *
+ * @returns An empty string, or the reason the request was refused.
+ *
+ * @par Example
+ * @code{.cpp}
+ * string problem = parseJobSpec(words, job, chart);
+ * @endcode
+ ************************************************************************/
+string parseJobSpec(const vector<string>& words, DaemonJob& job,
+    string& chart)
+{
+    bool roundsGiven = false;
+
+    chart = "basic";
+    for (const string& word : words)
+    {
+        size_t equals = word.find('=');
+        string name = word.substr(0, equals);
+        string value = equals == string::npos ? "" : word.substr(equals + 1);
+        uint64_t number;
+
+        if (equals == string::npos || value.empty())
+            return "expected NAME=VALUE, got " + word;
+        if (name == "priority" && parseCount(value.c_str(), number)
+            && number <= 1000000)
+            job.priority = (int)number;
+        else if (name == "strategy")
+            chart = value;
+        else if (name == "precision" && parseReal(value.c_str(),
+            job.precision) && job.precision >= 0.0)
+            continue;
+        else if (name == "rules" && parseRules(value.c_str(),
+            job.config.rules))
+            continue;
+        else if (name != "threads" && parseSimOption("--" + name,
+            value.c_str(), job.config))
+            roundsGiven = roundsGiven || name == "simulate";
+        else
+            return "invalid parameter " + word;
+    }
+
+    if (job.precision > 0.0 && !roundsGiven)
+        job.config.rounds = PRECISION_ROUND_LIMIT;
+    if (!loadStrategyChart(chart, job.strategy))
+        return "unable to read strategy " + chart;
+    return "";
+}
+
+/** **********************************************************************
+ * @brief Builds the cache key of a job.
+ *
+ * @details A job with basic strategy has the same key as the sweep cell
+ *          with the same parameters, so the two can share a cache file.
+ *          Any other chart adds the hash of its full text.
+ *
+ * @param[in] job The job.
+ * @param[in] chart The strategy file, or "basic".
+ *
+ * @returns The key text.
+ *
+ * @par Example
+ * @code{.cpp}
+ * job.key = jobKey(job, chart);
+ * @endcode
+ ************************************************************************/
+string jobKey(const DaemonJob& job, const string& chart)
+{
+    string key = sweepKey(job.config, job.precision);
+
+    if (chart != "basic")
+    {
+        ostringstream text, hash;
+
+        writeStrategyChart(text, job.strategy);
+        hash << " chart=" << hex << hashText(text.str());
+        key += hash.str();
+    }
+    return key;
+}
+
+/** **********************************************************************
+ * @brief Formats the status line of a job. The caller must hold the
+ *        queue's lock.
+ *
+ * @param[in] job The job.
+ *
+ * @returns The line, without its newline.
+ *
+ * @par Example
+ * @code{.cpp}
+ * reply(connection, jobStatus(job));
+ * @endcode
+ ************************************************************************/
+string jobStatus(const DaemonJob& job)
+{
+    const char* states[] = { "queued", "running", "done", "cancelled" };
+    ostringstream line;
+
+    line << "job " << job.id << " " << states[job.state] << " "
+        << job.run.doneBlocks << "/" << job.run.blocks << " blocks "
+        << job.run.stats.rounds << " rounds";
+    if (job.run.stats.rounds > 0)
+        line << fixed << setprecision(4) << " edge "
+            << houseEdge(job.run.stats) << "% margin "
+            << edgeMargin(job.run.stats)
+            << "%";
+    if (job.cached)
+        line << " cached";
+    return line.str();
+}
+
+/** **********************************************************************
+ * @brief Records a job that has just finished. The caller must hold the
+ *        queue's lock.
+ *
+ * @details The totals go into the cache, and are appended to the cache
+ *          file when there is one.
+ *
+ * @param[in,out] queue The job queue.
+ * @param[in,out] job The job.
+ *
+ * @par Example
+ * @code{.cpp}
+ * finishJob(queue, job);
+ * @endcode
+ ************************************************************************/
+void finishJob(JobQueue& queue, DaemonJob& job)
+{
+    job.state = JOB_DONE;
+    job.run.pending.clear();
+    queue.cache[job.hash] = job.run.stats;
+    queue.running.erase(job.hash);
+    queue.open.erase(remove(queue.open.begin(), queue.open.end(), &job),
+        queue.open.end());
+
+    if (queue.cacheFile.is_open())
+    {
+        queue.cacheFile << "cell " << hex << job.hash << dec << " ";
+        writeStats(queue.cacheFile, job.run.stats);
+        queue.cacheFile.flush();
+    }
+}
+
+/** **********************************************************************
+ * @brief Adds a job to the queue, or answers it from the cache or from
+ *        the same job already running.
+ *
+ * @details The open jobs are kept with the highest priority first and,
+ *          within a priority, the oldest first. A repeated job takes the
+ *          higher of the two priorities.
+ *
+ * @param[in,out] queue The job queue.
+ * @param[in] job The new job, with its key and hash filled in.
+ *
+ * @returns The status line of the job that answers the request.
+ *
+ * @par Example
+ * @code{.cpp}
+ * reply(connection, submitJob(queue, job));
+ * @endcode
+ ************************************************************************/
+string submitJob(JobQueue& queue, const DaemonJob& job)
+{
+    lock_guard<mutex> lock(queue.lock);
+    auto running = queue.running.find(job.hash);
+
+    if (running != queue.running.end())
+    {
+        DaemonJob& twin = *queue.jobs[running->second];
+
+        twin.priority = max(twin.priority, job.priority);
+        stable_sort(queue.open.begin(), queue.open.end(),
+            [](const DaemonJob* a, const DaemonJob* b)
+            { return a->priority > b->priority; });
+        return jobStatus(twin);
+    }
+
+    shared_ptr<DaemonJob> added = make_shared<DaemonJob>(job);
+    added->id = queue.nextId++;
+    added->run.blocks = runBlocks(added->config);
+    queue.jobs[added->id] = added;
+
+    auto cached = queue.cache.find(added->hash);
+    if (cached != queue.cache.end())
+    {
+        added->run.stats = cached->second;
+        added->run.doneBlocks = added->run.blocks;
+        added->state = JOB_DONE;
+        added->cached = true;
+        return jobStatus(*added);
+    }
+
+    queue.running[added->hash] = added->id;
+    auto place = queue.open.begin();
+    while (place != queue.open.end() && (*place)->priority >= added->priority)
+        place++;
+    queue.open.insert(place, added.get());
+    if (added->run.blocks == 0)
+        finishJob(queue, *added);
+
+    queue.work.notify_all();
+    return jobStatus(*added);
+}
+
+/** **********************************************************************
+ * @brief Takes the next block to play from the job queue.
+ *
+ * @details The first open job in priority order with a block available
+ *          is served, so when a precision target holds a job back the next
+ *          job is served meanwhile. A worker with
+ *          nothing to do sleeps until a job is added or a block finishes.
+ *
+ * @param[in,out] queue The job queue.
+ * @param[out] job The block's job, which stays alive while it is held.
+ * @param[out] block The block number within the job.
+ *
+ * @returns `false` once the daemon is stopping.
+ *
+ * @par Example
+ * @code{.cpp}
+ * while (nextJobBlock(queue, job, block))
+ *     countJobBlock(queue, *job, block, stats);
+ * @endcode
+ ************************************************************************/
+bool nextJobBlock(JobQueue& queue, shared_ptr<DaemonJob>& job,
+    uint64_t& block)
+{
+    unique_lock<mutex> lock(queue.lock);
+
+    while (!queue.stopping)
+    {
+        for (DaemonJob* candidate : queue.open)
+        {
+            if (!blockAvailable(candidate->run, candidate->precision))
+                continue;
+
+            job = queue.jobs[candidate->id];
+            job->state = JOB_RUNNING;
+            block = job->run.nextBlock++;
+            return true;
+        }
+        queue.work.wait(lock);
+    }
+    return false;
+}
+
+/** **********************************************************************
+ * @brief Adds a finished block to its job.
+ *
+ * @details The block is counted by countRunBlock(), exactly as a sweep
+ *          cell's is. Blocks of a job that has finished or been
+ *          cancelled are dropped. Everyone watching is told of the change.
+ *
+ * @param[in,out] queue The job queue.
+ * @param[in,out] job The block's job.
+ * @param[in] block The block number.
+ * @param[in] stats The block's totals.
+ *
+ * @par Example
+ * @code{.cpp}
+ * countJobBlock(queue, *job, block, stats);
+ * @endcode
+ ************************************************************************/
+void countJobBlock(JobQueue& queue, DaemonJob& job, uint64_t block,
+    const SimStats& stats)
+{
+    lock_guard<mutex> lock(queue.lock);
+
+    if (job.state == JOB_RUNNING
+        && countRunBlock(job.run, block, stats, job.precision))
+        finishJob(queue, job);
+    queue.work.notify_all();
+    queue.progress.notify_all();
+}
+
+/** **********************************************************************
+ * @brief Stops a job that has not finished.
+ *
+ * @param[in,out] queue The job queue.
+ * @param[in] id The job's number.
+ *
+ * @returns The job's status line, or an error line.
+ *
+ * @par Example
+ * @code{.cpp}
+ * reply(connection, cancelJob(queue, 3));
+ * @endcode
+ ************************************************************************/
+string cancelJob(JobQueue& queue, int id)
+{
+    lock_guard<mutex> lock(queue.lock);
+    auto found = queue.jobs.find(id);
+
+    if (found == queue.jobs.end())
+        return "error no job " + to_string(id);
+
+    DaemonJob& job = *found->second;
+    if (job.state == JOB_DONE || job.state == JOB_CANCELLED)
+        return "error job " + to_string(id) + " has already ended";
+
+    job.state = JOB_CANCELLED;
+    job.run.pending.clear();
+    queue.running.erase(job.hash);
+    queue.open.erase(remove(queue.open.begin(), queue.open.end(), &job),
+        queue.open.end());
+    queue.progress.notify_all();
+    return jobStatus(job);
+}
+
+/** **********************************************************************
+ * @brief Plays blocks from the job queue until the daemon stops.
+ *
+ * @details The worker keeps one SimWorkerState for its whole life and
+ *          plays each block on it with playBlock(), so a warm worker does
+ *          not allocate between blocks of jobs with the same shoe size.
+ *          A block of a cancelled job is played to its end and
+ *          then dropped.
+ *
+ * @param[in,out] queue The job queue.
+ *
+ * @par Example
+ * @code{.cpp}
+ * thread worker(runDaemonWorker, ref(queue));
+ * @endcode
+ ************************************************************************/
+void runDaemonWorker(JobQueue& queue)
+{
+    SimWorkerState state;
+    shared_ptr<DaemonJob> job;
+    uint64_t block;
+
+    while (nextJobBlock(queue, job, block))
+    {
+        SimStats stats = playBlock(state, job->config, job->strategy, block);
+
+        countJobBlock(queue, *job, block, stats);
+        job.reset();
+    }
+}
+
+/** **********************************************************************
+ * @brief Loads the totals of a sweep or daemon cache file into the job
+ *        cache.
+ *
+ * @param[in] fileName The cache file, which must exist.
+ * @param[in,out] queue The job queue.
+ *
+ * @returns `false` if the file is not a cache file.
+ *
+ * @par Example
+ * @code{.cpp}
+ * loadJobCache("jobs.cache", queue);
+ * @endcode
+ ************************************************************************/
+bool loadJobCache(const string& fileName, JobQueue& queue)
+{
+    ifstream file(fileName);
+    string line, tag;
+    uint64_t hash;
+    SimStats stats;
+
+    if (!getline(file, line) || line != "BJSWEEP 1")
+        return false;
+
+    while (file >> tag >> hex >> hash >> dec && tag == "cell"
+        && readStats(file, stats))
+        queue.cache[hash] = stats;
+    return true;
+}
+
+/** **********************************************************************
+ * @brief Answers one request line.
+ *
+ * @details Every request but watch gets its whole answer at once. A watch
+ *          writes a status line whenever the job's counted blocks change,
+ *          and stops when the job ends, the daemon stops or the client
+ *          goes away.
+ *
+ * @param[in,out] queue The job queue.
+ * @param[in] request The request line.
+ * @param[in] reply Writes one line back, and returns `false` once the
+ *                  client has gone away.
+ *
+ * @par Example
+ * @code{.cpp}
+ * handleRequest(queue, "status 3", reply);
+ * @endcode
+ ************************************************************************/
+void handleRequest(JobQueue& queue, const string& request,
+    const function<bool(const string&)>& reply)
+{
+    istringstream in(request);
+    vector<string> words;
+    string word;
+    uint64_t id = 0;
+
+    while (in >> word)
+        words.push_back(word);
+    if (words.empty())
+    {
+        reply("error empty request");
+        return;
+    }
+
+    string command = words[0];
+    words.erase(words.begin());
+
+    if (command == "submit")
+    {
+        DaemonJob job;
+        string chart;
+        string problem = parseJobSpec(words, job, chart);
+
+        if (!problem.empty())
+        {
+            reply("error " + problem);
+            return;
+        }
+        job.key = jobKey(job, chart);
+        job.hash = hashText(job.key);
+        reply(submitJob(queue, job));
+    }
+    else if (command == "list" && words.empty())
+    {
+        vector<string> lines;
+        {
+            lock_guard<mutex> lock(queue.lock);
+            for (const auto& entry : queue.jobs)
+                lines.push_back(jobStatus(*entry.second));
+        }
+        for (const string& line : lines)
+            if (!reply(line))
+                break;
+    }
+    else if (command == "shutdown" && words.empty())
+    {
+        lock_guard<mutex> lock(queue.lock);
+        queue.stopping = true;
+        queue.work.notify_all();
+        queue.progress.notify_all();
+        reply("stopping");
+    }
+    else if ((command == "status" || command == "watch"
+        || command == "cancel") && words.size() == 1
+        && parseCount(words[0].c_str(), id) && id < (uint64_t)INT32_MAX)
+    {
+        if (command == "cancel")
+        {
+            reply(cancelJob(queue, (int)id));
+            return;
+        }
+
+        unique_lock<mutex> lock(queue.lock);
+        auto found = queue.jobs.find((int)id);
+        if (found == queue.jobs.end())
+        {
+            lock.unlock();
+            reply("error no job " + words[0]);
+            return;
+        }
+
+        shared_ptr<DaemonJob> job = found->second;
+        uint64_t shown = job->run.doneBlocks;
+        string line = jobStatus(*job);
+
+        lock.unlock();
+        if (!reply(line) || command == "status")
+            return;
+
+        lock.lock();
+        while (!queue.stopping && (job->state == JOB_QUEUED
+            || job->state == JOB_RUNNING))
+        {
+            queue.progress.wait(lock);
+            if (job->run.doneBlocks == shown && (job->state == JOB_QUEUED
+                || job->state == JOB_RUNNING))
+                continue;
+
+            shown = job->run.doneBlocks;
+            line = jobStatus(*job);
+            lock.unlock();
+            if (!reply(line))
+                return;
+            lock.lock();
+        }
+    }
+    else
+        reply("error unknown request " + request);
+}
+
+#ifndef _WIN32
+
+/** **********************************************************************
+ * @brief Fills in the address of a Unix domain socket.
+ *
+ * @param[in] path The socket's file name.
+ * @param[out] address The address.
+ *
+ * @returns `false` if the name is too long for a socket address.
+ ************************************************************************/
+bool socketAddress(const string& path, sockaddr_un& address)
+{
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path))
+        return false;
+    memcpy(address.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+/** **********************************************************************
+ * @brief Writes all of a piece of text to a socket.
+ *
+ * @param[in] handle The socket.
+ * @param[in] text The text.
+ *
+ * @returns `false` if the other end has gone away.
+ ************************************************************************/
+bool writeAll(int handle, const string& text)
+{
+    size_t sent = 0;
+
+    while (sent < text.size())
+    {
+        ssize_t written = write(handle, text.data() + sent,
+            text.size() - sent);
+
+        if (written <= 0)
+            return false;
+        sent += (size_t)written;
+    }
+    return true;
+}
+
+/** **********************************************************************
+ * @brief Serves one connection: reads its request line, answers it and
+ *        closes the connection.
+ *
+ * @param[in,out] queue The job queue.
+ * @param[in] handle The connection.
+ *
+ * @par Example
+ * @code{.cpp}
+ * thread(serveConnection, ref(queue), handle).detach();
+ * @endcode
+ ************************************************************************/
+void serveConnection(JobQueue& queue, int handle)
+{
+    string request;
+    char c;
+
+    while (request.size() < DAEMON_REQUEST_BYTES && read(handle, &c, 1) == 1
+        && c != '\n')
+        request += c;
+
+    handleRequest(queue, request, [handle](const string& line)
+        { return writeAll(handle, line + "\n"); });
+    close(handle);
+
+    lock_guard<mutex> lock(queue.lock);
+    queue.connections--;
+    queue.progress.notify_all();
+}
+
+/** **********************************************************************
+ * @brief Runs the daemon command, which serves simulation jobs on a Unix
+ *        domain socket until it is asked to shut down.
+ *
+ * @details The worker pool is started once and sleeps while there is no
+ *          work. With `--cache`, results are loaded from and appended to a
+ *          cache file in the same format as a sweep cache.
+ *
+ * @param[in] argc The number of arguments after the program name.
+ * @param[in] argv The arguments, starting with the command word.
+ *
+ * @returns 0 once the daemon has shut down, 1 if it could not start.
+ *
+ * @par Example
+ * @code{.cpp}
+ * return runDaemonCommand(argc - 1, argv + 1);
+ * @endcode
+ ************************************************************************/
+int runDaemonCommand(int argc, char* argv[])
+{
+    JobQueue queue;
+    vector<thread> workers;
+    string cacheFile;
+    int threads = SimConfig().threads;
+    uint64_t number;
+    sockaddr_un address;
+
+    if (argc < 2 || argc % 2 != 0 || !socketAddress(argv[1], address))
+    {
+        printUsage();
+        return 1;
+    }
+    for (int i = 2; i < argc; i += 2)
+    {
+        string option = argv[i];
+
+        if (option == "--cache")
+            cacheFile = argv[i + 1];
+        else if (option == "--threads" && parseCount(argv[i + 1], number)
+            && number >= 1 && number <= 1024)
+            threads = (int)number;
+        else
+        {
+            cerr << "Invalid option: " << argv[i] << " " << argv[i + 1]
+                << endl;
+            return 1;
+        }
+    }
+
+    if (!cacheFile.empty())
+    {
+        bool exists = (bool)ifstream(cacheFile);
+
+        if (exists && !loadJobCache(cacheFile, queue))
+        {
+            cerr << cacheFile << " is not a cache file" << endl;
+            return 1;
+        }
+        queue.cacheFile.open(cacheFile, ios::app);
+        if (!exists)
+            queue.cacheFile << "BJSWEEP 1\n";
+    }
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    unlink(argv[1]); // A socket left behind by an earlier daemon
+    if (listener < 0 || ::bind(listener, (sockaddr*)&address,
+        sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0)
+    {
+        cerr << "Unable to listen on " << argv[1] << endl;
+        if (listener >= 0)
+            close(listener);
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN); // A client that leaves early is not fatal
+    for (int w = 0; w < threads; w++)
+        workers.emplace_back(runDaemonWorker, ref(queue));
+    cout << "Serving jobs on " << argv[1] << " with " << threads
+        << " threads" << endl;
+
+    while (true)
+    {
+        pollfd waiting = { listener, POLLIN, 0 };
+        int handle = -1;
+
+        if (poll(&waiting, 1, DAEMON_POLL_MS) > 0)
+            handle = accept(listener, nullptr, nullptr);
+
+        lock_guard<mutex> lock(queue.lock);
+        if (queue.stopping)
+        {
+            if (handle >= 0)
+                close(handle);
+            break;
+        }
+        if (handle >= 0)
+        {
+            queue.connections++;
+            thread(serveConnection, ref(queue), handle).detach();
+        }
+    }
+
+    close(listener);
+    unlink(argv[1]);
+    for (thread& worker : workers)
+        worker.join();
+
+    unique_lock<mutex> lock(queue.lock);
+    queue.progress.wait(lock, [&queue] { return queue.connections == 0; });
+    cout << "Stopped" << endl;
+    return 0;
+}
+
+/** **********************************************************************
+ * @brief Runs the job command, which sends one request to a daemon and
+ *        prints every reply line.
+ *
+ * @param[in] argc The number of arguments after the program name.
+ * @param[in] argv The arguments: the command word, the socket and the
+ *                 words of the request.
+ *
+ * @returns 0 if the daemon answered without an error, 1 otherwise.
+ *
+ * @par Example
+ * @code{.cpp}
+ * return runJobCommand(argc - 1, argv + 1);
+ * @endcode
+ ************************************************************************/
+int runJobCommand(int argc, char* argv[])
+{
+    sockaddr_un address;
+    string request;
+    string reply;
+    char buffer[4096];
+    ssize_t length;
+
+    if (argc < 3 || !socketAddress(argv[1], address))
+    {
+        printUsage();
+        return 1;
+    }
+    for (int i = 2; i < argc; i++)
+        request += string(i > 2 ? " " : "") + argv[i];
+
+    int handle = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (handle < 0 || connect(handle, (sockaddr*)&address,
+        sizeof(address)) != 0)
+    {
+        cerr << "No daemon is listening on " << argv[1] << endl;
+        if (handle >= 0)
+            close(handle);
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    writeAll(handle, request + "\n");
+    while ((length = read(handle, buffer, sizeof(buffer))) > 0)
+    {
+        cout.write(buffer, length);
+        cout.flush();
+        reply.append(buffer, (size_t)length);
+    }
+    close(handle);
+
+    return reply.compare(0, 5, "error") == 0 || reply.empty() ? 1 : 0;
+}
+
+#else
+
+/** **********************************************************************
+ * @brief Reports that the daemon needs Unix domain sockets.
+ *
+ * @returns 1.
+ ************************************************************************/
+int runDaemonCommand(int, char*[])
+{
+    cerr << "The daemon needs Unix domain sockets" << endl;
+    return 1;
+}
+
+/** **********************************************************************
+ * @brief Reports that the job command needs Unix domain sockets.
+ *
+ * @returns 1.
+ ************************************************************************/
+int runJobCommand(int, char*[])
+{
+    cerr << "The job command needs Unix domain sockets" << endl;
+    return 1;
+}
+
+#endif
@@ -0,0 +1,368 @@
+/** **********************************************************************
+* @file
+*
+* @brief This file contains the infinite-deck dealer and player EV tables,
+*        which are worked out entirely at compile time and embedded in the
+*        program, so that looking up an EV is a single table read.
+************************************************************************/
+
+#include "blackjack.h"
+
+/** ***************************************************************************
+*                           Infinite Deck Definitions
+******************************************************************************/
+
+/** **********************************************************************
+ * @brief Returns the chance of drawing a rank from an infinite deck.
+ *
+ * @param[in] rank The rank, 1 (Ace) through 10 (any ten-value card).
+ *
+ * @returns 4/13 for ten-value cards and 1/13 for every other rank.
+ ************************************************************************/
+constexpr double rankChance(int rank)
+{
+    return rank == 10 ? 4.0 / 13.0 : 1.0 / 13.0;
+}
+
+/** **********************************************************************
+ * @brief Works out the dealer's final total distribution for one upcard.
+ *
+ * @details The hole card is drawn first so that a natural can be told
+ *          apart from a 21 of three or more cards. After that, the chance
+ *          of being in each hard and soft total is pushed forward card by
+ *          card, in an order where every total is finished before any
+ *          total it can be reached from: hard totals up to 10 (which
+ *          become soft on an ace), then soft totals (which become hard on
+ *          going over 21), then the remaining hard totals.
+ *
+ * @param[out] outcomes The chances of 17 through 21, a natural and a bust.
+ * @param[in] upcard The dealer's upcard, 1 (Ace) through 10.
+ * @param[in] hitSoft17 Whether the dealer hits soft 17.
+ ************************************************************************/
+constexpr void dealerOutcomes(double (&outcomes)[DEALER_OUTCOMES],
+    int upcard, bool hitSoft17)
+{
+    double hard[32] = {};
+    double soft[22] = {};
+
+    for (int rank = 1; rank <= 10; rank++)
+    {
+        double chance = rankChance(rank);
+        int aces = (upcard == 1) + (rank == 1);
+        int total = upcard + rank + (aces > 0 ? 10 : 0); // One ace as 11
+
+        if (total == 21)
+            outcomes[DEALER_NATURAL] += chance;
+        else if (aces > 0)
+            soft[total] += chance;
+        else
+            hard[total] += chance;
+    }
+
+    for (int total = 2; total <= 10; total++)
+    {
+        for (int rank = 1; rank <= 10; rank++)
+        {
+            if (rank == 1)
+                soft[total + 11] += hard[total] * rankChance(rank);
+            else
+                hard[total + rank] += hard[total] * rankChance(rank);
+        }
+    }
+
+    for (int total = 12; total <= 21; total++)
+    {
+        if (total > 17 || (total == 17 && !hitSoft17))
+        {
+            outcomes[total - 17] += soft[total];
+            continue;
+        }
+
+        for (int rank = 1; rank <= 10; rank++)
+        {
+            if (total + rank <= 21)
+                soft[total + rank] += soft[total] * rankChance(rank);
+            else
+                hard[total + rank - 10] += soft[total] * rankChance(rank);
+        }
+    }
+
+    for (int total = 11; total <= 26; total++)
+    {
+        if (total > 21)
+            outcomes[DEALER_BUST] += hard[total];
+        else if (total >= 17)
+            outcomes[total - 17] += hard[total];
+        else
+        {
+            for (int rank = 1; rank <= 10; rank++)
+                hard[total + rank] += hard[total] * rankChance(rank);
+        }
+    }
+}
+
+/** **********************************************************************
+ * @brief Works out the EV of standing on a total against the dealer's
+ *        final total distribution.
+ *
+ * @details Settlement follows settleHands(): the player wins when the
+ *          dealer busts or ends lower, and loses when the dealer ends
+ *          higher. A standing 21 is taken to hold three or more cards, so
+ *          it loses to a dealer natural and pushes any other 21.
+ *
+ * @param[in] outcomes The dealer's final total distribution.
+ * @param[in] total The player's total, up to 21.
+ *
+ * @returns The expected net result per unit bet.
+ ************************************************************************/
+constexpr double standOutcome(const double (&outcomes)[DEALER_OUTCOMES],
+    int total)
+{
+    double ev = outcomes[DEALER_BUST] - outcomes[DEALER_NATURAL];
+
+    for (int dealer = 17; dealer <= 21; dealer++)
+    {
+        if (total > dealer)
+            ev += outcomes[dealer - 17];
+        else if (total < dealer)
+            ev -= outcomes[dealer - 17];
+    }
+    return ev;
+}
+
+/** **********************************************************************
+ * @brief Builds every infinite-deck table for one rule variant.
+ *
+ * @details The EV of hitting assumes the player keeps choosing the better
+ *          of standing and hitting afterwards. Totals are filled in an
+ *          order where every total a hit can lead to is already known:
+ *          hard 21 down to 11 (where an ace counts as 1), soft 21 down to
+ *          12, then hard 10 down to 4.
+ *
+ * @param[in] rules The rule variant, RULES_S17 or RULES_H17.
+ *
+ * @returns The filled tables.
+ ************************************************************************/
+constexpr EvTables buildEvTables(int rules)
+{
+    EvTables tables = {};
+    double hardBest[32] = {};
+    double softBest[22] = {};
+
+    for (int upcard = 1; upcard <= 10; upcard++)
+    {
+        dealerOutcomes(tables.dealer[upcard], upcard, rules == RULES_H17);
+
+        for (int total = 4; total <= 21; total++)
+            tables.stand[total][upcard] = standOutcome(tables.dealer[upcard],
+                total);
+
+        for (int total = 22; total < 32; total++)
+            hardBest[total] = -1.0;
+
+        for (int total = 21; total >= 4; total--)
+        {
+            if (total == 10)
+            {
+                for (int softTotal = 21; softTotal >= 12; softTotal--)
+                {
+                    double ev = 0.0;
+
+                    for (int rank = 1; rank <= 10; rank++)
+                    {
+                        int next = softTotal + rank;
+                        ev += rankChance(rank) * (next <= 21 ? softBest[next]
+                            : hardBest[next - 10]);
+                    }
+                    tables.softHit[softTotal][upcard] = ev;
+                    softBest[softTotal] = max(ev,
+                        tables.stand[softTotal][upcard]);
+                }
+            }
+
+            double ev = 0.0;
+
+            for (int rank = 1; rank <= 10; rank++)
+            {
+                if (rank == 1 && total + 11 <= 21)
+                    ev += rankChance(rank) * softBest[total + 11];
+                else
+                    ev += rankChance(rank) * hardBest[total + rank];
+            }
+            tables.hardHit[total][upcard] = ev;
+            hardBest[total] = max(ev, tables.stand[total][upcard]);
+        }
+    }
+    return tables;
+}
+
+// Every table is evaluated by the compiler and stored in the program image
+constexpr EvTables EV_TABLES[RULE_VARIANTS] = {
+    buildEvTables(RULES_S17), buildEvTables(RULES_H17)
+};
+
+static_assert(EV_TABLES[RULES_S17].dealer[6][DEALER_BUST] > 0.42
+    && EV_TABLES[RULES_S17].dealer[6][DEALER_BUST] < 0.43,
+    "Dealer 6 busts about 42% of the time in an infinite deck");
+static_assert(EV_TABLES[RULES_S17].hardHit[16][10]
+    > EV_TABLES[RULES_S17].stand[16][10],
+    "Hitting 16 against a ten beats standing");
+
+/** **********************************************************************
+ * @brief Returns the chance of one dealer final outcome in an infinite
+ *        deck.
+ *
+ * @param[in] rules The rule variant, RULES_S17 or RULES_H17.
+ * @param[in] upcard The dealer's upcard, 1 (Ace) through 10.
+ * @param[in] outcome 0 through 4 for 17 through 21, DEALER_NATURAL or
+ *                    DEALER_BUST.
+ *
+ * @returns The chance of that outcome.
+ *
+ * @par Example
+ * @code{.cpp}
+ * double bust = dealerOutcome(RULES_S17, 6, DEALER_BUST);
+ * @endcode
+ ************************************************************************/
+double dealerOutcome(int rules, int upcard, int outcome)
+{
+    return EV_TABLES[rules].dealer[upcard][outcome];
+}
+
+/** **********************************************************************
+ * @brief Returns the infinite-deck EV of standing.
+ *
+ * @param[in] rules The rule variant, RULES_S17 or RULES_H17.
+ * @param[in] total The player's total, 4 through 21.
+ * @param[in] upcard The dealer's upcard, 1 (Ace) through 10.
+ *
+ * @returns The expected net result per unit bet.
+ *
+ * @par Example
+ * @code{.cpp}
+ * double ev = standEV(RULES_S17, 16, 10);
+ * @endcode
+ ************************************************************************/
+double standEV(int rules, int total, int upcard)
+{
+    return EV_TABLES[rules].stand[total][upcard];
+}
+
+/** **********************************************************************
+ * @brief Returns the infinite-deck EV of hitting once and then playing on
+ *        by the better of standing and hitting.
+ *
+ * @param[in] rules The rule variant, RULES_S17 or RULES_H17.
+ * @param[in] total The player's total, 4 through 21 (12 through 21 when
+ *                  soft).
+ * @param[in] soft Whether the total is soft.
+ * @param[in] upcard The dealer's upcard, 1 (Ace) through 10.
+ *
+ * @returns The expected net result per unit bet.
+ *
+ * @par Example
+ * @code{.cpp}
+ * double ev = hitEV(RULES_S17, 18, true, 9);
+ * @endcode
+ ************************************************************************/
+double hitEV(int rules, int total, bool soft, int upcard)
+{
+    const EvTables& tables = EV_TABLES[rules];
+
+    return soft ? tables.softHit[total][upcard]
+        : tables.hardHit[total][upcard];
+}
+
+/** **********************************************************************
+ * @brief Returns the better of hitting and standing in an infinite deck.
+ *
+ * @param[in] rules The rule variant, RULES_S17 or RULES_H17.
+ * @param[in] total The player's total.
+ * @param[in] soft Whether the total is soft.
+ * @param[in] upcard The dealer's upcard, 1 (Ace) through 10.
+ *
+ * @returns ACTION_HIT or ACTION_STAND.
+ *
+ * @par Example
+ * @code{.cpp}
+ * int action = bestAction(RULES_S17, 12, false, 3);
+ * @endcode
+ ************************************************************************/
+int bestAction(int rules, int total, bool soft, int upcard)
+{
+    return hitEV(rules, total, soft, upcard) > standEV(rules, total, upcard)
+        ? ACTION_HIT : ACTION_STAND;
+}
+
+/** **********************************************************************
+ * @brief Runs the ev command, which prints the infinite-deck tables.
+ *
+ * @details For every hard and soft total and every upcard the better
+ *          action is shown with its EV, followed by the dealer's bust
+ *          chance by upcard. `--h17` selects the tables for a dealer who
+ *          hits soft 17.
+ *
+ * @param[in] argc The number of arguments after the program name.
+ * @param[in] argv The arguments, starting with the command word.
+ *
+ * @returns 0 if the tables were printed, 1 if the arguments were invalid.
+ *
+ * @par Example
+ * @code{.cpp}
+ * return runEvCommand(argc - 1, argv + 1);
+ * @endcode
+ ************************************************************************/
+int runEvCommand(int argc, char* argv[])
+{
+    int rules = RULES_S17;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string option = argv[i];
+
+        if (option == "--h17")
+            rules = RULES_H17;
+        else if (option != "--s17")
+        {
+            printUsage();
+            return 1;
+        }
+    }
+
+    cout << fixed << setprecision(3);
+    cout << "Infinite deck, dealer " << (rules == RULES_H17 ? "hits"
+        : "stands on") << " soft 17 (H = hit, S = stand)\n";
+    cout << "        2       3       4       5       6       7       8"
+        << "       9       T       A\n";
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        bool soft = (pass == 1);
+
+        for (int total = soft ? 13 : 5; total <= 20; total++)
+        {
+            cout << (soft ? "A" : " ") << setw(2)
+                << (soft ? total - 11 : total) << "  ";
+            for (int column = 0; column < 10; column++)
+            {
+                int upcard = column == 9 ? 1 : column + 2;
+                int action = bestAction(rules, total, soft, upcard);
+                double ev = max(standEV(rules, total, upcard),
+                    hitEV(rules, total, soft, upcard));
+
+                cout << (action == ACTION_HIT ? "H" : "S") << showpos
+                    << setw(6) << ev << noshowpos << " ";
+            }
+            cout << "\n";
+        }
+    }
+
+    cout << "Bust ";
+    for (int column = 0; column < 10; column++)
+        cout << setw(7) << dealerOutcome(rules, column == 9 ? 1 : column + 2,
+            DEALER_BUST) << " ";
+    cout << endl;
+    cout.unsetf(ios::floatfield);
+
+    return 0;
+}
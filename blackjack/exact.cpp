@@ -0,0 +1,444 @@
+/** **********************************************************************
+* @file
+*
+* @brief This file contains the definitions for the exact enumeration
+*        mode, which works out the house edge of a round dealt off the top
+*        of a small shoe by walking every card sequence the round can use.
+************************************************************************/
+
+#include "blackjack.h"
+
+/** ***************************************************************************
+*                        Exact Enumeration Definitions
+******************************************************************************/
+
+/** **********************************************************************
+ * @brief Runs the exact command from the command line.
+ *
+ * @details The first three cards (the player's two cards and the dealer's
+ *          upcard) are enumerated up front, and each of the resulting
+ *          deals is handed to a worker thread as one subtree. The dealer's
+ *          hole card is drawn only when the dealer plays: the player never
+ *          sees it, so drawing it later gives every card sequence the same
+ *          chance it has in the real deal order. The subtree results are
+ *          added up in deal order, so the result is the same for any
+ *          thread count.
+ *
+ * @param[in] argc The number of arguments after the program name.
+ * @param[in] argv The arguments, starting with the command word.
+ *
+ * @returns 0 if the result was printed, 1 if the arguments were invalid.
+ *
+ * @par Example
+ * @code{.cpp}
+ * return runExactCommand(argc - 1, argv + 1);
+ * @endcode
+ ************************************************************************/
+int runExactCommand(int argc, char* argv[])
+{
+    SimConfig config;
+    Strategy strategy;
+    Composition start;
+    vector<thread> threads;
+    vector<ExactOutcome> deals(RANKS * RANKS * RANKS);
+    atomic<int> nextDeal(0);
+    ExactOutcome total;
+
+    config.decks = 1;
+    for (int i = 1; i < argc; i += 2)
+    {
+        string option = argv[i];
+
+        if (i + 1 >= argc)
+        {
+            printUsage();
+            return 1;
+        }
+        else if (option == "--rules" && parseRules(argv[i + 1], config.rules))
+            continue;
+        else if ((option == "--decks" || option == "--threads")
+            && parseSimOption(option, argv[i + 1], config))
+            continue;
+        else
+        {
+            cerr << "Invalid option: " << argv[i] << " " << argv[i + 1]
+                << endl;
+            printUsage();
+            return 1;
+        }
+    }
+
+    basicStrategy(strategy);
+    fillComposition(start, config.decks);
+
+    for (int w = 0; w < config.threads; w++)
+        threads.emplace_back(runExactWorker, cref(start), cref(strategy),
+            config.rules, ref(nextDeal), ref(deals));
+    for (thread& worker : threads)
+        worker.join();
+
+    for (const ExactOutcome& deal : deals)
+        addOutcome(total, deal, 1.0);
+
+    cout << fixed << setprecision(6);
+    cout << "Exact result off the top, " << config.decks << " deck"
+        << (config.decks > 1 ? "s" : "") << ", dealer "
+        << (config.rules == RULES_H17 ? "hits" : "stands on") << " soft 17"
+        << endl;
+    cout << "Win: " << total.win * 100.0 << "%  Push: " << total.push * 100.0
+        << "%  Loss: " << total.loss * 100.0 << "%" << endl;
+    cout << "House edge: " << -total.ev * 100.0 << "%" << endl;
+    cout.unsetf(ios::floatfield);
+    return 0;
+}
+
+/** **********************************************************************
+ * @brief Compares two memoization keys.
+ *
+ * @param[in] first The first key.
+ * @param[in] second The second key.
+ *
+ * @returns `true` if both describe the same position.
+ *
+ * @par Example
+ * @code{.cpp}
+ * bool same = (key == other);
+ * @endcode
+ ************************************************************************/
+bool operator==(const ExactKey& first, const ExactKey& second)
+{
+    return first.state == second.state
+        && first.composition == second.composition;
+}
+
+/** **********************************************************************
+ * @brief Returns a card of the given rank.
+ *
+ * @details Only the value of a card matters to the enumeration, so every
+ *          ten-value card is represented by a ten.
+ *
+ * @param[in] rank The rank, 1 (Ace) through 10.
+ *
+ * @returns A card with that face value.
+ *
+ * @par Example
+ * @code{.cpp}
+ * addCard(pHand, rankCard(10));
+ * @endcode
+ ************************************************************************/
+card rankCard(int rank)
+{
+    card aCard;
+
+    aCard.faceValue = rank;
+    aCard.suit = 0;
+    return aCard;
+}
+
+/** **********************************************************************
+ * @brief Packs everything about a hand that affects its outcome into one
+ *        integer.
+ *
+ * @param[in] hand The hand.
+ * @param[in] upcard The dealer's upcard, or 0 for a dealer hand.
+ *
+ * @returns The packed total, softness, card count and upcard.
+ *
+ * @par Example
+ * @code{.cpp}
+ * ExactKey key = { composition, handState(dHand, 0) };
+ * @endcode
+ ************************************************************************/
+int handState(const SimHand& hand, int upcard)
+{
+    return hand.total | (hand.softAces > 0 ? 1 << 5 : 0) | (hand.count << 6)
+        | (upcard << 11);
+}
+
+/** **********************************************************************
+ * @brief Works out how the dealer's hand can finish from the cards left.
+ *
+ * @details Each rank still in the shoe is drawn in turn with its exact
+ *          chance, and the composition is restored after each branch.
+ *          Results are memoized on the composition and the dealer's hand,
+ *          which is where most of the work is saved.
+ *
+ * @param[in,out] composition The undealt cards, unchanged on return.
+ * @param[in] dHand The dealer's hand so far, at least the upcard.
+ * @param[in,out] memo The worker's memoization tables.
+ *
+ * @returns The chance of each finishing total.
+ *
+ * @par Example
+ * @code{.cpp}
+ * DealerDist dist = dealerDist(composition, dHand, memo);
+ * @endcode
+ ************************************************************************/
+DealerDist dealerDist(Composition& composition, const SimHand& dHand,
+    ExactMemo& memo)
+{
+    DealerDist dist;
+
+    if (dHand.count >= 2 && (dHand.total > 17 || (dHand.total == 17
+        && (memo.rules == RULES_S17 || dHand.softAces == 0))))
+    {
+        if (dHand.total > 21)
+            dist.bust = 1.0;
+        else
+        {
+            dist.totals[dHand.total - 17] = 1.0;
+            if (dHand.total == 21)
+                dist.twentyOne[dHand.count] = 1.0;
+        }
+        return dist;
+    }
+
+    ExactKey key = { composition, handState(dHand, 0) };
+    auto found = memo.dealer.find(key);
+    if (found != memo.dealer.end())
+        return found->second;
+
+    double remaining = composition.remaining;
+
+    for (int rank = 1; rank <= RANKS; rank++)
+    {
+        int count = composition.counts[rank - 1];
+
+        if (count == 0 || dHand.count >= MAX_HAND_CARDS)
+            continue;
+
+        double chance = count / remaining;
+        SimHand next = dHand;
+
+        addCard(next, rankCard(rank));
+        removeRank(composition, rank);
+        DealerDist part = dealerDist(composition, next, memo);
+        addRank(composition, rank);
+
+        dist.bust += chance * part.bust;
+        for (int t = 0; t < 5; t++)
+            dist.totals[t] += chance * part.totals[t];
+        for (int c = 0; c <= MAX_HAND_CARDS; c++)
+            dist.twentyOne[c] += chance * part.twentyOne[c];
+    }
+
+    memo.dealer[key] = dist;
+    return dist;
+}
+
+/** **********************************************************************
+ * @brief Works out the outcome of a standing hand against the dealer.
+ *
+ * @details Settlement follows settleHands(), including the rule that a 21
+ *          made with more cards than the dealer's 21 loses.
+ *
+ * @param[in] dist How the dealer's hand can finish.
+ * @param[in] pHand The player's standing hand, which is not bust.
+ *
+ * @returns The outcome per unit bet.
+ *
+ * @par Example
+ * @code{.cpp}
+ * ExactOutcome outcome = standResult(dist, pHand);
+ * @endcode
+ ************************************************************************/
+ExactOutcome standResult(const DealerDist& dist, const SimHand& pHand)
+{
+    ExactOutcome outcome;
+
+    outcome.win = dist.bust;
+    for (int t = 17; t <= 20; t++)
+    {
+        if (pHand.total > t)
+            outcome.win += dist.totals[t - 17];
+        else if (pHand.total < t)
+            outcome.loss += dist.totals[t - 17];
+        else
+            outcome.push += dist.totals[t - 17];
+    }
+
+    if (pHand.total < 21)
+        outcome.loss += dist.totals[4];
+    else
+    {
+        for (int c = 2; c <= MAX_HAND_CARDS; c++)
+        {
+            if (pHand.count > c)
+                outcome.loss += dist.twentyOne[c];
+            else
+                outcome.push += dist.twentyOne[c];
+        }
+    }
+
+    outcome.ev = outcome.win - outcome.loss;
+    return outcome;
+}
+
+/** **********************************************************************
+ * @brief Works out the outcome of a player hand played on by the chart.
+ *
+ * @details The action is taken from strategyAction() exactly as in
+ *          simulateRound(), with doubling allowed on the first action
+ *          only. A natural stands at once and pays 3 to 2 unless the
+ *          dealer also reaches 21. Positions after the first action are
+ *          memoized on the composition, the hand and the upcard.
+ *
+ * @param[in,out] composition The undealt cards, unchanged on return.
+ * @param[in] pHand The player's hand.
+ * @param[in] dHand The dealer's hand, holding only the upcard.
+ * @param[in] firstAction Whether this is the player's first action.
+ * @param[in,out] memo The worker's memoization tables.
+ *
+ * @returns The outcome per unit of initial bet.
+ *
+ * @par Example
+ * @code{.cpp}
+ * ExactOutcome outcome = playerOutcome(composition, pHand, dHand, true,
+ *     memo);
+ * @endcode
+ ************************************************************************/
+ExactOutcome playerOutcome(Composition& composition, const SimHand& pHand,
+    const SimHand& dHand, bool firstAction, ExactMemo& memo)
+{
+    int upcard = min(dHand.cards[0].faceValue, 10);
+    ExactOutcome outcome;
+
+    if (firstAction && pHand.total == 21)
+    {
+        DealerDist dist = dealerDist(composition, dHand, memo);
+
+        outcome.push = dist.totals[4]; // Every dealer 21 is a push here
+        outcome.win = 1.0 - outcome.push;
+        outcome.ev = 1.5 * outcome.win;
+        return outcome;
+    }
+
+    ExactKey key = { composition, handState(pHand, upcard) };
+    if (!firstAction)
+    {
+        auto found = memo.player.find(key);
+        if (found != memo.player.end())
+            return found->second;
+    }
+
+    int action = strategyAction(*memo.strategy, pHand, upcard, firstAction);
+
+    if (action == ACTION_STAND)
+        outcome = standResult(dealerDist(composition, dHand, memo), pHand);
+    else
+    {
+        double remaining = composition.remaining;
+        double stake = (action == ACTION_DOUBLE) ? 2.0 : 1.0;
+
+        for (int rank = 1; rank <= RANKS; rank++)
+        {
+            int count = composition.counts[rank - 1];
+
+            if (count == 0)
+                continue;
+
+            double chance = count / remaining;
+            SimHand next = pHand;
+            ExactOutcome part;
+
+            addCard(next, rankCard(rank));
+            removeRank(composition, rank);
+            if (next.total > 21)
+            {
+                part.loss = 1.0;
+                part.ev = -1.0;
+            }
+            else if (action == ACTION_DOUBLE)
+                part = standResult(dealerDist(composition, dHand, memo), next);
+            else
+                part = playerOutcome(composition, next, dHand, false, memo);
+            addRank(composition, rank);
+
+            part.ev *= stake;
+            addOutcome(outcome, part, chance);
+        }
+    }
+
+    if (!firstAction)
+        memo.player[key] = outcome;
+    return outcome;
+}
+
+/** **********************************************************************
+ * @brief Adds a weighted outcome to a running total.
+ *
+ * @param[in,out] total The running total.
+ * @param[in] part The outcome to add.
+ * @param[in] weight The chance of reaching that outcome.
+ *
+ * @par Example
+ * @code{.cpp}
+ * addOutcome(total, part, chance);
+ * @endcode
+ ************************************************************************/
+void addOutcome(ExactOutcome& total, const ExactOutcome& part,
+    double weight)
+{
+    total.ev += weight * part.ev;
+    total.win += weight * part.win;
+    total.push += weight * part.push;
+    total.loss += weight * part.loss;
+}
+
+/** **********************************************************************
+ * @brief Enumerates deals taken from a shared counter until none are left.
+ *
+ * @details Deal d stands for the player's first card, the dealer's
+ *          upcard and the player's second card, as three base-10 digits.
+ *          The weighted outcome of each deal is stored in its own slot.
+ *          Each worker keeps its own memoization tables, which carry over
+ *          from one deal to the next.
+ *
+ * @param[in] start The composition of the full shoe.
+ * @param[in] strategy The chart the player follows.
+ * @param[in] rules The dealer rule variant.
+ * @param[in,out] nextDeal The next deal to enumerate, shared by workers.
+ * @param[in,out] deals The weighted outcome of every deal.
+ *
+ * @par Example
+ * @code{.cpp}
+ * thread worker(runExactWorker, cref(start), cref(strategy), RULES_S17,
+ *     ref(nextDeal), ref(deals));
+ * @endcode
+ ************************************************************************/
+void runExactWorker(const Composition& start, const Strategy& strategy,
+    int rules, atomic<int>& nextDeal, vector<ExactOutcome>& deals)
+{
+    ExactMemo memo;
+    int deal;
+
+    memo.strategy = &strategy;
+    memo.rules = rules;
+
+    while ((deal = nextDeal.fetch_add(1)) < (int)deals.size())
+    {
+        int ranks[3] = { deal / 100 + 1, deal / 10 % 10 + 1, deal % 10 + 1 };
+        Composition composition = start;
+        double chance = 1.0;
+        SimHand pHand, dHand;
+
+        for (int k = 0; k < 3; k++)
+        {
+            chance *= (double)composition.counts[ranks[k] - 1]
+                / composition.remaining;
+            if (chance == 0.0)
+                break;
+            removeRank(composition, ranks[k]);
+        }
+        if (chance == 0.0)
+            continue;
+
+        addCard(pHand, rankCard(ranks[0]));
+        addCard(dHand, rankCard(ranks[1]));
+        addCard(pHand, rankCard(ranks[2]));
+
+        ExactOutcome outcome = playerOutcome(composition, pHand, dHand, true,
+            memo);
+        addOutcome(deals[deal], outcome, chance);
+    }
+}
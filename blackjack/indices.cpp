@@ -0,0 +1,770 @@
+/** **********************************************************************
+* @file
+*
+* @brief This file contains the definitions for the index play generator,
+*        which finds the true count at which a basic strategy decision
+*        should change, using simulations bucketed by true count.
+************************************************************************/
+
+#include "blackjack.h"
+
+/** ***************************************************************************
+*                           Index Play Definitions
+******************************************************************************/
+
+const uint64_t MIN_BUCKET_SAMPLES = 2000; // Fewer samples are too noisy
+
+/** **********************************************************************
+ * @brief Runs the index play generator from the command line.
+ *
+ * @details Every cell is sampled from the same shuffled shoes, so one
+ *          shuffle is shared by all of the cells still to be computed.
+ *          Cells found in the cache file for the same parameters are not
+ *          simulated again, and when every cell is found no shoe is dealt
+ *          at all. The cache is rewritten with every cell once the run
+ *          finishes.
+ *
+ * @param[in] argc The number of arguments, starting with "indices".
+ * @param[in] argv The arguments, starting with "indices".
+ *
+ * @returns 0 if the indices were generated, 1 if the arguments were
+ *          invalid or asked for a continuous shuffler.
+ *
+ * @par Example
+ * @code{.cpp}
+ * runIndexCommand(argc - 1, argv + 1);
+ * @endcode
+ ************************************************************************/
+int runIndexCommand(int argc, char* argv[])
+{
+    SimConfig config;
+    string cacheFile;
+    vector<IndexCell> cells;
+    vector<thread> threads;
+
+    for (int i = 1; i < argc; i += 2)
+    {
+        string option = argv[i];
+
+        if (i + 1 >= argc)
+        {
+            printUsage();
+            return 1;
+        }
+        else if (option == "--samples")
+            option = "--simulate";
+
+        if (option == "--cache")
+            cacheFile = argv[i + 1];
+        else if (!parseSimOption(option, argv[i + 1], config))
+        {
+            cerr << "Invalid option: " << argv[i] << " " << argv[i + 1]
+                << endl;
+            printUsage();
+            return 1;
+        }
+    }
+
+    if (config.machineSlots > 0)
+    {
+        cerr << "indices needs a dealt shoe, not a continuous shuffler"
+            << endl;
+        return 1;
+    }
+
+    buildIndexCells(cells);
+
+    string key = indexCacheKey(config);
+    if (!cacheFile.empty())
+        loadIndexCache(cacheFile, key, cells);
+
+    bool pending = false;
+    for (const IndexCell& cell : cells)
+        pending = pending || !cell.cached;
+
+    if (pending) // With every cell cached, no shoe needs to be dealt
+    {
+        vector<vector<IndexCell>> partial(config.threads, cells);
+        for (int w = 0; w < config.threads; w++)
+        {
+            for (IndexCell& cell : partial[w])
+            {
+                bool cached = cell.cached;
+                cell = IndexCell(cell.kind, cell.total, cell.soft,
+                    cell.upcard);
+                cell.cached = cached;
+            }
+            threads.emplace_back(runIndexWorker, w, cref(config),
+                ref(partial[w]));
+        }
+
+        for (thread& worker : threads)
+            worker.join();
+
+        for (const vector<IndexCell>& part : partial)
+        {
+            for (size_t c = 0; c < cells.size(); c++)
+                mergeIndexCell(cells[c], part[c]);
+        }
+    }
+
+    if (!cacheFile.empty() && !saveIndexCache(cacheFile, key, cells))
+        cerr << "Unable to write index cache " << cacheFile << endl;
+
+    printIndexTable(cells);
+    return 0;
+}
+
+/** **********************************************************************
+ * @brief Builds an index cell with no samples.
+ *
+ * @param[in] cellKind CELL_HIT_STAND, CELL_DOUBLE or CELL_INSURANCE.
+ * @param[in] cellTotal The player's hand total.
+ * @param[in] cellSoft Whether the player's total is soft.
+ * @param[in] cellUpcard The dealer's upcard value.
+ *
+ * @par Example
+ * @code{.cpp}
+ * IndexCell cell(CELL_HIT_STAND, 16, false, 10);
+ * @endcode
+ ************************************************************************/
+IndexCell::IndexCell(int cellKind, int cellTotal, bool cellSoft,
+    int cellUpcard)
+    : kind(cellKind), total(cellTotal), soft(cellSoft), upcard(cellUpcard),
+    cached(false)
+{
+    for (int b = 0; b < TC_BUCKETS; b++)
+    {
+        samples[b] = 0;
+        stand[b] = 0;
+        hit[b] = 0;
+        doubled[b] = 0;
+    }
+}
+
+/** **********************************************************************
+ * @brief Lists every cell whose index play is generated.
+ *
+ * @details Hard 12 through 17 and soft 13 through 20 compare standing
+ *          with hitting, hard 8 through 11 and soft 13 through 19 compare
+ *          doubling with the better of hitting and standing, and the ace
+ *          upcard adds the insurance cell.
+ *
+ * @param[out] cells The list of cells.
+ *
+ * @par Example
+ * @code{.cpp}
+ * vector<IndexCell> cells;
+ * buildIndexCells(cells);
+ * @endcode
+ ************************************************************************/
+void buildIndexCells(vector<IndexCell>& cells)
+{
+    cells.clear();
+    for (int total = 12; total <= 17; total++)
+        for (int up = 1; up <= 10; up++)
+            cells.push_back(IndexCell(CELL_HIT_STAND, total, false, up));
+
+    for (int total = 13; total <= 20; total++)
+        for (int up = 1; up <= 10; up++)
+            cells.push_back(IndexCell(CELL_HIT_STAND, total, true, up));
+
+    for (int total = 8; total <= 11; total++)
+        for (int up = 1; up <= 10; up++)
+            cells.push_back(IndexCell(CELL_DOUBLE, total, false, up));
+
+    for (int total = 13; total <= 19; total++)
+        for (int up = 1; up <= 10; up++)
+            cells.push_back(IndexCell(CELL_DOUBLE, total, true, up));
+
+    cells.push_back(IndexCell(CELL_INSURANCE, 0, false, 1));
+}
+
+/** **********************************************************************
+ * @brief Describes the parameters that index results depend on.
+ *
+ * @param[in] config The simulation parameters.
+ *
+ * @returns A one-line key identifying results that may be reused.
+ *
+ * @par Example
+ * @code{.cpp}
+ * string key = indexCacheKey(config);
+ * @endcode
+ ************************************************************************/
+string indexCacheKey(const SimConfig& config)
+{
+    ostringstream key;
+
+    key << "samples=" << config.rounds << " block=" << config.blockRounds
+        << " seed=" << config.seed << " decks=" << config.decks
+        << " penetration=" << setprecision(17) << config.penetration;
+    return key.str();
+}
+
+/** **********************************************************************
+ * @brief Loads previously generated cells from the index cache.
+ *
+ * @details The cache is ignored if it was written for different
+ *          parameters. Each sample's shuffle does not depend on which
+ *          cells are evaluated, so a cell's cached results are exactly
+ *          what a new run would produce for it.
+ *
+ * @param[in] fileName The cache file.
+ * @param[in] key The parameters of the current run.
+ * @param[in,out] cells The cells, marked as cached when found.
+ *
+ * @par Example
+ * @code{.cpp}
+ * loadIndexCache("indices.cache", indexCacheKey(config), cells);
+ * @endcode
+ ************************************************************************/
+void loadIndexCache(const string& fileName, const string& key,
+    vector<IndexCell>& cells)
+{
+    ifstream file(fileName);
+    string line, tag;
+    IndexCell cell;
+
+    if (!getline(file, line) || line != "BJINDEX 1")
+        return;
+    if (!getline(file, line) || line != "key " + key)
+        return;
+
+    while (file >> tag >> cell.kind >> cell.total >> cell.soft >> cell.upcard
+        && tag == "cell")
+    {
+        for (int b = 0; b < TC_BUCKETS; b++)
+            file >> cell.samples[b] >> cell.stand[b] >> cell.hit[b]
+                >> cell.doubled[b];
+        if (!file)
+            return;
+
+        for (IndexCell& match : cells)
+        {
+            if (match.kind == cell.kind && match.total == cell.total
+                && match.soft == cell.soft && match.upcard == cell.upcard)
+            {
+                match = cell;
+                match.cached = true;
+            }
+        }
+    }
+}
+
+/** **********************************************************************
+ * @brief Writes every cell to the index cache.
+ *
+ * @param[in] fileName The cache file.
+ * @param[in] key The parameters of the current run.
+ * @param[in] cells The cells to save.
+ *
+ * @returns `true` if the cache was written successfully.
+ *
+ * @par Example
+ * @code{.cpp}
+ * saveIndexCache("indices.cache", indexCacheKey(config), cells);
+ * @endcode
+ ************************************************************************/
+bool saveIndexCache(const string& fileName, const string& key,
+    const vector<IndexCell>& cells)
+{
+    ofstream file(fileName);
+
+    file << "BJINDEX 1\n" << "key " << key << "\n";
+    for (const IndexCell& cell : cells)
+    {
+        file << "cell " << cell.kind << " " << cell.total << " " << cell.soft
+            << " " << cell.upcard;
+        for (int b = 0; b < TC_BUCKETS; b++)
+            file << " " << cell.samples[b] << " " << cell.stand[b] << " "
+                << cell.hit[b] << " " << cell.doubled[b];
+        file << "\n";
+    }
+    return (bool)file;
+}
+
+/** **********************************************************************
+ * @brief Lists the card ranks that make up a cell's starting position.
+ *
+ * @details The player holds a representative two-card hand for the cell
+ *          (a ten and the difference for hard 12 and up, an ace and the
+ *          difference for soft totals, two close cards below 12) and the
+ *          last rank is the dealer's upcard. The insurance cell only needs
+ *          the upcard.
+ *
+ * @param[in] cell The cell.
+ * @param[out] ranks The ranks, with 10 standing for any ten-value card.
+ *
+ * @returns The number of ranks listed.
+ *
+ * @par Example
+ * @code{.cpp}
+ * int ranks[3];
+ * int count = cellRanks(cell, ranks);
+ * @endcode
+ ************************************************************************/
+int cellRanks(const IndexCell& cell, int ranks[3])
+{
+    if (cell.kind == CELL_INSURANCE)
+    {
+        ranks[0] = cell.upcard;
+        return 1;
+    }
+
+    if (cell.soft)
+    {
+        ranks[0] = 1;
+        ranks[1] = cell.total - 11;
+    }
+    else if (cell.total >= 12)
+    {
+        ranks[0] = 10;
+        ranks[1] = cell.total - 10;
+    }
+    else
+    {
+        ranks[0] = cell.total - cell.total / 2;
+        ranks[1] = cell.total / 2;
+    }
+    ranks[2] = cell.upcard;
+    return 3;
+}
+
+/** **********************************************************************
+ * @brief Chooses which undealt cards form a cell's starting position.
+ *
+ * @details For each rank the cell needs, one of the undealt cards of that
+ *          rank is chosen uniformly at random, using a pick value drawn
+ *          once per sample so that the choice does not depend on which
+ *          other cells are evaluated. Dealing the rest of the shoe with
+ *          those cards skipped leaves the remaining cards in uniformly
+ *          random order.
+ *
+ * @param[in] cell The cell being sampled.
+ * @param[in] start Index of the first undealt card.
+ * @param[in] rankPositions Positions of the undealt cards of each rank,
+ *                          indexed by rank - 1.
+ * @param[in] picks One random value per card of the cell.
+ * @param[out] deck The deck to deal the rest of the round from.
+ *
+ * @returns The number of cards chosen, or -1 if a rank has run out.
+ *
+ * @par Example
+ * @code{.cpp}
+ * CellDeck deck;
+ * int placed = chooseCellCards(cell, start, rankPositions, picks, deck);
+ * @endcode
+ ************************************************************************/
+int chooseCellCards(const IndexCell& cell, int start,
+    const vector<int> rankPositions[10], const uint64_t picks[3],
+    CellDeck& deck)
+{
+    int ranks[3];
+    int chosen[3];
+    int count = cellRanks(cell, ranks);
+
+    for (int k = 0; k < count; k++)
+    {
+        const vector<int>& positions = rankPositions[ranks[k] - 1];
+        int taken[3];
+        int takenCount = 0;
+
+        for (int i = 0; i < k; i++)
+            if (ranks[i] == ranks[k])
+                taken[takenCount++] = chosen[i];
+
+        if ((int)positions.size() <= takenCount)
+            return -1;
+
+        // Pick among the cards of this rank not already chosen
+        int m = (int)(picks[k] % (positions.size() - takenCount));
+        if (takenCount == 2 && taken[0] > taken[1])
+            swap(taken[0], taken[1]);
+        for (int i = 0; i < takenCount; i++)
+            if (taken[i] <= m)
+                m++;
+        chosen[k] = m;
+    }
+
+    deck.position = start;
+    deck.skipCount = count;
+    for (int k = 0; k < count; k++)
+        deck.skip[k] = rankPositions[ranks[k] - 1][chosen[k]];
+    sort(deck.skip, deck.skip + count);
+
+    return count;
+}
+
+/** **********************************************************************
+ * @brief Deals the next card of an index cell's deck.
+ *
+ * @details Cards chosen for the cell's starting position are skipped. A
+ *          sample always leaves enough undealt cards for one round, but
+ *          should a round ever run past the end it continues from the
+ *          front of the shoe rather than read past it.
+ *
+ * @param[in,out] deck The deck to deal from.
+ *
+ * @returns The dealt card.
+ *
+ * @par Example
+ * @code{.cpp}
+ * addCard(dHand, cellDraw(deck));
+ * @endcode
+ ************************************************************************/
+card cellDraw(CellDeck& deck)
+{
+    int size = (int)deck.shoe->cards.size();
+
+    for (int k = 0; k < deck.skipCount; k++)
+        if (deck.position == deck.skip[k])
+            deck.position++;
+
+    if (deck.position >= size)
+        deck.position = 0;
+
+    return deck.shoe->cards[deck.position++];
+}
+
+/** **********************************************************************
+ * @brief Plays one action from a cell's starting position.
+ *
+ * @details The dealer's hole card is dealt first, as in dealRound(). After
+ *          a hit the player continues with basic strategy, and after a
+ *          double the player stands on one card. The dealer then draws to
+ *          17 and the hands are settled with settleHands(). For the
+ *          insurance cell the result is that of an insurance bet, which
+ *          pays 2 to 1 when the hole card is worth ten.
+ *
+ * @param[in] deck The deck, positioned at the first undealt card. It is
+ *                 taken by value so every action starts from the same card.
+ * @param[in] cell The cell being sampled.
+ * @param[in] strategy The chart followed after a hit.
+ * @param[in] action ACTION_STAND, ACTION_HIT or ACTION_DOUBLE.
+ *
+ * @returns The net units won, counting a doubled bet as 2 units.
+ *
+ * @par Example
+ * @code{.cpp}
+ * int result = playCellAction(deck, cell, strategy, ACTION_HIT);
+ * @endcode
+ ************************************************************************/
+int playCellAction(CellDeck deck, const IndexCell& cell,
+    const Strategy& strategy, int action)
+{
+    SimHand pHand, dHand;
+    int ranks[3];
+    int units = (action == ACTION_DOUBLE) ? 2 : 1;
+
+    cellRanks(cell, ranks);
+
+    if (cell.kind == CELL_INSURANCE)
+        return (min(cellDraw(deck).faceValue, 10) == 10) ? 2 : -1;
+
+    for (int k = 0; k < 3; k++)
+    {
+        card aCard = { ranks[k], 0 };
+        addCard(k < 2 ? pHand : dHand, aCard);
+    }
+    addCard(dHand, cellDraw(deck)); // Hole card
+
+    if (action != ACTION_STAND)
+    {
+        addCard(pHand, cellDraw(deck));
+        while (action == ACTION_HIT && pHand.total < 21
+            && strategyAction(strategy, pHand, cell.upcard, false)
+            == ACTION_HIT)
+            addCard(pHand, cellDraw(deck));
+    }
+
+    if (pHand.total > 21)
+        return -units;
+
+    while (dHand.total < 17)
+        addCard(dHand, cellDraw(deck));
+
+    int whoWon = settleHands(pHand, dHand);
+    if (whoWon == 1)
+        return units;
+    if (whoWon == 3)
+        return -units;
+    return 0;
+}
+
+/** **********************************************************************
+ * @brief Plays every pending cell from one randomly dealt-down shoe.
+ *
+ * @details The shoe is shuffled and dealt down to a random depth before
+ *          the cut card. For each cell the known cards are chosen from
+ *          the undealt cards, the true count is bucketed, and every action
+ *          is played from the same remaining card order so that the
+ *          actions are compared on identical cards. The shoe itself is
+ *          only read, so all cells share one shuffle.
+ *
+ * @param[in,out] shoe The worker's shoe.
+ * @param[in,out] engine The random engine of the current block.
+ * @param[in] strategy The chart followed after a hit.
+ * @param[in,out] cells The worker's cell totals.
+ * @param[in,out] rankPositions Scratch lists of card positions by rank.
+ *
+ * @par Example
+ * @code{.cpp}
+ * vector<int> rankPositions[10];
+ * sampleIndexCells(shoe, engine, strategy, cells, rankPositions);
+ * @endcode
+ ************************************************************************/
+void sampleIndexCells(Shoe& shoe, mt19937_64& engine,
+    const Strategy& strategy, vector<IndexCell>& cells,
+    vector<int> rankPositions[10])
+{
+    CellDeck deck;
+    uint64_t picks[3];
+    int size = (int)shoe.cards.size();
+    int depth = max(0, min(shoe.cutCard, size - 26));
+
+    shuffleShoe(shoe, engine);
+
+    int start = (int)randBelow(engine, depth + 1);
+    for (int k = 0; k < 3; k++)
+        picks[k] = engine();
+
+    int count = 0;
+    for (int i = 0; i < start; i++)
+        count += hiLoValue(shoe.cards[i]);
+
+    for (int r = 0; r < 10; r++)
+        rankPositions[r].clear();
+    for (int i = start; i < size; i++)
+        rankPositions[min(shoe.cards[i].faceValue, 10) - 1].push_back(i);
+
+    deck.shoe = &shoe;
+    for (IndexCell& cell : cells)
+    {
+        if (cell.cached)
+            continue;
+
+        int placed = chooseCellCards(cell, start, rankPositions, picks, deck);
+        if (placed < 0)
+            continue;
+
+        int runningCount = count;
+        for (int k = 0; k < placed; k++)
+            runningCount += hiLoValue(shoe.cards[deck.skip[k]]);
+
+        double trueCount = runningCount * 52.0 / (size - start - placed);
+        int bucket = (int)lround(trueCount);
+        bucket = min(max(bucket, TC_MIN), TC_MAX) - TC_MIN;
+
+        cell.samples[bucket]++;
+        if (cell.kind == CELL_INSURANCE)
+            cell.doubled[bucket] += playCellAction(deck, cell, strategy,
+                ACTION_STAND);
+        else
+        {
+            cell.stand[bucket] += playCellAction(deck, cell, strategy,
+                ACTION_STAND);
+            cell.hit[bucket] += playCellAction(deck, cell, strategy,
+                ACTION_HIT);
+            cell.doubled[bucket] += playCellAction(deck, cell, strategy,
+                ACTION_DOUBLE);
+        }
+    }
+}
+
+/** **********************************************************************
+ * @brief Samples every block of shoes assigned to one worker thread.
+ *
+ * @details Worker w samples blocks w, w + threads and so on, reseeding
+ *          and rebuilding the shoe for each block exactly as the round
+ *          simulator does, so the totals are the same for any number of
+ *          threads.
+ *
+ * @param[in] worker The worker's index.
+ * @param[in] config The parameters; rounds is the number of samples.
+ * @param[in,out] cells The worker's cell totals.
+ *
+ * @par Example
+ * @code{.cpp}
+ * runIndexWorker(0, config, cells);
+ * @endcode
+ ************************************************************************/
+void runIndexWorker(int worker, const SimConfig& config,
+    vector<IndexCell>& cells)
+{
+    Strategy strategy;
+    Shoe shoe(config.decks, config.penetration);
+    mt19937_64 engine;
+    vector<int> rankPositions[10];
+
+    basicStrategy(strategy);
+
+    for (uint64_t block = worker; block * config.blockRounds < config.rounds;
+        block += config.threads)
+    {
+        uint64_t blockSize = min(config.blockRounds,
+            config.rounds - block * config.blockRounds);
+
+        engine.seed(blockSeed(config.seed, block));
+        shoe = Shoe(config.decks, config.penetration);
+        for (uint64_t s = 0; s < blockSize; s++)
+            sampleIndexCells(shoe, engine, strategy, cells, rankPositions);
+    }
+}
+
+/** **********************************************************************
+ * @brief Adds one set of cell totals into another.
+ *
+ * @param[in,out] total The totals being accumulated.
+ * @param[in] part The totals to add.
+ *
+ * @par Example
+ * @code{.cpp}
+ * mergeIndexCell(cells[c], partial[c]);
+ * @endcode
+ ************************************************************************/
+void mergeIndexCell(IndexCell& total, const IndexCell& part)
+{
+    for (int b = 0; b < TC_BUCKETS; b++)
+    {
+        total.samples[b] += part.samples[b];
+        total.stand[b] += part.stand[b];
+        total.hit[b] += part.hit[b];
+        total.doubled[b] += part.doubled[b];
+    }
+}
+
+/** **********************************************************************
+ * @brief Finds the true count at which a cell's decision changes.
+ *
+ * @details For each bucket with enough samples, the advantage of the
+ *          alternative play is computed: standing over hitting, doubling
+ *          over the better of hitting and standing, or the expected value
+ *          of insurance. The index is where that advantage first changes
+ *          sign, interpolated linearly between neighbouring buckets.
+ *
+ * @param[in] cell The cell.
+ * @param[out] index The true count at which the decision changes, or 0
+ *                   if it never changes in the sampled range.
+ * @param[out] rising `true` if the alternative play is better above the
+ *                    index (or everywhere, when no index was found).
+ *
+ * @returns `true` if the decision changes within the sampled range.
+ *
+ * @par Example
+ * @code{.cpp}
+ * double index;
+ * bool rising;
+ * if (findIndex(cell, index, rising)) { }
+ * @endcode
+ ************************************************************************/
+bool findIndex(const IndexCell& cell, double& index, bool& rising)
+{
+    bool havePrevious = false;
+    double previous = 0.0;
+    int previousCount = 0;
+    int positive = 0, negative = 0;
+
+    index = 0.0;
+    rising = false;
+
+    for (int b = 0; b < TC_BUCKETS; b++)
+    {
+        if (cell.samples[b] < MIN_BUCKET_SAMPLES)
+            continue;
+
+        double n = (double)cell.samples[b];
+        double advantage;
+
+        if (cell.kind == CELL_HIT_STAND)
+            advantage = (cell.stand[b] - cell.hit[b]) / n;
+        else if (cell.kind == CELL_DOUBLE)
+            advantage = (cell.doubled[b] - max(cell.stand[b], cell.hit[b]))
+                / n;
+        else
+            advantage = cell.doubled[b] / n;
+
+        int trueCount = b + TC_MIN;
+        if (havePrevious && (previous < 0.0) != (advantage < 0.0))
+        {
+            index = previousCount + (0.0 - previous)
+                * (trueCount - previousCount) / (advantage - previous);
+            rising = (advantage >= 0.0);
+            return true;
+        }
+
+        (advantage < 0.0) ? negative++ : positive++;
+        havePrevious = true;
+        previous = advantage;
+        previousCount = trueCount;
+    }
+
+    rising = (positive > 0 && negative == 0);
+    return false;
+}
+
+/** **********************************************************************
+ * @brief Displays the generated indices as strategy charts.
+ *
+ * @details Entries are the true count at or above which the alternative
+ *          play is made. A trailing '-' marks the rare index where the
+ *          alternative is made at or below the count instead. Cells that
+ *          never change in the sampled range show the play that is always
+ *          made: S or H for hit/stand cells, D or '.' for double cells.
+ *
+ * @param[in] cells The cells.
+ *
+ * @par Example
+ * @code{.cpp}
+ * printIndexTable(cells);
+ * @endcode
+ ************************************************************************/
+void printIndexTable(const vector<IndexCell>& cells)
+{
+    const char* titles[2] = { "Stand at or above",
+        "Double at or above" };
+
+    cout << fixed << setprecision(1);
+    for (int kind = CELL_HIT_STAND; kind <= CELL_DOUBLE; kind++)
+    {
+        cout << titles[kind] << endl << "        ";
+        for (int up = 2; up <= 11; up++)
+            cout << setw(6) << (up == 11 ? string("A") : to_string(up));
+        cout << endl;
+
+        for (size_t c = 0; c < cells.size(); c += 10)
+        {
+            if (cells[c].kind != kind)
+                continue;
+
+            cout << (cells[c].soft ? "soft " : "hard ") << setw(2)
+                << cells[c].total << " ";
+            for (int up = 2; up <= 11; up++)
+            {
+                const IndexCell& cell = cells[c + (up == 11 ? 0 : up - 1)];
+                double index;
+                bool rising;
+                ostringstream entry;
+
+                if (findIndex(cell, index, rising))
+                    entry << fixed << setprecision(1) << index
+                        << (rising ? "" : "-");
+                else if (kind == CELL_HIT_STAND)
+                    entry << (rising ? "S" : "H");
+                else
+                    entry << (rising ? "D" : ".");
+                cout << setw(6) << entry.str();
+            }
+            cout << endl;
+        }
+        cout << endl;
+    }
+
+    double index;
+    bool rising;
+    if (findIndex(cells.back(), index, rising))
+        cout << "Insurance: take at or above " << index << endl;
+    else
+        cout << "Insurance: " << (rising ? "always" : "never") << endl;
+    cout.unsetf(ios::floatfield);
+}
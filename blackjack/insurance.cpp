@@ -0,0 +1,343 @@
+/** **********************************************************************
+* @file
+*
+* @brief This file contains the definitions for valuing insurance and even
+*        money from the composition of the cards the player has not seen.
+*
+* @details Insurance is a side bet of half the main bet that pays 2 to 1
+*          when the dealer's hole card is worth ten, so its value depends
+*          only on the chance of that one card. The unseen cards are the
+*          undealt part of the shoe together with the hole card, and the
+*          shoe's Composition already follows them one card at a time, so
+*          the chance costs a single division whenever an ace is showing.
+*          Even money also depends on how often the dealer draws to 21,
+*          which is bounded from the same cards and worked out exactly
+*          only when the bounds leave the choice open.
+************************************************************************/
+
+#include "blackjack.h"
+
+/** ***************************************************************************
+*                           Insurance Definitions
+******************************************************************************/
+
+const size_t DRAW21_MEMO_ENTRIES = 1 << 16; // Bounds each worker's tables
+const int DRAW21_BOUND_CARDS = 3; // Most dealer draws the bounds follow
+
+/** **********************************************************************
+ * @brief Follows the dealer's draws for a few cards, and works out how
+ *        often the hand has already made 21 and how often it has already
+ *        finished on anything else.
+ *
+ * @details The dealer draws as in dealerDist(). Whatever is still drawing
+ *          after the last card followed counts towards neither chance.
+ *
+ * @param[in,out] unseen The cards the dealer draws from; unchanged on
+ *                       return.
+ * @param[in] dHand The dealer's hand so far.
+ * @param[in] rules The dealer rule variant, RULES_S17 or RULES_H17.
+ * @param[in] cards The number of draws still to follow.
+ * @param[out] made The chance of finishing on 21 within those draws.
+ * @param[out] other The chance of finishing on another total or busting
+ *                   within those draws.
+ *
+ * @par Example
+ * @code{.cpp}
+ * double made, other;
+ * followDealerDraws(unseen, dHand, RULES_S17, 3, made, other);
+ * @endcode
+ ************************************************************************/
+void followDealerDraws(Composition& unseen, const SimHand& dHand, int rules,
+    int cards, double& made, double& other)
+{
+    made = 0.0;
+    other = 0.0;
+    if (dHand.total > 17 || (dHand.total == 17
+        && (rules == RULES_S17 || dHand.softAces == 0)))
+    {
+        (dHand.total == 21 ? made : other) = 1.0;
+        return;
+    }
+    if (cards == 0 || unseen.remaining == 0)
+        return;
+
+    double remaining = unseen.remaining;
+
+    for (int rank = 1; rank <= RANKS; rank++)
+    {
+        int count = unseen.counts[rank - 1];
+        double partMade, partOther;
+        SimHand next = dHand;
+
+        if (count == 0)
+            continue;
+
+        addCard(next, rankCard(rank));
+        removeRank(unseen, rank);
+        followDealerDraws(unseen, next, rules, cards - 1, partMade,
+            partOther);
+        addRank(unseen, rank);
+        made += count / remaining * partMade;
+        other += count / remaining * partOther;
+    }
+}
+
+/** **********************************************************************
+ * @brief Bounds the chance that a dealer ace without a ten in the hole
+ *        goes on to draw to 21, following only the next few draws.
+ *
+ * @details Each non-ten hole card is weighed by its exact chance, and the
+ *          dealer's next draws are followed by followDealerDraws(). Hands
+ *          that have made 21 by then give the lower bound, and all but
+ *          those that have finished on anything else give the upper bound.
+ *          Three draws cost a few thousand steps, against the full
+ *          enumeration's hundreds of thousands.
+ *
+ * @param[in,out] unseen The unseen cards, counting the hole card; unchanged
+ *                       on return.
+ * @param[in] rules The dealer rule variant, RULES_S17 or RULES_H17.
+ * @param[in] cards The number of draws to follow.
+ * @param[out] low A lower bound on the chance.
+ * @param[out] high An upper bound on the chance.
+ *
+ * @par Example
+ * @code{.cpp}
+ * double low, high;
+ * dealerDraw21Bounds(unseen, RULES_S17, 2, low, high);
+ * @endcode
+ ************************************************************************/
+void dealerDraw21Bounds(Composition& unseen, int rules, int cards,
+    double& low, double& high)
+{
+    double nonTens = unseen.remaining - unseen.counts[9];
+
+    low = 0.0;
+    high = 0.0;
+    for (int rank = 1; rank < 10; rank++)
+    {
+        int count = unseen.counts[rank - 1];
+        double made, other;
+        SimHand dHand;
+
+        if (count == 0)
+            continue;
+
+        addCard(dHand, rankCard(1));
+        addCard(dHand, rankCard(rank));
+        removeRank(unseen, rank);
+        followDealerDraws(unseen, dHand, rules, cards, made, other);
+        addRank(unseen, rank);
+        low += count / nonTens * made;
+        high += count / nonTens * (1.0 - other);
+    }
+}
+
+/** **********************************************************************
+ * @brief Works out the chance that a dealer ace without a ten in the hole
+ *        goes on to draw to 21.
+ *
+ * @details Each non-ten hole card is weighed by its exact chance, and the
+ *          dealer's draws from the ace and that card are followed through
+ *          dealerDist() with the rest of the unseen cards. Each worker
+ *          keeps its results by the composition's Zobrist hash across
+ *          offers, since the first rounds of every shoe leave the same
+ *          unseen cards, and both tables are cleared only once they grow
+ *          past DRAW21_MEMO_ENTRIES or the rules change.
+ *
+ * @param[in,out] unseen The unseen cards, counting the hole card; unchanged
+ *                       on return.
+ * @param[in] rules The dealer rule variant, RULES_S17 or RULES_H17.
+ *
+ * @returns The chance of the dealer drawing to 21, given that the hole
+ *          card is not a ten.
+ *
+ * @par Example
+ * @code{.cpp}
+ * double drawn21 = dealerDraw21Chance(unseen, RULES_S17);
+ * @endcode
+ ************************************************************************/
+double dealerDraw21Chance(Composition& unseen, int rules)
+{
+    thread_local ExactMemo memo; // Dealer draws from earlier offers
+    thread_local unordered_map<Composition, double, CompositionHash> known;
+    double nonTens = unseen.remaining - unseen.counts[9];
+    double chance = 0.0;
+
+    if (memo.rules != rules || memo.dealer.size() > DRAW21_MEMO_ENTRIES
+        || known.size() > DRAW21_MEMO_ENTRIES)
+    {
+        memo.rules = rules;
+        memo.dealer.clear();
+        known.clear();
+    }
+
+    auto found = known.find(unseen);
+    if (found != known.end())
+        return found->second;
+
+    for (int rank = 1; rank < 10; rank++)
+    {
+        int count = unseen.counts[rank - 1];
+        SimHand dHand;
+
+        if (count == 0)
+            continue;
+
+        addCard(dHand, rankCard(1));
+        addCard(dHand, rankCard(rank));
+        removeRank(unseen, rank);
+        chance += count / nonTens * dealerDist(unseen, dHand, memo).totals[4];
+        addRank(unseen, rank);
+    }
+    known[unseen] = chance;
+    return chance;
+}
+
+/** **********************************************************************
+ * @brief Values insurance and even money against a dealer ace.
+ *
+ * @details Insurance wins 2 units with a ten in the hole and loses 1
+ *          otherwise, so it is worth 3p - 1 per unit insured. Taking even
+ *          money is worth exactly 1 unit. Declining it pushes against a
+ *          ten in the hole and otherwise pays 3 to 2, unless the dealer
+ *          draws to 21, which this game also treats as a push. Bounds on
+ *          the chance of that draw from dealerDraw21Bounds(), following up
+ *          to DRAW21_BOUND_CARDS draws, settle about 96% of offers, and
+ *          then evenMoney is the bound that settled it, which has the sign
+ *          of the exact value. Otherwise the chance is worked out exactly
+ *          from the unseen cards by dealerDraw21Chance().
+ *
+ * @param[in,out] unseen The unseen cards, counting the hole card; unchanged
+ *                       on return.
+ * @param[in] natural Whether the player holds a natural, so that even
+ *                    money is offered.
+ * @param[in] rules The dealer rule variant, RULES_S17 or RULES_H17.
+ *
+ * @returns The chance of a ten in the hole and the value of both offers,
+ *          with evenMoney left at 0 without a natural.
+ *
+ * @par Example
+ * @code{.cpp}
+ * InsuranceEV ev = insuranceEV(unseen, true, RULES_S17);
+ * if (ev.evenMoney > 0.0)
+ *     cout << "Take even money" << endl;
+ * @endcode
+ ************************************************************************/
+InsuranceEV insuranceEV(Composition& unseen, bool natural, int rules)
+{
+    InsuranceEV ev;
+    int tens = unseen.counts[9];
+
+    ev.tenChance = unseen.remaining > 0 ? (double)tens / unseen.remaining
+        : 0.0;
+    ev.insurance = 3.0 * ev.tenChance - 1.0;
+    ev.evenMoney = 0.0;
+    if (!natural || unseen.remaining <= tens)
+        return ev;
+
+    // Even money is worth more the likelier the dealer's 21, so bounds on
+    // that chance bound its value too, and settle the choice when both
+    // have the same sign. Each further draw followed costs about ten times
+    // the last, so the bounds are tightened one draw at a time.
+    for (int cards = 1; cards <= DRAW21_BOUND_CARDS; cards++)
+    {
+        double low, high;
+
+        dealerDraw21Bounds(unseen, rules, cards, low, high);
+        double fewest = 1.0 - 1.5 * (1.0 - ev.tenChance) * (1.0 - low);
+        double most = 1.0 - 1.5 * (1.0 - ev.tenChance) * (1.0 - high);
+        if (fewest > 0.0 || most <= 0.0)
+        {
+            ev.evenMoney = fewest > 0.0 ? fewest : most;
+            return ev;
+        }
+    }
+
+    ev.evenMoney = 1.0 - 1.5 * (1.0 - ev.tenChance)
+        * (1.0 - dealerDraw21Chance(unseen, rules));
+    return ev;
+}
+
+/** **********************************************************************
+ * @brief Values insurance in an interactive round, where the unseen cards
+ *        are what is left of the deck and the dealer's hole card.
+ *
+ * @details The game never offers even money, so only insurance is valued.
+ *
+ * @param[in] deck The cards not yet dealt.
+ * @param[in] dHand The dealer's hand, with the hole card second.
+ * @param[in] rules The dealer rule variant, RULES_S17 or RULES_H17.
+ *
+ * @returns The chance of a ten in the hole and the value of insurance.
+ *
+ * @par Example
+ * @code{.cpp}
+ * InsuranceEV ev = deckInsuranceEV(deck, dHand, RULES_S17);
+ * @endcode
+ ************************************************************************/
+InsuranceEV deckInsuranceEV(const CardQueue& deck, const CardQueue& dHand,
+    int rules)
+{
+    Composition unseen;
+
+    addRank(unseen, cardRank(dHand[1]));
+    for (int i = 0; i < deck.size(); i++)
+        addRank(unseen, cardRank(deck[i]));
+
+    return insuranceEV(unseen, false, rules);
+}
+
+/** **********************************************************************
+ * @brief Values insurance and even money in a simulated round from the
+ *        shoe's running composition and the dealer's hole card.
+ *
+ * @details Insurance costs a single division. Even money is only valued
+ *          against a natural, where the dealer's draws are worked out
+ *          exactly.
+ *
+ * @param[in] shoe The shoe, after the opening cards have been dealt.
+ * @param[in] dHand The dealer's opening hand.
+ * @param[in] natural Whether the player holds a natural.
+ * @param[in] rules The dealer rule variant, RULES_S17 or RULES_H17.
+ *
+ * @returns The chance of a ten in the hole and the value of both offers.
+ *
+ * @par Example
+ * @code{.cpp}
+ * InsuranceEV ev = shoeInsuranceEV(shoe, dHand, pHand.total == 21, rules);
+ * @endcode
+ ************************************************************************/
+InsuranceEV shoeInsuranceEV(const Shoe& shoe, const SimHand& dHand,
+    bool natural, int rules)
+{
+    Composition unseen = shoe.composition;
+
+    addRank(unseen, cardRank(dHand.cards[1]));
+    return insuranceEV(unseen, natural, rules);
+}
+
+/** **********************************************************************
+ * @brief Parses the insurance policy of a simulation run.
+ *
+ * @param[in] text "never" or "perfect".
+ * @param[out] insurance The matching INSURANCE_* code.
+ *
+ * @returns `true` if the text names a policy.
+ *
+ * @par Example
+ * @code{.cpp}
+ * parseInsurance("perfect", config.insurance);
+ * @endcode
+ ************************************************************************/
+bool parseInsurance(const char* text, int& insurance)
+{
+    string name = text;
+
+    if (name == "never")
+        insurance = INSURANCE_NEVER;
+    else if (name == "perfect")
+        insurance = INSURANCE_PERFECT;
+    else
+        return false;
+    return true;
+}
@@ -0,0 +1,443 @@
+/** **********************************************************************
+* @file
+*
+* @brief This file contains the definitions for the learn command, which
+*        trains a strategy chart by tabular Q-learning from simulated
+*        rounds, for rule sets that have no published chart.
+*
+* @details Training runs in epochs. During an epoch every actor plays its
+*          share of the rounds with random choices and, for each choice,
+*          adds a learning target to its own table: the round's result in
+*          bets if the choice ended the hand, otherwise the best value of
+*          the next state in the shared Q-table. At the end of the epoch
+*          the actors' tables are added up, and each value in the shared
+*          table becomes the mean of every target it has received so far,
+*          which is Q-learning with a 1/n step size. Because random
+*          choices reach every state, the values converge to those of the
+*          best strategy, and the early targets made from poor estimates
+*          fade out as more arrive.
+************************************************************************/
+
+#include "blackjack.h"
+
+/** ***************************************************************************
+*                            Learning Definitions
+******************************************************************************/
+
+const int LEARN_EPOCHS = 30; // Default number of training epochs
+
+/** **********************************************************************
+ * @brief Runs the learn command from the command line.
+ *
+ * @details Each epoch plays `--simulate` rounds (1,000,000 by default),
+ *          split into blocks seeded by the epoch and block number and
+ *          spread over the worker threads. The targets are summed as
+ *          integers, so the learned chart does not depend on the number
+ *          of threads. The largest value change and the number of chart
+ *          entries that changed are shown after each epoch. The learned
+ *          chart is written in the chart file format, ready for `whatif
+ *          --chart`.
+ *
+ * @param[in] argc The number of arguments after the program name.
+ * @param[in] argv The arguments, starting with the command word.
+ *
+ * @returns 0 if the chart was learned and written, 1 if the arguments were
+ *          invalid or the chart could not be written.
+ *
+ * @par Example
+ * @code{.cpp}
+ * return runLearnCommand(argc - 1, argv + 1);
+ * @endcode
+ ************************************************************************/
+int runLearnCommand(int argc, char* argv[])
+{
+    SimConfig config;
+    uint64_t epochs = LEARN_EPOCHS;
+    string outFile;
+
+    for (int i = 1; i < argc; i += 2)
+    {
+        string option = argv[i];
+
+        if (i + 1 >= argc)
+        {
+            printUsage();
+            return 1;
+        }
+        else if (option == "--epochs" && parseCount(argv[i + 1], epochs)
+            && epochs >= 1)
+            continue;
+        else if (option == "--out")
+            outFile = argv[i + 1];
+        else if (option == "--rules" && parseRules(argv[i + 1], config.rules))
+            continue;
+        else if ((option == "--simulate" || option == "--threads"
+            || option == "--seed" || option == "--decks"
+            || option == "--penetration" || option == "--block")
+            && parseSimOption(option, argv[i + 1], config))
+            continue;
+        else
+        {
+            cerr << "Invalid option: " << argv[i] << " " << argv[i + 1]
+                << endl;
+            printUsage();
+            return 1;
+        }
+    }
+
+    QTable table;
+    vector<QSums> actors(config.threads);
+    Strategy strategy, previous;
+
+    learnedStrategy(table, strategy);
+    cout << fixed << setprecision(4);
+    for (uint64_t epoch = 0; epoch < epochs; epoch++)
+    {
+        vector<thread> threads;
+
+        for (int w = 0; w < config.threads; w++)
+        {
+            actors[w] = QSums();
+            threads.emplace_back(runLearnWorker, cref(config), epoch, w,
+                cref(table), ref(actors[w]));
+        }
+        for (thread& worker : threads)
+            worker.join();
+
+        double change = updateQTable(table, actors);
+        int changed = 0;
+
+        previous = strategy;
+        learnedStrategy(table, strategy);
+        for (int total = 0; total < 22; total++)
+            for (int up = 1; up < 11; up++)
+                changed += (strategy.hard[total][up]
+                    != previous.hard[total][up])
+                    + (strategy.soft[total][up] != previous.soft[total][up]);
+
+        cout << "Epoch " << setw(3) << epoch + 1 << ": largest change "
+            << change << " bets, " << changed << " chart entries changed"
+            << endl;
+    }
+    cout.unsetf(ios::floatfield);
+
+    if (outFile.empty())
+    {
+        writeStrategyChart(cout, strategy);
+        cout.flush();
+        return 0;
+    }
+
+    ofstream out(outFile);
+    writeStrategyChart(out, strategy);
+    out.close();
+    if (!out)
+    {
+        cerr << "Unable to write " << outFile << endl;
+        return 1;
+    }
+    cout << "Chart written to " << outFile << endl;
+    return 0;
+}
+
+/** **********************************************************************
+ * @brief Numbers a decision state for the Q-table.
+ *
+ * @param[in] total The player's total, at most 21.
+ * @param[in] soft Whether an ace is still counted as 11.
+ * @param[in] upcard The dealer's upcard value (1 = Ace, 10 = ten-value).
+ * @param[in] canDoubleDown Whether the player may still double down.
+ *
+ * @returns The state's row in the Q-table.
+ *
+ * @par Example
+ * @code{.cpp}
+ * int state = learnState(pHand.total, pHand.softAces > 0, upcard, true);
+ * @endcode
+ ************************************************************************/
+int learnState(int total, bool soft, int upcard, bool canDoubleDown)
+{
+    return ((total * 2 + (soft ? 1 : 0)) * 11 + upcard) * 2
+        + (canDoubleDown ? 1 : 0);
+}
+
+/** **********************************************************************
+ * @brief Returns the value of a state's best action in the Q-table.
+ *
+ * @param[in] table The Q-table.
+ * @param[in] state The state.
+ * @param[in] canDoubleDown Whether doubling down is one of the actions.
+ *
+ * @returns The highest value, in bets.
+ *
+ * @par Example
+ * @code{.cpp}
+ * double next = bestValue(table, state, false);
+ * @endcode
+ ************************************************************************/
+double bestValue(const QTable& table, int state, bool canDoubleDown)
+{
+    double best = max(table.values[state][ACTION_HIT - 1],
+        table.values[state][ACTION_STAND - 1]);
+
+    if (canDoubleDown)
+        best = max(best, table.values[state][ACTION_DOUBLE - 1]);
+    return best;
+}
+
+/** **********************************************************************
+ * @brief Adds one learning target to an actor's table.
+ *
+ * @param[in,out] sums The actor's table.
+ * @param[in] state The state the action was taken in.
+ * @param[in] action The ACTION_* code of the action.
+ * @param[in] target The target value, in bets.
+ *
+ * @par Example
+ * @code{.cpp}
+ * addTarget(sums, state, ACTION_STAND, 1.0);
+ * @endcode
+ ************************************************************************/
+void addTarget(QSums& sums, int state, int action, double target)
+{
+    sums.targets[state][action - 1] += llround(target * LEARN_SCALE);
+    sums.visits[state][action - 1]++;
+}
+
+/** **********************************************************************
+ * @brief Plays one training round with random choices.
+ *
+ * @details The deal, the dealer's play and the settlement follow
+ *          simulateRound(). A natural 21 offers no choice and teaches
+ *          nothing. Each choice is drawn at random from those allowed,
+ *          and its target is added to the actor's table: -1 for a bust,
+ *          the settled result for a stand, twice either for a double down,
+ *          and otherwise the best value of the new hand in the shared
+ *          table.
+ *
+ * @param[in,out] shoe The shoe to deal from, reshuffled at the cut card.
+ * @param[in,out] engine The random engine for shuffles and choices.
+ * @param[in] rules The dealer rule variant, RULES_S17 or RULES_H17.
+ * @param[in] table The shared Q-table, which is only read.
+ * @param[in,out] sums The actor's table.
+ *
+ * @par Example
+ * @code{.cpp}
+ * learnRound(shoe, engine, RULES_S17, table, sums);
+ * @endcode
+ ************************************************************************/
+void learnRound(Shoe& shoe, mt19937_64& engine, int rules,
+    const QTable& table, QSums& sums)
+{
+    SimHand pHand, dHand;
+    bool canDoubleDown = true;
+
+    if (shoe.position >= shoe.cutCard)
+        shuffleShoe(shoe, engine);
+
+    for (int i = 0; i < 2; i++)
+    {
+        addCard(pHand, drawCard(shoe, engine));
+        addCard(dHand, drawCard(shoe, engine));
+    }
+
+    int upcard = min(dHand.cards[0].faceValue, 10);
+
+    if (pHand.total == 21)
+        return;
+
+    while (true)
+    {
+        int state = learnState(pHand.total, pHand.softAces > 0, upcard,
+            canDoubleDown);
+        int action = canDoubleDown ? 1 + (int)randBelow(engine, 3)
+            : (randBelow(engine, 2) ? ACTION_HIT : ACTION_STAND);
+        int stake = action == ACTION_DOUBLE ? 2 : 1;
+
+        if (action != ACTION_STAND)
+        {
+            addCard(pHand, drawCard(shoe, engine));
+            canDoubleDown = false;
+            if (pHand.total > 21)
+            {
+                addTarget(sums, state, action, -stake);
+                return;
+            }
+        }
+
+        if (action == ACTION_HIT)
+        {
+            addTarget(sums, state, action, bestValue(table,
+                learnState(pHand.total, pHand.softAces > 0, upcard, false),
+                false));
+            continue;
+        }
+
+        dealerPlay(shoe, engine, dHand, rules);
+        int whoWon = settleHands(pHand, dHand);
+        addTarget(sums, state, action, stake * (whoWon == 1 ? 1
+            : (whoWon == 2 ? 0 : -1)));
+        return;
+    }
+}
+
+/** **********************************************************************
+ * @brief Plays one actor's share of a training epoch.
+ *
+ * @details Actor w plays blocks w, w + threads, w + 2 * threads and so on
+ *          of the epoch. Every block starts from a freshly shuffled shoe
+ *          seeded by its epoch and block number, so the rounds played do
+ *          not depend on the number of actors.
+ *
+ * @param[in] config The training parameters.
+ * @param[in] epoch The epoch being played.
+ * @param[in] worker The actor's index.
+ * @param[in] table The shared Q-table, which is only read.
+ * @param[in,out] sums The actor's own table.
+ *
+ * @par Example
+ * @code{.cpp}
+ * thread actor(runLearnWorker, cref(config), 0, 0, cref(table),
+ *     ref(sums));
+ * @endcode
+ ************************************************************************/
+void runLearnWorker(const SimConfig& config, uint64_t epoch, int worker,
+    const QTable& table, QSums& sums)
+{
+    uint64_t blocks = (config.rounds + config.blockRounds - 1)
+        / config.blockRounds;
+    Shoe shoe(config.decks, config.penetration);
+    mt19937_64 engine;
+
+    for (uint64_t block = worker; block < blocks; block += config.threads)
+    {
+        uint64_t rounds = min(config.blockRounds,
+            config.rounds - block * config.blockRounds);
+
+        engine.seed(blockSeed(config.seed, epoch * blocks + block));
+        resetShoe(shoe, config.penetration);
+        shuffleShoe(shoe, engine);
+
+        for (uint64_t round = 0; round < rounds; round++)
+            learnRound(shoe, engine, config.rules, table, sums);
+    }
+}
+
+/** **********************************************************************
+ * @brief Reduces the actors' tables into the shared Q-table.
+ *
+ * @details Each value that received targets this epoch becomes the mean
+ *          of those targets and every earlier one. Values that received
+ *          none are left as they were.
+ *
+ * @param[in,out] table The shared Q-table.
+ * @param[in] actors Every actor's table for the epoch.
+ *
+ * @returns The largest change of any value, in bets.
+ *
+ * @par Example
+ * @code{.cpp}
+ * double change = updateQTable(table, actors);
+ * @endcode
+ ************************************************************************/
+double updateQTable(QTable& table, const vector<QSums>& actors)
+{
+    double largest = 0.0;
+
+    for (int state = 0; state < LEARN_STATES; state++)
+    {
+        for (int action = 0; action < LEARN_ACTIONS; action++)
+        {
+            int64_t targets = 0;
+            uint64_t visits = 0;
+
+            for (const QSums& sums : actors)
+            {
+                targets += sums.targets[state][action];
+                visits += sums.visits[state][action];
+            }
+            if (visits == 0)
+                continue;
+
+            uint64_t seen = table.visits[state][action];
+            double value = (table.values[state][action] * seen
+                + (double)targets / LEARN_SCALE) / (double)(seen + visits);
+
+            largest = max(largest, fabs(value - table.values[state][action]));
+            table.values[state][action] = value;
+            table.visits[state][action] = seen + visits;
+        }
+    }
+    return largest;
+}
+
+/** **********************************************************************
+ * @brief Turns the Q-table into a strategy chart.
+ *
+ * @details Hitting and standing lead to the same hands whether or not
+ *          doubling is allowed, so their values from both states are
+ *          combined, weighted by visits. A hand doubles when doubling is
+ *          worth more than both, and the chart then says whether to hit
+ *          (D) or stand (Ds) when doubling is not allowed. Hands the
+ *          table has never seen keep their basic strategy action.
+ *
+ * @param[in] table The Q-table.
+ * @param[out] strategy The chart.
+ *
+ * @par Example
+ * @code{.cpp}
+ * Strategy strategy;
+ * learnedStrategy(table, strategy);
+ * @endcode
+ ************************************************************************/
+void learnedStrategy(const QTable& table, Strategy& strategy)
+{
+    basicStrategy(strategy);
+
+    for (int total = 4; total < 22; total++)
+    {
+        for (int pass = 0; pass < 2; pass++)
+        {
+            bool soft = (pass == 1);
+
+            for (int up = 1; up < 11; up++)
+            {
+                double value[LEARN_ACTIONS] = { 0.0, 0.0, 0.0 };
+                uint64_t visits[LEARN_ACTIONS] = { 0, 0, 0 };
+
+                for (int canDouble = 0; canDouble < 2; canDouble++)
+                {
+                    int state = learnState(total, soft, up, canDouble == 1);
+
+                    for (int a = 0; a < LEARN_ACTIONS; a++)
+                    {
+                        value[a] += table.values[state][a]
+                            * table.visits[state][a];
+                        visits[a] += table.visits[state][a];
+                    }
+                }
+                if (visits[ACTION_HIT - 1] == 0
+                    || visits[ACTION_STAND - 1] == 0)
+                    continue;
+
+                for (int a = 0; a < LEARN_ACTIONS; a++)
+                    if (visits[a] > 0)
+                        value[a] /= visits[a];
+
+                double hit = value[ACTION_HIT - 1];
+                double stand = value[ACTION_STAND - 1];
+                int action = hit > stand ? ACTION_HIT : ACTION_STAND;
+
+                if (visits[ACTION_DOUBLE - 1] > 0
+                    && value[ACTION_DOUBLE - 1] > max(hit, stand))
+                    action = hit > stand ? ACTION_DOUBLE
+                        : ACTION_DOUBLE_STAND;
+
+                if (soft)
+                    strategy.soft[total][up] = action;
+                else
+                    strategy.hard[total][up] = action;
+            }
+        }
+    }
+}
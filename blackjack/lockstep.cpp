@@ -0,0 +1,502 @@
+/** **********************************************************************
+* @file
+*
+* @brief This file contains the definitions for the lockstep engine, which
+*        plays a batch of independent games together on one thread, and
+*        the lockstep command that benchmarks it against the engine that
+*        plays one game at a time.
+*
+* @details Each lane of a batch plays one simulation block, with the same
+*          seed, shuffles and choices as simulateRound() would, so a
+*          lockstep run gives exactly the same totals as a normal run. The
+*          lanes move through every round together, phase by phase: the
+*          deal, the player's choices, the dealer's draws and the
+*          settlement. The state of every lane is kept in arrays, one per
+*          field, and the branches of a round become masks, so each phase
+*          is a short loop over the lanes with no unpredictable jumps.
+*          Only a lane's shuffle, which comes once per shoe, still
+*          branches.
+************************************************************************/
+
+#include "blackjack.h"
+
+/** ***************************************************************************
+*                            Lockstep Definitions
+******************************************************************************/
+
+// Strategy chart actions with the double down allowance applied, indexed
+// by whether doubling is allowed and then by the chart's ACTION_* code
+const int32_t RESOLVED_ACTIONS[2][5] = {
+    { 0, ACTION_HIT, ACTION_HIT, ACTION_STAND, ACTION_STAND },
+    { 0, ACTION_HIT, ACTION_DOUBLE, ACTION_STAND, ACTION_DOUBLE }
+};
+
+/** **********************************************************************
+ * @brief Shuffles one lane's shoe exactly as shuffleShoe() shuffles a
+ *        dealt shoe, using the same random draws.
+ *
+ * @param[in,out] batch The batch.
+ * @param[in] lane The lane to shuffle.
+ *
+ * @par Example
+ * @code{.cpp}
+ * shuffleLane(batch, 0);
+ * @endcode
+ ************************************************************************/
+void shuffleLane(LockstepBatch& batch, int lane)
+{
+    uint8_t* ranks = laneShoe(batch, lane);
+
+    for (int i = batch.shoeSize - 1; i > 0; i--)
+        swap(ranks[i], ranks[randBelow(batch.engines[lane], i + 1)]);
+    batch.pos[lane] = 0;
+}
+
+/** **********************************************************************
+ * @brief Starts a lane on a block, just as startBlock() starts a worker.
+ *
+ * @param[in,out] batch The batch.
+ * @param[in] lane The lane.
+ * @param[in] block The block the lane plays.
+ * @param[in] config The simulation parameters.
+ *
+ * @par Example
+ * @code{.cpp}
+ * startLane(batch, 0, block, config);
+ * @endcode
+ ************************************************************************/
+void startLane(LockstepBatch& batch, int lane, uint64_t block,
+    const SimConfig& config)
+{
+    uint8_t* ranks = laneShoe(batch, lane);
+
+    // The unshuffled order of resetShoe(), kept as ranks alone
+    for (int i = 0; i < batch.shoeSize; i++)
+        ranks[i] = (uint8_t)min(i % 13 + 1, 10);
+    ranks[batch.shoeSize] = 0; // Read, but never dealt, by masked lanes
+
+    batch.engines[lane].seed(blockSeed(config.seed, block));
+    shuffleLane(batch, lane);
+    batch.block[lane] = block;
+    batch.roundsLeft[lane] = min(config.blockRounds,
+        config.rounds - block * config.blockRounds);
+    batch.tokens[lane] = config.bankroll;
+    batch.active[lane] = 1;
+}
+
+/** **********************************************************************
+ * @brief Prepares a batch for a run, with every lane idle.
+ *
+ * @details The chart is copied in as bytes, indexed by whether the hand
+ *          is soft, its total and the upcard.
+ *
+ * @param[out] batch The batch.
+ * @param[in] config The simulation parameters.
+ * @param[in] strategy The chart every lane follows.
+ *
+ * @par Example
+ * @code{.cpp}
+ * LockstepBatch batch;
+ * prepareBatch(batch, config, strategy);
+ * @endcode
+ ************************************************************************/
+void prepareBatch(LockstepBatch& batch, const SimConfig& config,
+    const Strategy& strategy)
+{
+    batch.shoeSize = DECK_CARDS * config.decks;
+    batch.cutCard = max(4, (int)(batch.shoeSize * config.penetration));
+    batch.shoes.assign((size_t)LOCKSTEP_LANES * (batch.shoeSize + 1), 0);
+
+    for (int total = 0; total < 22; total++)
+        for (int upcard = 0; upcard < 11; upcard++)
+        {
+            batch.chart[0][total][upcard] =
+                (uint8_t)strategy.hard[total][upcard];
+            batch.chart[1][total][upcard] =
+                (uint8_t)strategy.soft[total][upcard];
+        }
+
+    for (int lane = 0; lane < LOCKSTEP_LANES; lane++)
+    {
+        batch.pos[lane] = 0;
+        batch.tokens[lane] = 0;
+        batch.active[lane] = 0;
+        batch.roundsLeft[lane] = 0;
+    }
+}
+
+/** **********************************************************************
+ * @brief Deals one card to a hand in every lane whose mask is set.
+ *
+ * @details Every lane reads its next card, but only masked lanes move on
+ *          and count it. The total is kept as addCard() keeps it, with
+ *          aces dropping from 11 to 1 as needed; one card can need at most
+ *          two such drops. A lane whose shoe has run out is reshuffled
+ *          first, as drawCard() does.
+ *
+ * @param[in,out] batch The batch.
+ * @param[in,out] total The hand totals.
+ * @param[in,out] soft The aces still counted as 11.
+ * @param[in,out] count The hand sizes.
+ * @param[in] mask 1 for the lanes that take a card, 0 for the rest.
+ *
+ * @par Example
+ * @code{.cpp}
+ * drawLanes(batch, batch.pTotal, batch.pSoft, batch.pCount, batch.active);
+ * @endcode
+ ************************************************************************/
+void drawLanes(LockstepBatch& batch, int32_t* total, int32_t* soft,
+    int32_t* count, const int32_t* mask)
+{
+    for (int lane = 0; lane < LOCKSTEP_LANES; lane++)
+    {
+        if (batch.pos[lane] == batch.shoeSize && mask[lane])
+            shuffleLane(batch, lane);
+
+        int32_t take = mask[lane];
+        int32_t rank = laneShoe(batch, lane)[batch.pos[lane]];
+        int32_t ace = take & (rank == 1);
+
+        batch.pos[lane] += take;
+        total[lane] += take * rank + 10 * ace;
+        soft[lane] += ace;
+        count[lane] += take;
+
+        for (int drop = 0; drop < 2; drop++)
+        {
+            int32_t over = (total[lane] > 21) & (soft[lane] > 0);
+
+            total[lane] -= 10 * over;
+            soft[lane] -= over;
+        }
+    }
+}
+
+/** **********************************************************************
+ * @brief Returns whether any lane's mask is set.
+ *
+ * @param[in] mask One 0 or 1 per lane.
+ *
+ * @returns `true` if at least one lane is set.
+ ************************************************************************/
+bool anyLane(const int32_t* mask)
+{
+    int32_t any = 0;
+
+    for (int lane = 0; lane < LOCKSTEP_LANES; lane++)
+        any |= mask[lane];
+    return any != 0;
+}
+
+/** **********************************************************************
+ * @brief Plays one round in every active lane of a batch.
+ *
+ * @details The phases follow simulateRound(). Lanes that have reached
+ *          the cut card are shuffled, and the cards are dealt alternately.
+ *          Then, while any player is still choosing, every choosing lane
+ *          looks up its action and the lanes that hit or double take a
+ *          card. The dealer then draws in every lane whose player did not
+ *          bust, until no dealer needs a card, and every lane is settled
+ *          with the arithmetic of simulateRound() worked out as masks.
+ *
+ * @param[in,out] batch The batch.
+ * @param[in] config The simulation parameters.
+ * @param[in,out] stats The totals each lane's result is added to.
+ *
+ * @par Example
+ * @code{.cpp}
+ * playLockstepRound(batch, config, stats);
+ * @endcode
+ ************************************************************************/
+void playLockstepRound(LockstepBatch& batch, const SimConfig& config,
+    SimStats& stats)
+{
+    int32_t bet = config.bet;
+    int32_t h17 = config.rules == RULES_H17 ? 1 : 0;
+
+    for (int lane = 0; lane < LOCKSTEP_LANES; lane++)
+    {
+        if (batch.active[lane] && batch.pos[lane] >= batch.cutCard)
+            shuffleLane(batch, lane);
+
+        batch.pTotal[lane] = batch.pSoft[lane] = batch.pCount[lane] = 0;
+        batch.dTotal[lane] = batch.dSoft[lane] = batch.dCount[lane] = 0;
+    }
+
+    // Deal: player, dealer's upcard, player, dealer's hole card
+    drawLanes(batch, batch.pTotal, batch.pSoft, batch.pCount, batch.active);
+    drawLanes(batch, batch.dTotal, batch.dSoft, batch.dCount, batch.active);
+    for (int lane = 0; lane < LOCKSTEP_LANES; lane++)
+        batch.upcard[lane] = batch.dTotal[lane] == 11 ? 1
+            : batch.dTotal[lane];
+    drawLanes(batch, batch.pTotal, batch.pSoft, batch.pCount, batch.active);
+    drawLanes(batch, batch.dTotal, batch.dSoft, batch.dCount, batch.active);
+
+    // Player decisions; a natural 21 stands automatically
+    for (int lane = 0; lane < LOCKSTEP_LANES; lane++)
+    {
+        batch.acting[lane] = batch.active[lane] & (batch.pTotal[lane] != 21);
+        batch.canDouble[lane] = 1;
+        batch.doubled[lane] = 0;
+    }
+    while (anyLane(batch.acting))
+    {
+        for (int lane = 0; lane < LOCKSTEP_LANES; lane++)
+        {
+            int32_t allowed = batch.canDouble[lane]
+                & (batch.tokens[lane] >= bet * 2);
+            int32_t chartAction = batch.chart[batch.pSoft[lane] > 0]
+                [min(batch.pTotal[lane], 21)][batch.upcard[lane]];
+            int32_t action = RESOLVED_ACTIONS[allowed][chartAction];
+            int32_t doubles = batch.acting[lane] & (action == ACTION_DOUBLE);
+
+            batch.hitting[lane] = batch.acting[lane]
+                & ((action == ACTION_HIT) | doubles);
+            batch.acting[lane] &= action == ACTION_HIT; // Doubling ends it
+            batch.doubled[lane] |= doubles;
+            batch.canDouble[lane] = 0;
+        }
+
+        drawLanes(batch, batch.pTotal, batch.pSoft, batch.pCount,
+            batch.hitting);
+
+        for (int lane = 0; lane < LOCKSTEP_LANES; lane++)
+            batch.acting[lane] &= batch.pTotal[lane] <= 21;
+    }
+
+    // Dealer draws, unless the player is bust
+    for (int lane = 0; lane < LOCKSTEP_LANES; lane++)
+        batch.acting[lane] = batch.active[lane] & (batch.pTotal[lane] <= 21);
+    for (;;)
+    {
+        for (int lane = 0; lane < LOCKSTEP_LANES; lane++)
+            batch.hitting[lane] = batch.acting[lane]
+                & ((batch.dTotal[lane] < 17) | (h17
+                & (batch.dTotal[lane] == 17) & (batch.dSoft[lane] > 0)));
+        if (!anyLane(batch.hitting))
+            break;
+        drawLanes(batch, batch.dTotal, batch.dSoft, batch.dCount,
+            batch.hitting);
+    }
+
+    // Settle, exactly as settleHands() and simulateRound() do
+    for (int lane = 0; lane < LOCKSTEP_LANES; lane++)
+    {
+        int32_t active = batch.active[lane];
+        int32_t p = batch.pTotal[lane];
+        int32_t d = batch.dTotal[lane];
+        int32_t bust = p > 21;
+        int32_t win = active & !bust & ((d > 21) | (p > d));
+        int32_t loss = active & !win & (bust | (p < d)
+            | ((p == 21) & (d == 21) & (batch.pCount[lane]
+            > batch.dCount[lane])));
+        int32_t natural = win & (p == 21) & (batch.pCount[lane] == 2);
+        int32_t stake = bet << batch.doubled[lane];
+        int32_t net = natural * ((bet * 3) / 2)
+            + (win & !natural) * stake - loss * stake;
+
+        batch.tokens[lane] += net;
+        batch.roundsLeft[lane] -= (uint64_t)active;
+        stats.rounds += (uint64_t)active;
+        stats.wins += (uint64_t)win;
+        stats.pushes += (uint64_t)(active & !win & !loss);
+        stats.losses += (uint64_t)loss;
+        stats.blackjacks += (uint64_t)natural;
+        stats.doubles += (uint64_t)(active & batch.doubled[lane]);
+        stats.wagered += active * bet;
+        stats.net += net;
+        stats.netSquares += (uint64_t)((int64_t)net * net);
+    }
+}
+
+/** **********************************************************************
+ * @brief Plays every block assigned to one worker thread in lockstep.
+ *
+ * @details Worker w plays blocks w, w + threads, w + 2 * threads and so on,
+ *          as runWorker() does, LOCKSTEP_LANES of them at a time. A lane
+ *          that finishes its block moves straight on to the worker's next
+ *          one, so the lanes stay full until the last blocks.
+ *
+ * @param[in] config The simulation parameters.
+ * @param[in] strategy The chart the players follow.
+ * @param[in] worker The worker's index.
+ * @param[in,out] stats The worker's totals.
+ *
+ * @par Example
+ * @code{.cpp}
+ * thread worker(runLockstepWorker, cref(config), cref(strategy), 0,
+ *     ref(stats));
+ * @endcode
+ ************************************************************************/
+void runLockstepWorker(const SimConfig& config, const Strategy& strategy,
+    int worker, SimStats& stats)
+{
+    uint64_t blocks = (config.rounds + config.blockRounds - 1)
+        / config.blockRounds;
+    uint64_t nextBlock = worker;
+    unique_ptr<LockstepBatch> batch(new LockstepBatch());
+
+    prepareBatch(*batch, config, strategy);
+    for (int lane = 0; lane < LOCKSTEP_LANES && nextBlock < blocks; lane++)
+    {
+        startLane(*batch, lane, nextBlock, config);
+        nextBlock += config.threads;
+    }
+
+    while (anyLane(batch->active))
+    {
+        playLockstepRound(*batch, config, stats);
+
+        for (int lane = 0; lane < LOCKSTEP_LANES; lane++)
+        {
+            if (!batch->active[lane] || batch->roundsLeft[lane] > 0)
+                continue;
+            if (nextBlock < blocks)
+            {
+                startLane(*batch, lane, nextBlock, config);
+                nextBlock += config.threads;
+            }
+            else
+                batch->active[lane] = 0;
+        }
+    }
+}
+
+/** **********************************************************************
+ * @brief Plays a whole simulation with the lockstep engine.
+ *
+ * @param[in] config The simulation parameters, for a dealt shoe.
+ * @param[in] strategy The chart the players follow.
+ *
+ * @returns The totals, identical to those of runSimulation().
+ *
+ * @par Example
+ * @code{.cpp}
+ * SimStats stats = runLockstep(config, strategy);
+ * @endcode
+ ************************************************************************/
+SimStats runLockstep(const SimConfig& config, const Strategy& strategy)
+{
+    vector<SimStats> parts(config.threads);
+    vector<thread> threads;
+    SimStats total;
+
+    for (int w = 0; w < config.threads; w++)
+        threads.emplace_back(runLockstepWorker, cref(config), cref(strategy),
+            w, ref(parts[w]));
+    for (thread& worker : threads)
+        worker.join();
+
+    for (const SimStats& part : parts)
+        mergeStats(total, part);
+    return total;
+}
+
+/** **********************************************************************
+ * @brief Checks whether two sets of simulation totals are identical.
+ *
+ * @param[in] first The first totals.
+ * @param[in] second The second totals.
+ *
+ * @returns `true` if every total matches.
+ ************************************************************************/
+bool sameStats(const SimStats& first, const SimStats& second)
+{
+    return first.rounds == second.rounds && first.wins == second.wins
+        && first.pushes == second.pushes && first.losses == second.losses
+        && first.blackjacks == second.blackjacks
+        && first.doubles == second.doubles
+        && first.wagered == second.wagered && first.net == second.net
+        && first.netSquares == second.netSquares;
+}
+
+/** **********************************************************************
+ * @brief Runs the lockstep command, which plays the same run with the
+ *        one-game-at-a-time engine and the lockstep engine, checks that
+ *        their totals match, and compares their speed per thread.
+ *
+ * @details The usual simulation options describe the run. The lockstep
+ *          engine covers a dealt shoe with a flat bet and no insurance,
+ *          so the shuffling machine, insurance and the options that save
+ *          or split a run are not accepted.
+ *
+ * @param[in] argc The number of arguments after the program name.
+ * @param[in] argv The arguments, starting with the command word.
+ *
+ * @returns 0 if both engines gave the same totals, 1 otherwise.
+ *
+ * @par Example
+ * @code{.cpp}
+ * return runLockstepCommand(argc - 1, argv + 1);
+ * @endcode
+ ************************************************************************/
+int runLockstepCommand(int argc, char* argv[])
+{
+    SimConfig config;
+    string resumeFile;
+    Strategy strategy;
+
+    if (!parseSimArgs(argc, argv, config, resumeFile))
+    {
+        printUsage();
+        return 1;
+    }
+    if (!resumeFile.empty() || config.machineSlots > 0
+        || config.insurance != INSURANCE_NEVER || config.shardCount > 1
+        || config.precision > 0.0 || !config.checkpointFile.empty()
+        || !config.resultFile.empty() || !config.transcriptFile.empty())
+    {
+        cerr << "lockstep benchmarks a plain run with a dealt shoe" << endl;
+        return 1;
+    }
+
+    basicStrategy(strategy);
+
+    vector<SimWorkerState> workers(config.threads);
+    vector<thread> threads;
+    SimStats single;
+
+    auto start = chrono::steady_clock::now();
+    for (int w = 0; w < config.threads; w++)
+    {
+        workers[w].block = w;
+        threads.emplace_back(runWorker, ref(workers[w]), cref(config),
+            cref(strategy), nullptr, nullptr, nullptr);
+    }
+    for (thread& worker : threads)
+        worker.join();
+    double singleSeconds = chrono::duration<double>(
+        chrono::steady_clock::now() - start).count();
+    for (const SimWorkerState& state : workers)
+        mergeStats(single, state.stats);
+
+    start = chrono::steady_clock::now();
+    SimStats lockstep = runLockstep(config, strategy);
+    double lockstepSeconds = chrono::duration<double>(
+        chrono::steady_clock::now() - start).count();
+
+    double singleRate = single.rounds / max(singleSeconds, 1e-9)
+        / config.threads;
+    double lockstepRate = lockstep.rounds / max(lockstepSeconds, 1e-9)
+        / config.threads;
+
+    cout << fixed << setprecision(0)
+        << "Rounds: " << config.rounds << "  Threads: " << config.threads
+        << "  Lanes: " << LOCKSTEP_LANES << "\n"
+        << "One game at a time: " << singleRate
+        << " rounds/s per thread\n"
+        << "Lockstep:           " << lockstepRate
+        << " rounds/s per thread\n" << setprecision(2)
+        << "Speedup: " << lockstepRate / max(singleRate, 1e-9) << "x\n";
+    cout.unsetf(ios::floatfield);
+
+    if (!sameStats(single, lockstep))
+    {
+        cout << "Totals differ: net " << single.net << " one at a time, "
+            << lockstep.net << " lockstep" << endl;
+        return 1;
+    }
+    cout << "Totals match: net " << lockstep.net << " over "
+        << lockstep.rounds << " rounds" << endl;
+    return 0;
+}
@@ -0,0 +1,582 @@
+/** **********************************************************************
+* @file
+*
+* @brief This file contains the definitions for the hardware counter
+*        profile of a simulation run, which reports cycles, instructions,
+*        branch misses, cache misses and allocations per round, for the
+*        whole run and for its shuffle, scoring and dealer phases.
+*
+* @details The counters come from Linux perf_event_open(), opened as one
+*          group on the calling thread so that they are read together and
+*          count only user code. The run is played twice with the same
+*          seed, so both plays deal exactly the same rounds. The first play
+*          reads the counters only at its start and end, and gives the
+*          figures for the whole run. The phases are shuffleShoe() for the
+*          shuffle, addCard() and settleHands() for the scoring, and
+*          dealerPlay() without its scoring for the dealer. Everything else
+*          is "other". The phases are marked with a PhaseScope, which is
+*          only compiled in with BJ_PROFILE_PHASES, as the test it makes
+*          would otherwise slow every run by a few percent. Each phase then
+*          gets a play of its own, with the group started on entering the
+*          phase and stopped on leaving it, so nothing outside the phase is
+*          counted. What one start and stop counts by itself is measured
+*          apart and taken off for every entry. A count no larger than what
+*          was taken off it is reported as below resolution rather than as
+*          a number. The phases are measured in separate plays, so they
+*          need not add up to the whole run, and the system calls still
+*          disturb the caches and branch predictors a little. Counters the
+*          machine or the kernel does not offer are left out of the report,
+*          and without any the report falls back to time and allocations.
+************************************************************************/
+
+#include "blackjack.h"
+
+/** ***************************************************************************
+*                       Performance Counter Definitions
+******************************************************************************/
+
+thread_local PerfCounters* phaseCounters = nullptr; // Profile being recorded
+const int SWITCH_SAMPLES = 100000; // Starts and stops timed for their cost
+
+/** **********************************************************************
+ * @brief Returns whether this build marks the phases of a round.
+ *
+ * @returns `true` if the program was built with BJ_PROFILE_PHASES.
+ *
+ * @par Example
+ * @code{.cpp}
+ * if (!profilingPhases())
+ *     cout << "Phases need BJ_PROFILE_PHASES" << endl;
+ * @endcode
+ ************************************************************************/
+bool profilingPhases()
+{
+#ifdef BJ_PROFILE_PHASES
+    return true;
+#else
+    return false;
+#endif
+}
+
+/** **********************************************************************
+ * @brief Opens the performance counters as one group on the calling
+ *        thread, disabled.
+ *
+ * @details Each event is tried on its own, and events the machine does not
+ *          offer are left out of the group. The first event opened leads
+ *          the group.
+ *
+ * @param[out] counters The counters.
+ *
+ * @returns `true` if at least one event could be opened. Otherwise
+ *          counters.problem says why not.
+ *
+ * @par Example
+ * @code{.cpp}
+ * PerfCounters counters;
+ * if (!openPerfCounters(counters))
+ *     cerr << counters.problem << endl;
+ * @endcode
+ ************************************************************************/
+bool openPerfCounters(PerfCounters& counters)
+{
+#ifdef __linux__
+    const uint32_t types[COUNTER_EVENTS] = { PERF_TYPE_HARDWARE,
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+        PERF_TYPE_HW_CACHE, PERF_TYPE_SOFTWARE };
+    const uint64_t configs[COUNTER_EVENTS] = { PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+        | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+        | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        PERF_COUNT_SW_TASK_CLOCK };
+
+    for (int e = 0; e < COUNTER_EVENTS; e++)
+    {
+        perf_event_attr attr;
+
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = types[e];
+        attr.config = configs[e];
+        attr.disabled = counters.leader < 0 ? 1 : 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED
+            | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        int handle = (int)syscall(SYS_perf_event_open, &attr, 0, -1,
+            counters.leader, 0);
+        if (handle < 0)
+        {
+            if (e < COUNTER_TASK_CLOCK && counters.problem.empty())
+                counters.problem = string("hardware counters unavailable: ")
+                    + strerror(errno);
+            continue;
+        }
+
+        if (counters.leader < 0)
+            counters.leader = handle;
+        counters.handles[e] = handle;
+        counters.slots[e] = counters.opened++;
+    }
+
+    if (counters.opened == 0)
+        return false;
+    if (counters.handles[COUNTER_CYCLES] >= 0)
+        counters.problem.clear(); // Some hardware events did open
+    return true;
+#else
+    counters.problem = "performance counters need Linux perf_event_open";
+    return false;
+#endif
+}
+
+/** **********************************************************************
+ * @brief Closes every counter opened by openPerfCounters().
+ *
+ * @param[in,out] counters The counters.
+ *
+ * @par Example
+ * @code{.cpp}
+ * closePerfCounters(counters);
+ * @endcode
+ ************************************************************************/
+void closePerfCounters(PerfCounters& counters)
+{
+#ifdef __linux__
+    for (int e = COUNTER_EVENTS - 1; e >= 0; e--)
+        if (counters.handles[e] >= 0)
+            close(counters.handles[e]);
+#endif
+    fill(counters.handles, counters.handles + COUNTER_EVENTS, -1);
+    counters.leader = -1;
+    counters.opened = 0;
+}
+
+/** **********************************************************************
+ * @brief Resets the counters to zero and starts or stops them.
+ *
+ * @param[in,out] counters The counters.
+ * @param[in] enable Whether to start them, rather than stop them.
+ *
+ * @par Example
+ * @code{.cpp}
+ * enablePerfCounters(counters, true);
+ * @endcode
+ ************************************************************************/
+void enablePerfCounters(PerfCounters& counters, bool enable)
+{
+#ifdef __linux__
+    if (counters.leader < 0)
+        return;
+    if (enable)
+    {
+        ioctl(counters.leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(counters.leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+    else
+        ioctl(counters.leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+#else
+    (void)counters;
+    (void)enable;
+#endif
+}
+
+/** **********************************************************************
+ * @brief Starts or stops the counters without resetting them, so that they
+ *        go on adding to the counts they have.
+ *
+ * @param[in] counters The counters.
+ * @param[in] run Whether to start them, rather than stop them.
+ *
+ * @par Example
+ * @code{.cpp}
+ * runPerfCounters(counters, false);
+ * @endcode
+ ************************************************************************/
+void runPerfCounters(const PerfCounters& counters, bool run)
+{
+#ifdef __linux__
+    if (counters.leader >= 0)
+        ioctl(counters.leader, run ? PERF_EVENT_IOC_ENABLE
+            : PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+#else
+    (void)counters;
+    (void)run;
+#endif
+}
+
+/** **********************************************************************
+ * @brief Reads every counter of the group with one system call.
+ *
+ * @details When the kernel had to share the hardware between more groups
+ *          than it could count at once, the counts are scaled up by the
+ *          share of time the group was counting.
+ *
+ * @param[in] counters The counters.
+ * @param[out] values The count of each event so far, 0 where the event is
+ *                    not available.
+ *
+ * @par Example
+ * @code{.cpp}
+ * double values[COUNTER_EVENTS];
+ * readPerfCounters(counters, values);
+ * @endcode
+ ************************************************************************/
+void readPerfCounters(const PerfCounters& counters,
+    double values[COUNTER_EVENTS])
+{
+    fill(values, values + COUNTER_EVENTS, 0.0);
+#ifdef __linux__
+    uint64_t buffer[3 + COUNTER_EVENTS]; // Count, enabled, running, values
+
+    if (counters.leader < 0 || read(counters.leader, buffer,
+        sizeof(buffer)) < (ssize_t)(3 * sizeof(uint64_t)) || buffer[2] == 0)
+        return;
+
+    double scale = (double)buffer[1] / (double)buffer[2];
+    for (int e = 0; e < COUNTER_EVENTS; e++)
+        if (counters.slots[e] >= 0 && (uint64_t)counters.slots[e] < buffer[0])
+            values[e] = buffer[3 + counters.slots[e]] * scale;
+#else
+    (void)counters;
+#endif
+}
+
+/** **********************************************************************
+ * @brief Moves on to a new phase, starting the counters when it is the
+ *        phase being counted and stopping them when it leaves it.
+ *
+ * @details Allocations made while the counters run are added to the
+ *          phase being counted.
+ *
+ * @param[in,out] counters The counters of the profile being recorded.
+ * @param[in] phase The PHASE_* code of the phase being entered, or -1 at
+ *                  the end of a play.
+ *
+ * @par Example
+ * @code{.cpp}
+ * switchPhase(*phaseCounters, PHASE_DEALER);
+ * @endcode
+ ************************************************************************/
+void switchPhase(PerfCounters& counters, int phase) noexcept
+{
+    if (phase == counters.phase)
+        return;
+
+    if (counters.phase == counters.target)
+    {
+        runPerfCounters(counters, false);
+        counters.allocations[counters.target] += allocationCount()
+            - counters.lastAllocations;
+    }
+    else if (phase == counters.target)
+    {
+        counters.entries[phase]++;
+        counters.lastAllocations = allocationCount();
+        runPerfCounters(counters, true);
+    }
+    counters.phase = phase;
+}
+
+/** **********************************************************************
+ * @brief Measures what one start and stop of the counters counts by
+ *        itself, into counters.switchCost.
+ *
+ * @details The counters are switched on and off SWITCH_SAMPLES times with
+ *          nothing between, through the same switchPhase() calls that a
+ *          phase play makes.
+ *
+ * @param[in,out] counters The counters, opened and stopped.
+ *
+ * @par Example
+ * @code{.cpp}
+ * measureSwitchCost(counters);
+ * @endcode
+ ************************************************************************/
+void measureSwitchCost(PerfCounters& counters)
+{
+    double counts[COUNTER_EVENTS];
+
+    enablePerfCounters(counters, true);
+    runPerfCounters(counters, false);
+    counters.target = PHASE_SHUFFLE;
+    counters.phase = PHASE_OTHER;
+    for (int sample = 0; sample < SWITCH_SAMPLES; sample++)
+    {
+        switchPhase(counters, PHASE_SHUFFLE);
+        switchPhase(counters, PHASE_OTHER);
+    }
+    readPerfCounters(counters, counts);
+    for (int e = 0; e < COUNTER_EVENTS; e++)
+        counters.switchCost[e] = counts[e] / SWITCH_SAMPLES;
+    counters.target = -1;
+    counters.entries[PHASE_SHUFFLE] = 0;
+    counters.allocations[PHASE_SHUFFLE] = 0;
+}
+
+/** **********************************************************************
+ * @brief Takes the cost of starting and stopping the counters off the
+ *        counts of each phase, and marks which counts it leaves resolved.
+ *
+ * @details Each phase loses counters.switchCost once for every time the
+ *          counters were started for it. A count is resolved only when
+ *          it was at least twice what is taken off, so that the phase's
+ *          own work is at least as large as the correction. Other counts
+ *          say nothing about the phase beyond that it is small.
+ *
+ * @param[in,out] counters The counters of the finished phase plays.
+ *
+ * @par Example
+ * @code{.cpp}
+ * removeSwitchCost(counters);
+ * @endcode
+ ************************************************************************/
+void removeSwitchCost(PerfCounters& counters)
+{
+    for (int phase = 0; phase < PHASES; phase++)
+        for (int e = 0; e < COUNTER_EVENTS; e++)
+        {
+            double cost = counters.entries[phase] * counters.switchCost[e];
+
+            counters.resolved[phase][e] = counters.counts[phase][e] > 0
+                && counters.counts[phase][e] >= 2.0 * cost;
+            counters.counts[phase][e] -= cost;
+        }
+}
+
+/** **********************************************************************
+ * @brief Plays every block of a run in order on the calling thread.
+ *
+ * @param[in] config The simulation parameters.
+ * @param[in] strategy The chart the player follows.
+ *
+ * @returns The totals, the same as those of a plain run.
+ *
+ * @par Example
+ * @code{.cpp}
+ * SimStats stats = playRunInOrder(config, strategy);
+ * @endcode
+ ************************************************************************/
+SimStats playRunInOrder(const SimConfig& config, const Strategy& strategy)
+{
+    SimWorkerState state;
+    SimStats total;
+    uint64_t blocks = (config.rounds + config.blockRounds - 1)
+        / config.blockRounds;
+
+    for (state.block = 0; state.block < blocks; state.block++)
+    {
+        uint64_t blockSize = min(config.blockRounds,
+            config.rounds - state.block * config.blockRounds);
+
+        state.stats = SimStats();
+        startBlock(state, config);
+        for (uint64_t round = 0; round < blockSize; round++)
+            simulateRound(state.shoe, state.engine, state.player, strategy,
+                config.bet, config.rules, state.stats, nullptr, nullptr,
+                config.insurance);
+        mergeStats(total, state.stats);
+    }
+    return total;
+}
+
+/** **********************************************************************
+ * @brief Plays a run with the counters running only during one phase.
+ *
+ * @param[in,out] counters The counters, opened and stopped. The counts,
+ *                         allocations and entries of the phase are filled.
+ * @param[in] config The simulation parameters.
+ * @param[in] strategy The chart the player follows.
+ * @param[in] phase The PHASE_* code of the phase to count.
+ *
+ * @returns The totals, the same as those of a plain run.
+ *
+ * @par Example
+ * @code{.cpp}
+ * SimStats dealt = playPhase(counters, config, strategy, PHASE_DEALER);
+ * @endcode
+ ************************************************************************/
+SimStats playPhase(PerfCounters& counters, const SimConfig& config,
+    const Strategy& strategy, int phase)
+{
+    enablePerfCounters(counters, true);
+    runPerfCounters(counters, false);
+    counters.target = phase;
+    counters.phase = -1;
+    switchPhase(counters, PHASE_OTHER);
+    phaseCounters = &counters;
+    SimStats stats = playRunInOrder(config, strategy);
+    phaseCounters = nullptr;
+    switchPhase(counters, -1);
+    readPerfCounters(counters, counters.counts[phase]);
+    counters.target = -1;
+    return stats;
+}
+
+/** **********************************************************************
+ * @brief Writes one line of the counter report.
+ *
+ * @param[in] name The name of the phase, or "Whole run".
+ * @param[in] counts The count of each event.
+ * @param[in] allocations The heap allocations.
+ * @param[in] counters The counters, which say which events were counted.
+ * @param[in] rounds The rounds played.
+ * @param[in] resolved Whether each count is above the resolution, or
+ *                     nullptr if all are. Counts below it are shown as
+ *                     "<res", and a line with no count above it says only
+ *                     "below resolution" and its allocations.
+ *
+ * @par Example
+ * @code{.cpp}
+ * writePerfLine("Dealer", counters.counts[PHASE_DEALER],
+ *     counters.allocations[PHASE_DEALER], counters, stats.rounds,
+ *     counters.resolved[PHASE_DEALER]);
+ * @endcode
+ ************************************************************************/
+void writePerfLine(const string& name, const double counts[COUNTER_EVENTS],
+    uint64_t allocations, const PerfCounters& counters, uint64_t rounds,
+    const bool resolved[COUNTER_EVENTS])
+{
+    double perRound = 1.0 / (double)max<uint64_t>(rounds, 1);
+    bool anyResolved = resolved == nullptr;
+
+    for (int e = 0; e < COUNTER_EVENTS; e++)
+        if (counters.handles[e] >= 0 && resolved && resolved[e])
+            anyResolved = true;
+
+    cout << left << setw(10) << name << right << fixed;
+    if (!anyResolved)
+        cout << setw(71) << left << "below resolution" << right;
+    for (int e = 0; e < COUNTER_EVENTS && anyResolved; e++)
+    {
+        int decimals = e == COUNTER_CYCLES || e == COUNTER_INSTRUCTIONS ? 1 : 3;
+        int width = e == COUNTER_TASK_CLOCK ? 9 : 11;
+
+        if (counters.handles[e] < 0)
+            cout << setw(width) << "-";
+        else if (resolved && !resolved[e])
+            cout << setw(width) << "<res";
+        else if (e == COUNTER_TASK_CLOCK)
+            cout << setw(9) << setprecision(1) << counts[e] * perRound;
+        else
+            cout << setw(11) << setprecision(decimals) << counts[e] * perRound;
+        if (e == COUNTER_INSTRUCTIONS)
+        {
+            if (counters.handles[COUNTER_CYCLES] < 0
+                || counts[COUNTER_CYCLES] <= 0
+                || (resolved && (!resolved[COUNTER_CYCLES]
+                || !resolved[COUNTER_INSTRUCTIONS])))
+                cout << setw(7) << "-";
+            else
+                cout << setw(7) << setprecision(2)
+                    << counts[COUNTER_INSTRUCTIONS] / counts[COUNTER_CYCLES];
+        }
+    }
+    if (countingAllocations())
+        cout << setw(9) << setprecision(3) << allocations * perRound;
+    else
+        cout << setw(9) << "-";
+    cout << "\n";
+    cout.unsetf(ios::floatfield);
+}
+
+/** **********************************************************************
+ * @brief Plays a run with performance counters, as `--perf-counters`
+ *        asks, and reports the counts per round for the whole run and for
+ *        each phase.
+ *
+ * @details The blocks are played in order on one thread so that the
+ *          counters follow all of the work. The usual report of the run
+ *          is printed first, with totals identical to those of a plain run
+ *          with the same options. With BJ_PROFILE_PHASES the run is then
+ *          played once more for each phase. Allocations are counted only in
+ *          builds with BJ_COUNT_ALLOCATIONS.
+ *
+ * @param[in] config The simulation parameters.
+ *
+ * @returns 0 on success, 1 if the plays disagreed.
+ *
+ * @par Example
+ * @code{.cpp}
+ * if (config.perfCounters)
+ *     return runPerfProfile(config);
+ * @endcode
+ ************************************************************************/
+int runPerfProfile(const SimConfig& config)
+{
+    const char* phaseNames[PHASES] = { "Other", "Shuffle", "Scoring",
+        "Dealer" };
+    PerfCounters counters;
+    Strategy strategy;
+    double whole[COUNTER_EVENTS];
+
+    basicStrategy(strategy);
+    openPerfCounters(counters);
+
+    uint64_t before = allocationCount();
+    auto start = chrono::steady_clock::now();
+    enablePerfCounters(counters, true);
+    SimStats stats = playRunInOrder(config, strategy);
+    readPerfCounters(counters, whole);
+    enablePerfCounters(counters, false);
+    double seconds = chrono::duration<double>(
+        chrono::steady_clock::now() - start).count();
+    uint64_t wholeAllocations = allocationCount() - before;
+
+    bool agreed = true;
+    if (profilingPhases())
+    {
+        measureSwitchCost(counters);
+        for (int phase = 0; phase < PHASES; phase++)
+            agreed = sameStats(stats, playPhase(counters, config, strategy,
+                phase)) && agreed;
+        removeSwitchCost(counters);
+    }
+
+    printSimReport(stats, config);
+    cout << "Profiled on one thread: " << fixed << setprecision(0)
+        << stats.rounds / max(seconds, 1e-9) << " rounds/s\n";
+    cout.unsetf(ios::floatfield);
+    if (!counters.problem.empty())
+        cout << "Counters missing, " << counters.problem << "\n";
+    if (!countingAllocations())
+        cout << "Allocations are counted only with BJ_COUNT_ALLOCATIONS\n";
+
+    cout << "Per round      Cycles      Instr    IPC  Br misses L1D misses"
+        << " LLC misses  Task ns   Allocs\n";
+    writePerfLine("Whole run", whole, wholeAllocations, counters,
+        stats.rounds);
+    if (profilingPhases())
+    {
+        uint64_t entries = 0;
+        for (int phase = PHASE_SHUFFLE; phase < PHASES; phase++)
+            writePerfLine(phaseNames[phase], counters.counts[phase],
+                counters.allocations[phase], counters, stats.rounds,
+                counters.resolved[phase]);
+        writePerfLine(phaseNames[PHASE_OTHER], counters.counts[PHASE_OTHER],
+            counters.allocations[PHASE_OTHER], counters, stats.rounds,
+            counters.resolved[PHASE_OTHER]);
+        for (int phase = 0; phase < PHASES; phase++)
+            entries += counters.entries[phase];
+        cout << "Each phase is counted in a play of its own, so the phases"
+            << " need not add up to\nthe whole run. The " << entries
+            << " starts of the counters, " << fixed << setprecision(0)
+            << counters.switchCost[COUNTER_TASK_CLOCK] << " task ns each,"
+            << " are taken\noff, and counts no larger than what was taken off"
+            << " are below resolution (<res)." << endl;
+        cout.unsetf(ios::floatfield);
+    }
+    else
+        cout << "Phases are profiled only with BJ_PROFILE_PHASES" << endl;
+    closePerfCounters(counters);
+
+    if (!agreed)
+    {
+        cerr << "The profiled plays disagreed" << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,257 @@
+/** **********************************************************************
+* @file
+*
+* @brief This file contains the definitions for the frame renderer, which
+*        collects console screens and simulation transcripts in a buffer
+*        that is allocated once and written out in a single call.
+************************************************************************/
+
+#include "blackjack.h"
+
+/** ***************************************************************************
+*                            Renderer Definitions
+******************************************************************************/
+
+/** **********************************************************************
+ * @brief FrameBuffer constructor that allocates the buffer up front.
+ *
+ * @details The target should be unbuffered, so that each frame reaches
+ *          the operating system in exactly one write.
+ *
+ * @param[in] out The C stream the frames are written to.
+ * @param[in] capacity The size of the buffer in bytes.
+ * @param[in] writeLock A mutex held while writing, for a target shared by
+ *                      several buffers, or nullptr.
+ *
+ * @par Example
+ * @code{.cpp}
+ * FrameBuffer screen(stdout, FRAME_BYTES);
+ * @endcode
+ ************************************************************************/
+FrameBuffer::FrameBuffer(FILE* out, size_t capacity, mutex* writeLock)
+    : storage(capacity), target(out), lock(writeLock), failed(false)
+{
+    setp(storage.data(), storage.data() + storage.size());
+}
+
+/** **********************************************************************
+ * @brief FrameBuffer destructor that writes out whatever is left.
+ ************************************************************************/
+FrameBuffer::~FrameBuffer()
+{
+    writeFrame();
+}
+
+/** **********************************************************************
+ * @brief Writes the buffered frame to the target and empties the buffer.
+ *
+ * @returns `true` if every byte so far has been written.
+ *
+ * @par Example
+ * @code{.cpp}
+ * screen.writeFrame();
+ * @endcode
+ ************************************************************************/
+bool FrameBuffer::writeFrame()
+{
+    size_t length = pptr() - pbase();
+
+    if (length > 0)
+    {
+        if (lock)
+            lock->lock();
+        if (fwrite(pbase(), 1, length, target) != length
+            || fflush(target) != 0)
+            failed = true;
+        if (lock)
+            lock->unlock();
+    }
+
+    setp(storage.data(), storage.data() + storage.size());
+    return !failed;
+}
+
+/** **********************************************************************
+ * @brief Writes the frame early if less than some room is left, so that
+ *        a record of at most that size is never split between writes.
+ *
+ * @param[in] reserve The room needed for the next record.
+ *
+ * @par Example
+ * @code{.cpp}
+ * frame.makeRoom(TRANSCRIPT_ROUND_BYTES);
+ * @endcode
+ ************************************************************************/
+void FrameBuffer::makeRoom(size_t reserve)
+{
+    if ((size_t)(epptr() - pptr()) < reserve)
+        writeFrame();
+}
+
+/** **********************************************************************
+ * @brief Called by the stream when the buffer is full. The frame so far
+ *        is written and the character starts the next one.
+ *
+ * @param[in] c The character that did not fit, or EOF.
+ *
+ * @returns The character, or EOF if the write failed.
+ ************************************************************************/
+int FrameBuffer::overflow(int c)
+{
+    if (!writeFrame())
+        return traits_type::eof();
+
+    if (c != traits_type::eof())
+    {
+        *pptr() = (char)c;
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+/** **********************************************************************
+ * @brief Called by the stream on a flush, including the one made before
+ *        reading from cin. The frame is written in one call.
+ *
+ * @returns 0 on success, -1 if the write failed.
+ ************************************************************************/
+int FrameBuffer::sync()
+{
+    return writeFrame() ? 0 : -1;
+}
+
+/** **********************************************************************
+ * @brief Formats one card in the short form used on screen, such as "AH"
+ *        or "10S".
+ *
+ * @param[out] text Where the characters are stored. At most 3 are used,
+ *                  and no terminator is added.
+ * @param[in] aCard The card.
+ *
+ * @returns The number of characters stored.
+ *
+ * @par Example
+ * @code{.cpp}
+ * char text[3];
+ * out.write(text, formatCard(text, aCard));
+ * @endcode
+ ************************************************************************/
+int formatCard(char* text, card aCard)
+{
+    int length = 0;
+
+    if (aCard.faceValue == 10)
+        text[length++] = '1';
+    text[length++] = "?A234567890JQK"[aCard.faceValue];
+    text[length++] = "HDCS"[aCard.suit];
+    return length;
+}
+
+/** **********************************************************************
+ * @brief Writes one card in the short form used on screen.
+ *
+ * @param[in,out] out The stream to write to.
+ * @param[in] aCard The card.
+ *
+ * @par Example
+ * @code{.cpp}
+ * writeCard(cout, dealer[0]);
+ * @endcode
+ ************************************************************************/
+void writeCard(ostream& out, card aCard)
+{
+    char text[3];
+
+    out.write(text, formatCard(text, aCard));
+}
+
+/** **********************************************************************
+ * @brief Overloads the << operator to print the cards of a simulated
+ *        hand in the same form as a CardQueue.
+ *
+ * @details The hand is formatted into a local buffer and handed to the
+ *          stream in one write.
+ *
+ * @param[in,out] out The output stream.
+ * @param[in] hand The hand to print.
+ *
+ * @returns A reference to the output stream.
+ *
+ * @par Example
+ * @code{.cpp}
+ * transcript << "Dealer: " << dHand << "(" << dHand.total << ")\n";
+ * @endcode
+ ************************************************************************/
+ostream& operator<<(ostream& out, const SimHand& hand)
+{
+    char text[MAX_HAND_CARDS * 4];
+    int length = 0;
+
+    for (int i = 0; i < hand.count; i++)
+    {
+        length += formatCard(text + length, hand.cards[i]);
+        text[length++] = ' ';
+    }
+    return out.write(text, length);
+}
+
+/** **********************************************************************
+ * @brief Adds the log of one simulated round to a transcript.
+ *
+ * @details The log has the same layout as the end of an interactive
+ *          round: the result with the tokens won or lost, then both
+ *          hands with their totals.
+ *
+ * @param[in,out] transcript The transcript stream.
+ * @param[in] pHand The player's final hand.
+ * @param[in] dHand The dealer's final hand.
+ * @param[in] whoWon 1 for a player win, 2 for a push, 3 for a loss.
+ * @param[in] net The tokens won, or lost when negative.
+ *
+ * @par Example
+ * @code{.cpp}
+ * writeRoundLog(*transcript, pHand, dHand, whoWon, player.bet);
+ * @endcode
+ ************************************************************************/
+void writeRoundLog(ostream& transcript, const SimHand& pHand,
+    const SimHand& dHand, int whoWon, int net)
+{
+    if (whoWon == 1)
+        transcript << "Player won ";
+    else if (whoWon == 2)
+        transcript << "Push ";
+    else
+        transcript << "Dealer won ";
+
+    transcript << net << "\n";
+    transcript << "Dealer: " << dHand << "(" << dHand.total << ")\n";
+    transcript << "Player: " << pHand << "(" << pHand.total << ")\n\n";
+}
+
+/** **********************************************************************
+ * @brief Opens the transcript file shared by every simulation worker.
+ *
+ * @details The file is unbuffered, since each worker already collects
+ *          many rounds in its own FrameBuffer and hands them over in one
+ *          write.
+ *
+ * @param[in,out] transcript The transcript to open.
+ * @param[in] fileName The file to write, which is replaced.
+ *
+ * @returns `true` if the file was opened.
+ *
+ * @par Example
+ * @code{.cpp}
+ * TranscriptFile transcript;
+ * openTranscript(transcript, "rounds.log");
+ * @endcode
+ ************************************************************************/
+bool openTranscript(TranscriptFile& transcript, const string& fileName)
+{
+    transcript.file = fopen(fileName.c_str(), "wb");
+    if (transcript.file == nullptr)
+        return false;
+
+    setvbuf(transcript.file, nullptr, _IONBF, 0);
+    return true;
+}
@@ -0,0 +1,429 @@
+/** **********************************************************************
+* @file
+*
+* @brief This file contains the definitions for recording the decisions of
+*        interactive rounds to a compact file and replaying them through
+*        the game, checking every round's token total against the trace
+*        stored with them.
+*
+* @details A decision file starts with a 24 byte header: the text
+*          "BJSCRIPT", the format version and the starting tokens as 32-bit
+*          integers, and the round count as a 64-bit integer. Each round
+*          then takes 14 bytes plus one per choice: the deck seed, the bet
+*          and the token total after the round as 32-bit integers, the
+*          insurance choice, the number of menu choices, and the choices
+*          themselves (1 hit, 2 double down, 3 stand, as in processChoice()).
+*          Integers are stored little-endian.
+************************************************************************/
+
+#include "blackjack.h"
+
+/** ***************************************************************************
+*                             Replay Definitions
+******************************************************************************/
+
+const char SCRIPT_MAGIC[8] = { 'B', 'J', 'S', 'C', 'R', 'I', 'P', 'T' };
+const uint32_t SCRIPT_VERSION = 2; // Bumped whenever the layout or the
+                                   // game's settlement changes
+const size_t SCRIPT_HEADER_BYTES = 24; // Magic, version, tokens, rounds
+const size_t SCRIPT_ROUND_BYTES = 14; // Round record before its choices
+
+/** **********************************************************************
+ * @brief Reads a little-endian integer of up to 8 bytes.
+ *
+ * @param[in] bytes The first byte.
+ * @param[in] count The number of bytes.
+ *
+ * @returns The integer.
+ ************************************************************************/
+uint64_t readLittle(const unsigned char* bytes, int count)
+{
+    uint64_t value = 0;
+
+    for (int i = count - 1; i >= 0; i--)
+        value = (value << 8) | bytes[i];
+    return value;
+}
+
+/** **********************************************************************
+ * @brief Writes a little-endian integer of up to 8 bytes.
+ *
+ * @param[in,out] out The stream to write to.
+ * @param[in] value The integer.
+ * @param[in] count The number of bytes.
+ ************************************************************************/
+void writeLittle(ostream& out, uint64_t value, int count)
+{
+    for (int i = 0; i < count; i++)
+        out.put((char)((value >> (8 * i)) & 0xFF));
+}
+
+/** **********************************************************************
+ * @brief Makes a whole file available in memory.
+ *
+ * @details On POSIX systems the file is mapped read-only, so replaying
+ *          even a very large decision file costs no copying and only the
+ *          pages actually touched are read. Elsewhere, or if mapping
+ *          fails, the file is read into a buffer instead.
+ *
+ * @param[in] fileName The file to open.
+ * @param[out] file The file's contents.
+ *
+ * @returns `true` if the file could be read.
+ *
+ * @par Example
+ * @code{.cpp}
+ * MappedFile file;
+ * if (mapFile("session.bjs", file))
+ *     replay(file.data, file.size);
+ * @endcode
+ ************************************************************************/
+bool mapFile(const string& fileName, MappedFile& file)
+{
+    unmapFile(file);
+
+#ifndef _WIN32
+    int handle = open(fileName.c_str(), O_RDONLY);
+    struct stat status;
+
+    if (handle >= 0 && fstat(handle, &status) == 0 && status.st_size > 0)
+    {
+        void* memory = mmap(nullptr, (size_t)status.st_size, PROT_READ,
+            MAP_PRIVATE, handle, 0);
+
+        if (memory != MAP_FAILED)
+        {
+            close(handle);
+            file.data = (const unsigned char*)memory;
+            file.size = (size_t)status.st_size;
+            file.mapped = true;
+            return true;
+        }
+    }
+    if (handle >= 0)
+        close(handle);
+#endif
+
+    ifstream in(fileName, ios::binary);
+    if (!in)
+        return false;
+
+    file.buffer.assign(istreambuf_iterator<char>(in),
+        istreambuf_iterator<char>());
+    file.data = file.buffer.data();
+    file.size = file.buffer.size();
+    return true;
+}
+
+/** **********************************************************************
+ * @brief Releases a file opened by mapFile().
+ *
+ * @param[in,out] file The file, which is left empty.
+ *
+ * @par Example
+ * @code{.cpp}
+ * unmapFile(file);
+ * @endcode
+ ************************************************************************/
+void unmapFile(MappedFile& file)
+{
+#ifndef _WIN32
+    if (file.mapped)
+        munmap((void*)file.data, file.size);
+#endif
+    file.data = nullptr;
+    file.size = 0;
+    file.mapped = false;
+    file.buffer.clear();
+}
+
+/** **********************************************************************
+ * @brief Supplies the next menu choice of a round from its script.
+ *
+ * @details When replaying, the recorded choices are handed out in order.
+ *          If the game asks for more than were recorded the script is
+ *          marked as failed and the player stands, which ends the round.
+ *          When recording, a choice is drawn at random: doubling down is
+ *          only tried as the first choice, and the player stands once the
+ *          script is nearly full, so every recorded round is bounded.
+ *
+ * @param[in,out] script The round's script.
+ *
+ * @returns 1 to hit, 2 to double down or 3 to stand.
+ *
+ * @par Example
+ * @code{.cpp}
+ * choice = nextScriptAction(*script);
+ * @endcode
+ ************************************************************************/
+int nextScriptAction(RoundScript& script)
+{
+    if (script.chooser)
+    {
+        int choice = ACTION_STAND;
+
+        if (script.actionCount < MAX_SCRIPT_ACTIONS - 1)
+            choice = script.actionCount == 0
+                ? 1 + (int)randBelow(*script.chooser, 3)
+                : (randBelow(*script.chooser, 2) ? ACTION_HIT : ACTION_STAND);
+
+        script.recorded[script.actionCount++] = (unsigned char)choice;
+        script.nextAction = script.actionCount;
+        return choice;
+    }
+
+    if (script.nextAction >= script.actionCount)
+    {
+        script.failed = true;
+        return ACTION_STAND;
+    }
+    return script.actions[script.nextAction++];
+}
+
+/** **********************************************************************
+ * @brief Plays one round exactly as main() does, but with the bet, deck
+ *        and choices taken from a script instead of the player.
+ *
+ * @param[in,out] session The session, whose deck is regenerated from the
+ *                        seed and whose tokens are settled.
+ * @param[in,out] script The round's choices.
+ * @param[in] seed The deck seed.
+ * @param[in] bet The bet placed on the round.
+ *
+ * @par Example
+ * @code{.cpp}
+ * playScriptedRound(session, script, seed, 20);
+ * @endcode
+ ************************************************************************/
+void playScriptedRound(GameSession& session, RoundScript& script,
+    unsigned seed, int bet)
+{
+    session.player.bet = bet;
+    generateDeck(session.deck, seed);
+    dealRound(session);
+    playRound(session, &script);
+    session.player.totalTokens += session.player.bet;
+    session.player.bet = 0;
+}
+
+/** **********************************************************************
+ * @brief Runs the record command, which plays rounds with random choices
+ *        and saves them with their token trace as a decision file.
+ *
+ * @details Seeds, bets, insurance answers and menu choices are all drawn
+ *          from `--seed`, so the same command always writes the same file.
+ *          Bets follow betMenu()'s rules. Recording stops early if the
+ *          player can no longer cover the minimum bet.
+ *
+ * @param[in] argc The number of arguments after the program name.
+ * @param[in] argv The arguments, starting with the command word.
+ *
+ * @returns 0 if the file was written, 1 otherwise.
+ *
+ * @par Example
+ * @code{.cpp}
+ * return runRecordCommand(argc - 1, argv + 1);
+ * @endcode
+ ************************************************************************/
+int runRecordCommand(int argc, char* argv[])
+{
+    uint64_t rounds = 1000000;
+    uint64_t seed = 1;
+    uint64_t tokens = 100000000;
+    string fileName;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string option = argv[i];
+
+        if (option == "--rounds" && i + 1 < argc && parseCount(argv[++i],
+            rounds))
+            continue;
+        else if (option == "--seed" && i + 1 < argc
+            && parseCount(argv[++i], seed))
+            continue;
+        else if (option == "--tokens" && i + 1 < argc
+            && parseCount(argv[++i], tokens) && tokens >= 10
+            && tokens <= INT32_MAX / 4)
+            continue;
+        else if (option.compare(0, 2, "--") != 0 && fileName.empty())
+            fileName = option;
+        else
+        {
+            printUsage();
+            return 1;
+        }
+    }
+
+    if (fileName.empty())
+    {
+        printUsage();
+        return 1;
+    }
+
+    ofstream out(fileName, ios::binary);
+    if (!out)
+    {
+        cerr << "Unable to write " << fileName << endl;
+        return 1;
+    }
+
+    mt19937_64 chooser(seed);
+    GameSession session((int)tokens);
+    Player& player = session.player;
+    RoundScript script;
+    uint64_t played = 0;
+
+    out.write(SCRIPT_MAGIC, sizeof(SCRIPT_MAGIC));
+    writeLittle(out, SCRIPT_VERSION, 4);
+    writeLittle(out, (uint32_t)tokens, 4);
+    writeLittle(out, 0, 8); // Round count, filled in at the end
+
+    cout.setstate(ios::badbit); // The game's screens are not wanted
+    for (; played < rounds && player.totalTokens >= 10; played++)
+    {
+        unsigned deckSeed = (unsigned)chooser();
+        int bet = 10 * (1 + (int)randBelow(chooser,
+            min(10, player.totalTokens / 10)));
+
+        script = RoundScript();
+        script.chooser = &chooser;
+        script.insurance = 1 + (int)randBelow(chooser, 2);
+
+        playScriptedRound(session, script, deckSeed, bet);
+
+        writeLittle(out, deckSeed, 4);
+        writeLittle(out, (uint32_t)bet, 4);
+        writeLittle(out, (uint32_t)player.totalTokens, 4);
+        out.put((char)script.insurance);
+        out.put((char)script.actionCount);
+        out.write((const char*)script.recorded, script.actionCount);
+    }
+    cout.clear();
+
+    out.seekp(16);
+    writeLittle(out, played, 8);
+    out.close();
+    if (!out)
+    {
+        cerr << "Unable to write " << fileName << endl;
+        return 1;
+    }
+
+    cout << "Recorded " << played << " rounds, final tokens "
+        << player.totalTokens << endl;
+    return 0;
+}
+
+/** **********************************************************************
+ * @brief Runs the replay command, which plays every round of a decision
+ *        file through the game and checks the token trace.
+ *
+ * @details The file is memory-mapped and each round's choices are read in
+ *          place. The game's screens are switched off by putting cout in
+ *          a failed state, so its output costs a single check per write.
+ *          The replay stops at the first round whose choices do not fit
+ *          the game or whose token total differs from the recording.
+ *
+ * @param[in] argc The number of arguments after the program name.
+ * @param[in] argv The arguments, starting with the command word.
+ *
+ * @returns 0 if every round matched, 1 otherwise.
+ *
+ * @par Example
+ * @code{.cpp}
+ * return runReplayCommand(argc - 1, argv + 1);
+ * @endcode
+ ************************************************************************/
+int runReplayCommand(int argc, char* argv[])
+{
+    MappedFile file;
+
+    if (argc != 2)
+    {
+        printUsage();
+        return 1;
+    }
+
+    if (!mapFile(argv[1], file))
+    {
+        cerr << "Unable to read " << argv[1] << endl;
+        return 1;
+    }
+
+    if (file.size < SCRIPT_HEADER_BYTES
+        || memcmp(file.data, SCRIPT_MAGIC, sizeof(SCRIPT_MAGIC)) != 0
+        || readLittle(file.data + 8, 4) != SCRIPT_VERSION)
+    {
+        cerr << argv[1] << " is not a decision file" << endl;
+        unmapFile(file);
+        return 1;
+    }
+
+    GameSession session((int)readLittle(file.data + 12, 4));
+    Player& player = session.player;
+    RoundScript script;
+    uint64_t rounds = readLittle(file.data + 16, 8);
+    size_t offset = SCRIPT_HEADER_BYTES;
+    string problem;
+    uint64_t round = 0;
+    auto start = chrono::steady_clock::now();
+
+    cout.setstate(ios::badbit);
+    while (round < rounds && problem.empty())
+    {
+        round++;
+        if (file.size - offset < SCRIPT_ROUND_BYTES
+            || file.size - offset - SCRIPT_ROUND_BYTES
+            < file.data[offset + 13])
+        {
+            problem = "the file ends early";
+            break;
+        }
+
+        const unsigned char* record = file.data + offset;
+        unsigned deckSeed = (unsigned)readLittle(record, 4);
+        int bet = (int)readLittle(record + 4, 4);
+        int expected = (int)readLittle(record + 8, 4);
+
+        script.actions = record + SCRIPT_ROUND_BYTES;
+        script.actionCount = record[13];
+        script.nextAction = 0;
+        script.insurance = record[12];
+        script.failed = false;
+        offset += SCRIPT_ROUND_BYTES + script.actionCount;
+
+        if (bet < 10 || bet % 10 != 0 || bet > player.totalTokens
+            || (script.insurance != 1 && script.insurance != 2))
+        {
+            problem = "the bet or insurance choice is invalid";
+            break;
+        }
+
+        playScriptedRound(session, script, deckSeed, bet);
+
+        if (script.failed || script.nextAction != script.actionCount)
+            problem = "the recorded choices do not fit the game";
+        else if (player.totalTokens != expected)
+            problem = "expected " + to_string(expected) + " tokens, got "
+                + to_string(player.totalTokens);
+    }
+    cout.clear();
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now()
+        - start).count();
+    unmapFile(file);
+
+    if (!problem.empty())
+    {
+        cerr << "Replay failed at round " << round << ": " << problem << endl;
+        return 1;
+    }
+
+    cout << "Replayed " << rounds << " rounds in " << fixed
+        << setprecision(3) << seconds << " s ("
+        << setprecision(0) << rounds / max(seconds, 1e-9)
+        << " rounds/s), final tokens " << player.totalTokens << endl;
+    cout.unsetf(ios::floatfield);
+    return 0;
+}
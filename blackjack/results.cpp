@@ -0,0 +1,245 @@
+/** **********************************************************************
+* @file
+*
+* @brief This file contains the definitions for the result files written
+*        by the shards of a split simulation, and for merging them into
+*        the report of the whole run.
+************************************************************************/
+
+#include "blackjack.h"
+
+/** ***************************************************************************
+*                             Result Definitions
+******************************************************************************/
+
+const int RESULT_VERSION = 2; // Bumped whenever the layout changes
+
+/** **********************************************************************
+ * @brief Saves the totals of a finished simulation to a result file.
+ *
+ * @details The file records every parameter that affects the rounds
+ *          played, the shard that was played and the integer totals. The
+ *          thread count is left out since it never changes the totals.
+ *          The file is written under a temporary name and then renamed,
+ *          so a merge never sees a half written result.
+ *
+ * @param[in] fileName The result file to write.
+ * @param[in] config The simulation parameters.
+ * @param[in] stats The totals of the rounds played.
+ *
+ * @returns `true` if the file was written.
+ *
+ * @par Example
+ * @code{.cpp}
+ * saveResult("shard0.result", config, stats);
+ * @endcode
+ ************************************************************************/
+bool saveResult(const string& fileName, const SimConfig& config,
+    const SimStats& stats)
+{
+    string tempName = fileName + ".tmp";
+
+    ofstream file(tempName);
+    if (!file)
+        return false;
+
+    file << "BJRESULT " << RESULT_VERSION << "\n";
+    file << "config " << config.rounds << " " << config.blockRounds << " "
+        << config.seed << " " << config.decks << " " << setprecision(17)
+        << config.penetration << " " << config.bet << " " << config.bankroll
+        << " " << config.machineSlots << " " << config.rules << " "
+        << config.insurance << "\n";
+    file << "shard " << config.shardIndex << " " << config.shardCount
+        << "\n";
+    writeStats(file, stats);
+
+    file.close();
+    if (!file)
+        return false;
+
+#ifdef _WIN32
+    remove(fileName.c_str()); // rename() will not replace a file on Windows
+#endif
+    return rename(tempName.c_str(), fileName.c_str()) == 0;
+}
+
+/** **********************************************************************
+ * @brief Loads a result file written by saveResult().
+ *
+ * @param[in] fileName The result file to read.
+ * @param[out] config The parameters and shard of the run.
+ * @param[out] stats The totals of the shard.
+ *
+ * @returns `true` if the file was read successfully and is consistent.
+ *
+ * @par Example
+ * @code{.cpp}
+ * SimConfig config;
+ * SimStats stats;
+ * loadResult("shard0.result", config, stats);
+ * @endcode
+ ************************************************************************/
+bool loadResult(const string& fileName, SimConfig& config, SimStats& stats)
+{
+    ifstream file(fileName);
+    string tag;
+    int version = 0;
+
+    file >> tag >> version;
+    if (!file || tag != "BJRESULT" || version < 1
+        || version > RESULT_VERSION)
+        return false;
+
+    file >> tag >> config.rounds >> config.blockRounds >> config.seed
+        >> config.decks >> config.penetration >> config.bet
+        >> config.bankroll >> config.machineSlots >> config.rules;
+    config.insurance = INSURANCE_NEVER; // Version 1 always declined it
+    if (version >= 2)
+        file >> config.insurance;
+    if (!file || tag != "config")
+        return false;
+
+    file >> tag >> config.shardIndex >> config.shardCount;
+    if (!file || tag != "shard" || config.shardCount < 1
+        || config.shardIndex >= config.shardCount)
+        return false;
+
+    return readStats(file, stats);
+}
+
+/** **********************************************************************
+ * @brief Checks whether two configurations describe the same run.
+ *
+ * @details Only the parameters that change the rounds played are
+ *          compared, so shards played with different thread counts or
+ *          checkpoint settings still belong to the same run.
+ *
+ * @param[in] first The first configuration.
+ * @param[in] second The second configuration.
+ *
+ * @returns `true` if both play exactly the same rounds.
+ *
+ * @par Example
+ * @code{.cpp}
+ * if (!sameRun(config, shardConfig))
+ *     cerr << "Shard belongs to another run" << endl;
+ * @endcode
+ ************************************************************************/
+bool sameRun(const SimConfig& first, const SimConfig& second)
+{
+    return first.rounds == second.rounds
+        && first.blockRounds == second.blockRounds
+        && first.seed == second.seed && first.decks == second.decks
+        && first.penetration == second.penetration
+        && first.bet == second.bet && first.bankroll == second.bankroll
+        && first.machineSlots == second.machineSlots
+        && first.rules == second.rules
+        && first.insurance == second.insurance;
+}
+
+/** **********************************************************************
+ * @brief Runs the merge command, which combines the result files of
+ *        every shard of a run into its final report.
+ *
+ * @details Every file must come from the same run and the same split, and
+ *          every shard must be present exactly once. Since the totals are
+ *          integer counts of whole blocks, the merged report is identical
+ *          to that of the run played in one piece, whatever the number of
+ *          shards. With `--result` the merged totals are saved as the
+ *          result of a single shard, so merges can themselves be merged
+ *          or kept.
+ *
+ * @param[in] argc The number of arguments after the program name.
+ * @param[in] argv The arguments, starting with the command word.
+ *
+ * @returns 0 if the merge succeeded, 1 otherwise.
+ *
+ * @par Example
+ * @code{.cpp}
+ * return runMergeCommand(argc - 1, argv + 1);
+ * @endcode
+ ************************************************************************/
+int runMergeCommand(int argc, char* argv[])
+{
+    SimConfig config;
+    SimStats total;
+    vector<string> files;
+    vector<bool> seen;
+    string resultFile;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string argument = argv[i];
+
+        if (argument == "--result" && i + 1 < argc)
+            resultFile = argv[++i];
+        else if (argument.compare(0, 2, "--") == 0)
+        {
+            printUsage();
+            return 1;
+        }
+        else
+            files.push_back(argument);
+    }
+
+    if (files.empty())
+    {
+        printUsage();
+        return 1;
+    }
+
+    for (size_t f = 0; f < files.size(); f++)
+    {
+        SimConfig shardConfig;
+        SimStats stats;
+
+        if (!loadResult(files[f], shardConfig, stats))
+        {
+            cerr << "Unable to read result " << files[f] << endl;
+            return 1;
+        }
+
+        if (f == 0)
+        {
+            config = shardConfig;
+            seen.assign(config.shardCount, false);
+        }
+        else if (!sameRun(config, shardConfig)
+            || shardConfig.shardCount != config.shardCount)
+        {
+            cerr << files[f] << " belongs to a different run or split"
+                << endl;
+            return 1;
+        }
+
+        if (seen[shardConfig.shardIndex])
+        {
+            cerr << "Shard " << shardConfig.shardIndex << "/"
+                << shardConfig.shardCount << " given more than once" << endl;
+            return 1;
+        }
+        seen[shardConfig.shardIndex] = true;
+        mergeStats(total, stats);
+    }
+
+    for (size_t shard = 0; shard < seen.size(); shard++)
+    {
+        if (!seen[shard])
+        {
+            cerr << "Missing shard " << shard << "/" << seen.size() << endl;
+            return 1;
+        }
+    }
+
+    config.shardIndex = 0;
+    config.shardCount = 1;
+    printSimReport(total, config);
+
+    if (!resultFile.empty() && !saveResult(resultFile, config, total))
+    {
+        cerr << "Unable to write result " << resultFile << endl;
+        return 1;
+    }
+
+    return 0;
+}
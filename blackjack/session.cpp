@@ -0,0 +1,495 @@
+/** **********************************************************************
+* @file
+*
+* @brief This file contains the definitions for snapshotting live game
+*        sessions into fixed-layout images and restoring them, so that a
+*        server can move or recover sessions without losing a round.
+*
+* @details A session image is a SessionImage of exactly SESSION_IMAGE_BYTES
+*          bytes with every field at a fixed offset, so it is read in place
+*          and never parsed. Cards take one byte each, the face value plus
+*          16 times the suit, as in a history file. A session file starts
+*          with a 32 byte header: the text "BJSESSNS", the format version
+*          and the image size as 32-bit integers, the session count as a
+*          64-bit integer, the number 0x01020304 written in the byte order
+*          of the machine that saved it, and four bytes of padding. The
+*          images follow back to back. Images are stored in that
+*          machine's byte order, since they are copied rather than parsed,
+*          and a file from a machine with the other byte order is refused.
+************************************************************************/
+
+#include "blackjack.h"
+
+/** ***************************************************************************
+*                             Session Definitions
+******************************************************************************/
+
+const char SESSION_MAGIC[8] = { 'B', 'J', 'S', 'E', 'S', 'S', 'N', 'S' };
+const uint32_t SESSION_VERSION = 1; // Bumped whenever the layout changes
+const size_t SESSION_HEADER_BYTES = 32; // Magic, version, size, count, order
+const uint32_t SESSION_BYTE_ORDER = 0x01020304; // Reads back the same only
+                                                // on a matching machine
+
+static_assert(sizeof(SessionImage) == SESSION_IMAGE_BYTES,
+    "A session image has a fixed size with no hidden padding");
+static_assert(is_trivially_copyable<SessionImage>::value,
+    "A session image is copied as raw bytes");
+static_assert(SESSION_HEADER_BYTES % alignof(SessionImage) == 0,
+    "Images in a mapped session file are aligned");
+
+/** **********************************************************************
+ * @brief Copies the cards of a queue into an image, front card first.
+ *
+ * @param[out] bytes Where the cards are stored.
+ * @param[in] queue The cards.
+ * @param[in] capacity The most cards the image has room for.
+ *
+ * @returns The number of cards stored.
+ ************************************************************************/
+int packCards(uint8_t* bytes, const CardQueue& queue, int capacity)
+{
+    int count = min(queue.size(), capacity);
+    int slot = queue.head;
+
+    for (int i = 0; i < count; i++)
+    {
+        const card& aCard = queue.cards[slot];
+
+        bytes[i] = (uint8_t)(aCard.faceValue + 16 * aCard.suit);
+        slot = slot + 1 == DECK_CARDS ? 0 : slot + 1; // Walks the ring
+    }
+    return count;
+}
+
+/** **********************************************************************
+ * @brief Refills a queue from the cards stored in an image.
+ *
+ * @param[out] queue The queue, which starts at its first slot.
+ * @param[in] bytes The stored cards.
+ * @param[in] count The number of cards.
+ *
+ * @returns `true` if every byte is a real card.
+ ************************************************************************/
+bool unpackCards(CardQueue& queue, const uint8_t* bytes, int count)
+{
+    bool valid = true;
+
+    queue.head = 0;
+    queue.count = count;
+    for (int i = 0; i < count; i++)
+    {
+        queue.cards[i].faceValue = bytes[i] & 15;
+        queue.cards[i].suit = bytes[i] >> 4;
+        valid = valid && queue.cards[i].faceValue >= 1
+            && queue.cards[i].faceValue <= 13 && queue.cards[i].suit <= 3;
+    }
+    return valid;
+}
+
+/** **********************************************************************
+ * @brief Saves the full state of a session into an image.
+ *
+ * @details The deck is stored from its next card on, so its ring buffer
+ *          position is not needed to restore it. Unused bytes are cleared,
+ *          so that equal sessions always give equal images. Hands longer
+ *          than MAX_HAND_CARDS cannot come up in play and are cut short.
+ *
+ * @param[in] session The session.
+ * @param[out] image The image to fill.
+ *
+ * @par Example
+ * @code{.cpp}
+ * SessionImage image;
+ * snapshotSession(session, image);
+ * @endcode
+ ************************************************************************/
+void snapshotSession(const GameSession& session, SessionImage& image)
+{
+    memset(&image, 0, sizeof(image));
+    image.totalTokens = session.player.totalTokens;
+    image.bet = session.player.bet;
+    image.whoWon = session.whoWon;
+    image.initialPhase = session.initialPhase ? 1 : 0;
+    image.canDoubleDown = session.canDoubleDown ? 1 : 0;
+    image.deckCount = (uint8_t)packCards(image.deck, session.deck,
+        DECK_CARDS);
+    image.playerCount = (uint8_t)packCards(image.player, session.pHand,
+        MAX_HAND_CARDS);
+    image.dealerCount = (uint8_t)packCards(image.dealer, session.dHand,
+        MAX_HAND_CARDS);
+}
+
+/** **********************************************************************
+ * @brief Restores a session from an image saved by snapshotSession().
+ *
+ * @details The image is checked as it is copied, since it may come from
+ *          a damaged or foreign file. The tokens must lie between 0 and
+ *          the most a decision file can record, and the bet between 0 and
+ *          the tokens, as betMenu() allows. The cards are written straight
+ *          into the session, so a refused image may leave it partly
+ *          restored.
+ *
+ * @param[in] image The image, which may be read in place from a mapped
+ *                  session file.
+ * @param[out] session The restored session.
+ *
+ * @returns `true` if the image holds a valid session.
+ *
+ * @par Example
+ * @code{.cpp}
+ * GameSession session;
+ * if (!restoreSession(image, session))
+ *     cerr << "Damaged session" << endl;
+ * @endcode
+ ************************************************************************/
+bool restoreSession(const SessionImage& image, GameSession& session)
+{
+    if (image.deckCount > DECK_CARDS || image.playerCount > MAX_HAND_CARDS
+        || image.dealerCount > MAX_HAND_CARDS
+        || image.deckCount + image.playerCount + image.dealerCount
+        > DECK_CARDS || image.initialPhase > 1 || image.canDoubleDown > 1
+        || image.whoWon < 0 || image.whoWon > 3 || image.totalTokens < 0
+        || image.totalTokens > INT32_MAX / 4 || image.bet < 0
+        || image.bet > image.totalTokens)
+        return false;
+
+    session.player.totalTokens = image.totalTokens;
+    session.player.bet = image.bet;
+    session.whoWon = image.whoWon;
+    session.initialPhase = image.initialPhase == 1;
+    session.canDoubleDown = image.canDoubleDown == 1;
+
+    return unpackCards(session.deck, image.deck, image.deckCount)
+        && unpackCards(session.pHand, image.player, image.playerCount)
+        && unpackCards(session.dHand, image.dealer, image.dealerCount);
+}
+
+/** **********************************************************************
+ * @brief Checks whether two sessions are in the same state, comparing
+ *        their cards in queue order rather than by buffer position.
+ *
+ * @param[in] first The first session.
+ * @param[in] second The second session.
+ *
+ * @returns `true` if both would play on identically.
+ *
+ * @par Example
+ * @code{.cpp}
+ * if (!sameSession(session, restored))
+ *     cerr << "Restore lost state" << endl;
+ * @endcode
+ ************************************************************************/
+bool sameSession(const GameSession& first, const GameSession& second)
+{
+    const CardQueue* firstQueues[] = { &first.deck, &first.pHand,
+        &first.dHand };
+    const CardQueue* secondQueues[] = { &second.deck, &second.pHand,
+        &second.dHand };
+
+    if (first.player.totalTokens != second.player.totalTokens
+        || first.player.bet != second.player.bet
+        || first.whoWon != second.whoWon
+        || first.initialPhase != second.initialPhase
+        || first.canDoubleDown != second.canDoubleDown)
+        return false;
+
+    for (int q = 0; q < 3; q++)
+    {
+        const CardQueue& a = *firstQueues[q];
+        const CardQueue& b = *secondQueues[q];
+
+        if (a.size() != b.size())
+            return false;
+        for (int i = 0; i < a.size(); i++)
+            if (a[i].faceValue != b[i].faceValue || a[i].suit != b[i].suit)
+                return false;
+    }
+    return true;
+}
+
+/** **********************************************************************
+ * @brief Saves many session images to a session file.
+ *
+ * @details The file is written under a temporary name and then renamed,
+ *          so a reader never sees half of a checkpoint.
+ *
+ * @param[in] fileName The file to write, which is replaced.
+ * @param[in] images The images.
+ *
+ * @returns `true` if the file was written.
+ *
+ * @par Example
+ * @code{.cpp}
+ * saveSessionFile("sessions.bjs", images);
+ * @endcode
+ ************************************************************************/
+bool saveSessionFile(const string& fileName,
+    const vector<SessionImage>& images)
+{
+    string tempName = fileName + ".tmp";
+    ofstream out(tempName, ios::binary);
+
+    if (!out)
+        return false;
+
+    out.write(SESSION_MAGIC, sizeof(SESSION_MAGIC));
+    writeLittle(out, SESSION_VERSION, 4);
+    writeLittle(out, SESSION_IMAGE_BYTES, 4);
+    writeLittle(out, images.size(), 8);
+    out.write((const char*)&SESSION_BYTE_ORDER, 4);
+    writeLittle(out, 0, 4); // Pads the header to a whole number of words
+    out.write((const char*)images.data(),
+        (streamsize)(images.size() * sizeof(SessionImage)));
+
+    out.close();
+    if (!out)
+        return false;
+
+#ifdef _WIN32
+    remove(fileName.c_str()); // rename() will not replace a file on Windows
+#endif
+    return rename(tempName.c_str(), fileName.c_str()) == 0;
+}
+
+/** **********************************************************************
+ * @brief Finds the session images of a mapped session file.
+ *
+ * @param[in] file The mapped file.
+ * @param[out] images The first image, read in place.
+ * @param[out] count The number of images.
+ *
+ * @returns `true` if the file is a complete session file written on a
+ *          machine with the same byte order.
+ *
+ * @par Example
+ * @code{.cpp}
+ * const SessionImage* images;
+ * uint64_t count;
+ * findSessionImages(file, images, count);
+ * @endcode
+ ************************************************************************/
+bool findSessionImages(const MappedFile& file, const SessionImage*& images,
+    uint64_t& count)
+{
+    uint32_t order = 0;
+
+    if (file.size < SESSION_HEADER_BYTES
+        || memcmp(file.data, SESSION_MAGIC, sizeof(SESSION_MAGIC)) != 0
+        || readLittle(file.data + 8, 4) != SESSION_VERSION
+        || readLittle(file.data + 12, 4) != SESSION_IMAGE_BYTES)
+        return false;
+
+    memcpy(&order, file.data + 24, 4);
+    count = readLittle(file.data + 16, 8);
+    if (order != SESSION_BYTE_ORDER
+        || (file.size - SESSION_HEADER_BYTES) / SESSION_IMAGE_BYTES < count)
+        return false;
+
+    images = (const SessionImage*)(file.data + SESSION_HEADER_BYTES);
+    return true;
+}
+
+/** **********************************************************************
+ * @brief Builds a session paused at a random point of a round, for
+ *        exercising snapshots.
+ *
+ * @details A bet is placed and the opening cards are dealt from a fresh
+ *          deck with dealRound(), then the player takes up to three hits,
+ *          stopping early on a bust.
+ *
+ * @param[in,out] chooser The random source.
+ *
+ * @returns The session.
+ *
+ * @par Example
+ * @code{.cpp}
+ * GameSession session = randomSession(chooser);
+ * @endcode
+ ************************************************************************/
+GameSession randomSession(mt19937_64& chooser)
+{
+    GameSession session(10 * (1 + (int)randBelow(chooser, 100000)));
+    int hits = (int)randBelow(chooser, 4);
+
+    session.player.bet = 10 * (1 + (int)randBelow(chooser,
+        session.player.totalTokens / 10));
+    generateDeck(session.deck, (unsigned)chooser());
+    dealRound(session);
+
+    for (int i = 0; i < hits && session.whoWon == 0; i++)
+    {
+        session.pHand.push(session.deck.front());
+        session.deck.pop();
+        session.canDoubleDown = false;
+        if (sumHand(session.pHand) > 21)
+        {
+            session.whoWon = 3;
+            session.initialPhase = false;
+        }
+    }
+    return session;
+}
+
+/** **********************************************************************
+ * @brief Plays the rounds in progress in two sessions to their end with
+ *        the same random choices, and checks that they finish alike.
+ *
+ * @details Each round is played by playRound(), exactly as the game plays
+ *          it, with its menu choices and insurance answer drawn from the
+ *          seed. The game's screens are switched off while it plays.
+ *
+ * @param[in,out] first The first session, such as one before a snapshot.
+ * @param[in,out] second The second session, such as its restored copy.
+ * @param[in] seed The seed of the choices.
+ *
+ * @returns `true` if both sessions asked for the same choices and ended in
+ *          the same state.
+ *
+ * @par Example
+ * @code{.cpp}
+ * if (!playsOnAlike(session, restored, chooser()))
+ *     cerr << "Restored session played differently" << endl;
+ * @endcode
+ ************************************************************************/
+bool playsOnAlike(GameSession& first, GameSession& second, uint64_t seed)
+{
+    mt19937_64 firstChooser(seed);
+    mt19937_64 secondChooser(seed);
+    RoundScript firstScript;
+    RoundScript secondScript;
+
+    firstScript.chooser = &firstChooser;
+    secondScript.chooser = &secondChooser;
+    firstScript.insurance = secondScript.insurance = 1 + (int)(seed & 1);
+
+    cout.setstate(ios::badbit);
+    playRound(first, &firstScript);
+    playRound(second, &secondScript);
+    cout.clear();
+
+    return firstScript.actionCount == secondScript.actionCount
+        && memcmp(firstScript.recorded, secondScript.recorded,
+        firstScript.actionCount) == 0 && sameSession(first, second);
+}
+
+/** **********************************************************************
+ * @brief Runs the sessions command, which snapshots many live sessions to
+ *        a session file, restores them from the mapped file and reports
+ *        the time taken per session.
+ *
+ * @details Every restored session is compared with the original, and the
+ *          command fails at the first one that differs. Each pair is then
+ *          played on to the end of its round with the same choices, which
+ *          must leave them alike as well.
+ *
+ * @param[in] argc The number of arguments after the program name.
+ * @param[in] argv The arguments, starting with the command word.
+ *
+ * @returns 0 if every session survived the round trip, 1 otherwise.
+ *
+ * @par Example
+ * @code{.cpp}
+ * return runSessionCommand(argc - 1, argv + 1);
+ * @endcode
+ ************************************************************************/
+int runSessionCommand(int argc, char* argv[])
+{
+    uint64_t count = 100000;
+    uint64_t seed = 1;
+
+    if (argc < 2 || argc % 2 != 0)
+    {
+        printUsage();
+        return 1;
+    }
+
+    string fileName = argv[1];
+
+    for (int i = 2; i < argc; i += 2)
+    {
+        string option = argv[i];
+
+        if (option == "--count" && parseCount(argv[i + 1], count)
+            && count >= 1)
+            continue;
+        else if (option == "--seed" && parseCount(argv[i + 1], seed))
+            continue;
+
+        cerr << "Invalid option: " << option << " " << argv[i + 1] << endl;
+        return 1;
+    }
+
+    mt19937_64 chooser(seed);
+    vector<GameSession> sessions;
+    vector<SessionImage> images(count);
+
+    sessions.reserve(count);
+    for (uint64_t i = 0; i < count; i++)
+        sessions.push_back(randomSession(chooser));
+
+    auto start = chrono::steady_clock::now();
+    for (uint64_t i = 0; i < count; i++)
+        snapshotSession(sessions[i], images[i]);
+    double snapshotSeconds = chrono::duration<double>(
+        chrono::steady_clock::now() - start).count();
+
+    if (!saveSessionFile(fileName, images))
+    {
+        cerr << "Unable to write " << fileName << endl;
+        return 1;
+    }
+
+    MappedFile file;
+    const SessionImage* mapped = nullptr;
+    uint64_t mappedCount = 0;
+
+    if (!mapFile(fileName, file) || !findSessionImages(file, mapped,
+        mappedCount) || mappedCount != count)
+    {
+        cerr << fileName << " is not a session file" << endl;
+        unmapFile(file);
+        return 1;
+    }
+
+    vector<GameSession> restored(count);
+    uint64_t failed = count;
+
+    start = chrono::steady_clock::now();
+    for (uint64_t i = 0; i < count && failed == count; i++)
+        if (!restoreSession(mapped[i], restored[i]))
+            failed = i;
+    double restoreSeconds = chrono::duration<double>(
+        chrono::steady_clock::now() - start).count();
+    unmapFile(file);
+
+    for (uint64_t i = 0; i < count && failed == count; i++)
+        if (!sameSession(sessions[i], restored[i]))
+            failed = i;
+
+    if (failed != count)
+    {
+        cerr << "Session " << failed << " did not survive the round trip"
+            << endl;
+        return 1;
+    }
+
+    for (uint64_t i = 0; i < count && failed == count; i++)
+        if (!playsOnAlike(sessions[i], restored[i], chooser()))
+            failed = i;
+
+    if (failed != count)
+    {
+        cerr << "Session " << failed << " played on differently once restored"
+            << endl;
+        return 1;
+    }
+
+    cout << "Saved " << count << " sessions of " << SESSION_IMAGE_BYTES
+        << " bytes to " << fileName << "\n" << fixed << setprecision(1)
+        << "Snapshot: " << snapshotSeconds * 1e9 / count
+        << " ns per session\n"
+        << "Restore:  " << restoreSeconds * 1e9 / count
+        << " ns per session" << endl;
+    cout.unsetf(ios::floatfield);
+    return 0;
+}
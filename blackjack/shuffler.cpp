@@ -0,0 +1,192 @@
+/** **********************************************************************
+* @file
+*
+* @brief This file contains the definitions for the continuous shuffling
+*        machine model, where every round's cards go back into the machine
+*        instead of waiting for the shoe to be reshuffled.
+************************************************************************/
+
+#include "blackjack.h"
+
+/** ***************************************************************************
+*                       Shuffling Machine Definitions
+******************************************************************************/
+
+const int MACHINE_MIN_TRAY = 10; // Tray level that triggers a slot release
+
+/** **********************************************************************
+ * @brief Loads every card of the shoe into an empty shuffling machine.
+ *
+ * @details The shoe is given one ordinary shuffle, as a dealer would before
+ *          loading the machine, and each card is then dropped into a
+ *          random slot. Slots are released onto the tray until it holds
+ *          enough cards to deal from.
+ *
+ * @param[in,out] shoe The shoe, which must have a machine.
+ * @param[in,out] engine The random engine that drives the machine.
+ *
+ * @par Example
+ * @code{.cpp}
+ * Shoe shoe(6, 0.75, 20);
+ * loadMachine(shoe, engine);
+ * @endcode
+ ************************************************************************/
+void loadMachine(Shoe& shoe, mt19937_64& engine)
+{
+    ShuffleMachine& machine = shoe.machine;
+
+    for (int i = (int)shoe.cards.size() - 1; i > 0; i--)
+        swap(shoe.cards[i], shoe.cards[randBelow(engine, i + 1)]);
+
+    fill(machine.slotSizes.begin(), machine.slotSizes.end(), 0);
+    fill(machine.filledIndex.begin(), machine.filledIndex.end(), -1);
+    machine.filled.clear();
+    machine.trayHead = 0;
+    machine.trayCount = 0;
+    shoe.composition = Composition();
+
+    for (const card& aCard : shoe.cards)
+        returnCard(shoe, engine, aCard);
+
+    while (machine.trayCount < MACHINE_MIN_TRAY && !machine.filled.empty())
+        releaseSlot(machine, engine);
+
+    shoe.position = 0;
+    shoe.runningCount = 0;
+}
+
+/** **********************************************************************
+ * @brief Returns one discarded card to the shuffling machine.
+ *
+ * @details The card goes into a random slot that still has room, at a
+ *          random height in that slot's stack. The height is chosen by
+ *          placing the card on top and swapping it with a random card of
+ *          the stack, so a return costs O(1) no matter how full the slot
+ *          is. The card is no longer seen, so it is taken back out of the
+ *          running count and added back to the composition.
+ *
+ * @param[in,out] shoe The shoe, which must have a machine.
+ * @param[in,out] engine The random engine that drives the machine.
+ * @param[in] aCard The card being returned.
+ *
+ * @par Example
+ * @code{.cpp}
+ * returnCard(shoe, engine, aCard);
+ * @endcode
+ ************************************************************************/
+void returnCard(Shoe& shoe, mt19937_64& engine, card aCard)
+{
+    ShuffleMachine& machine = shoe.machine;
+    int slot;
+
+    do
+    {
+        slot = (int)randBelow(engine, machine.slotCount);
+    } while (machine.slotSizes[slot] == machine.slotCapacity);
+
+    int base = slot * machine.slotCapacity;
+    int size = machine.slotSizes[slot];
+    int height = (int)randBelow(engine, size + 1);
+
+    machine.slots[base + size] = aCard;
+    swap(machine.slots[base + height], machine.slots[base + size]);
+    machine.slotSizes[slot] = size + 1;
+
+    if (machine.filledIndex[slot] < 0)
+    {
+        machine.filledIndex[slot] = (int)machine.filled.size();
+        machine.filled.push_back(slot);
+    }
+
+    shoe.runningCount -= hiLoValue(aCard);
+    addRank(shoe.composition, cardRank(aCard));
+}
+
+/** **********************************************************************
+ * @brief Returns every card of a finished hand to the shuffling machine.
+ *
+ * @param[in,out] shoe The shoe, which must have a machine.
+ * @param[in,out] engine The random engine that drives the machine.
+ * @param[in] hand The hand being collected.
+ *
+ * @par Example
+ * @code{.cpp}
+ * returnHand(shoe, engine, pHand);
+ * @endcode
+ ************************************************************************/
+void returnHand(Shoe& shoe, mt19937_64& engine, const SimHand& hand)
+{
+    for (int i = 0; i < hand.count; i++)
+        returnCard(shoe, engine, hand.cards[i]);
+}
+
+/** **********************************************************************
+ * @brief Releases the stack of one random non-empty slot onto the tray.
+ *
+ * @details The slot's cards are moved to the back of the tray in stack
+ *          order. This costs one step per card moved, which is one step
+ *          per card dealt over the life of the machine.
+ *
+ * @param[in,out] machine The shuffling machine, with at least one
+ *                        non-empty slot.
+ * @param[in,out] engine The random engine that drives the machine.
+ *
+ * @par Example
+ * @code{.cpp}
+ * releaseSlot(shoe.machine, engine);
+ * @endcode
+ ************************************************************************/
+void releaseSlot(ShuffleMachine& machine, mt19937_64& engine)
+{
+    int pick = (int)randBelow(engine, machine.filled.size());
+    int slot = machine.filled[pick];
+    int base = slot * machine.slotCapacity;
+    int traySize = (int)machine.tray.size();
+
+    for (int i = 0; i < machine.slotSizes[slot]; i++)
+    {
+        machine.tray[(machine.trayHead + machine.trayCount) % traySize]
+            = machine.slots[base + i];
+        machine.trayCount++;
+    }
+    machine.slotSizes[slot] = 0;
+
+    // Remove the slot from the filled list by moving the last entry over it
+    int last = machine.filled.back();
+    machine.filled[pick] = last;
+    machine.filledIndex[last] = pick;
+    machine.filled.pop_back();
+    machine.filledIndex[slot] = -1;
+}
+
+/** **********************************************************************
+ * @brief Deals the next card from the shuffling machine's tray.
+ *
+ * @details Slots are released first if the tray has run low, so the tray
+ *          always holds the next card.
+ *
+ * @param[in,out] shoe The shoe, which must have a machine.
+ * @param[in,out] engine The random engine that drives the machine.
+ *
+ * @returns The dealt card.
+ *
+ * @par Example
+ * @code{.cpp}
+ * card aCard = machineDraw(shoe, engine);
+ * @endcode
+ ************************************************************************/
+card machineDraw(Shoe& shoe, mt19937_64& engine)
+{
+    ShuffleMachine& machine = shoe.machine;
+
+    while (machine.trayCount <= MACHINE_MIN_TRAY && !machine.filled.empty())
+        releaseSlot(machine, engine);
+
+    card aCard = machine.tray[machine.trayHead];
+    machine.trayHead = (machine.trayHead + 1) % (int)machine.tray.size();
+    machine.trayCount--;
+
+    shoe.runningCount += hiLoValue(aCard);
+    removeRank(shoe.composition, cardRank(aCard));
+    return aCard;
+}
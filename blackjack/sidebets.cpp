@@ -0,0 +1,563 @@
+/** **********************************************************************
+* @file
+*
+* @brief This file contains the definitions for the side bet evaluator,
+*        which works out the house edge of Perfect Pairs, 21+3 and Lucky
+*        Ladies from the opening cards of each round, either by simulation
+*        bucketed by true count or exactly for a given shoe.
+*
+* @details Perfect Pairs pays 25:1 for a pair of the same suit, 12:1 for a
+*          pair of the same colour and 6:1 for any other pair. 21+3 treats
+*          the player's two cards and the dealer's upcard as a poker hand
+*          and pays 100:1 for suited trips, 40:1 for a straight flush,
+*          30:1 for trips, 10:1 for a straight and 5:1 for a flush. Lucky
+*          Ladies pays on a two-card 20: 1000:1 for two queens of hearts
+*          against a dealer natural, 125:1 for two queens of hearts, 19:1
+*          for a matched 20 (same face value and suit), 9:1 for a suited
+*          20 and 4:1 for any other 20.
+************************************************************************/
+
+#include "blackjack.h"
+
+/** ***************************************************************************
+*                            Side Bet Definitions
+******************************************************************************/
+
+const int QUEEN_OF_HEARTS = (12 - 1) * 4 + 0; // sideIndex() of the QH
+
+/** **********************************************************************
+ * @brief Works out the side bet lookup tables.
+ *
+ * @details Cards are numbered as sideIndex() does, so the face value of
+ *          card i is i / 4 + 1 and its suit is i % 4. Hearts and diamonds
+ *          (suits 0 and 1) are red.
+ *
+ * @returns The tables.
+ ************************************************************************/
+constexpr SideTables buildSideTables()
+{
+    SideTables tables = {};
+
+    for (int i = 0; i < SIDE_CARDS; i++)
+    {
+        for (int j = 0; j < SIDE_CARDS; j++)
+        {
+            int face[2] = { i / 4 + 1, j / 4 + 1 };
+            int points[2] = {};
+            bool suited = (i % 4 == j % 4);
+
+            for (int k = 0; k < 2; k++)
+                points[k] = face[k] == 1 ? 11 : (face[k] > 10 ? 10 : face[k]);
+
+            tables.pairs[i][j] = -1;
+            if (face[0] == face[1])
+                tables.pairs[i][j] = suited ? 25
+                    : (i % 4 / 2 == j % 4 / 2 ? 12 : 6);
+
+            tables.ladies[i][j] = -1;
+            if (points[0] + points[1] == 20)
+            {
+                if (i == QUEEN_OF_HEARTS && j == QUEEN_OF_HEARTS)
+                    tables.ladies[i][j] = 125;
+                else if (suited && face[0] == face[1])
+                    tables.ladies[i][j] = 19;
+                else
+                    tables.ladies[i][j] = suited ? 9 : 4;
+            }
+        }
+    }
+
+    for (int low = 1; low <= 11; low++)
+        tables.straights[7 << low] = true;
+    tables.straights[(1 << 1) | (1 << 12) | (1 << 13)] = true; // Q K A
+
+    return tables;
+}
+
+constexpr SideTables SIDE_TABLES = buildSideTables();
+
+static_assert(SIDE_TABLES.straights[(1 << 1) | (1 << 2) | (1 << 3)],
+    "Ace, two and three make a straight");
+static_assert(!SIDE_TABLES.straights[(1 << 13) | (1 << 1) | (1 << 2)],
+    "King, ace and two do not make a straight");
+static_assert(SIDE_TABLES.pairs[QUEEN_OF_HEARTS][QUEEN_OF_HEARTS + 1] == 12,
+    "Hearts and diamonds are a coloured pair");
+
+/** **********************************************************************
+ * @brief Runs the sidebets command from the command line.
+ *
+ * @details By default the usual simulation options describe a run whose
+ *          opening cards are collected into batches and scored, and the
+ *          edges are shown by the true count before each deal. With
+ *          `--exact`, the edges are instead worked out exactly for a
+ *          shoe of `--decks` decks with the cards given by `--remove`
+ *          (such as "AH,10S,QD") taken out.
+ *
+ * @param[in] argc The number of arguments after the program name.
+ * @param[in] argv The arguments, starting with the command word.
+ *
+ * @returns 0 if the edges were shown, 1 if the arguments were invalid.
+ *
+ * @par Example
+ * @code{.cpp}
+ * return runSideBetCommand(argc - 1, argv + 1);
+ * @endcode
+ ************************************************************************/
+int runSideBetCommand(int argc, char* argv[])
+{
+    const char* names[SIDE_BETS] = { "Perfect Pairs", "21+3",
+        "Lucky Ladies" };
+    vector<char*> simArgs(1, argv[0]);
+    SimConfig config;
+    string resumeFile;
+    string remove;
+    bool exact = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string option = argv[i];
+
+        if (option == "--exact")
+            exact = true;
+        else if (option == "--remove" && i + 1 < argc)
+            remove = argv[++i];
+        else
+            simArgs.push_back(argv[i]);
+    }
+
+    if (!parseSimArgs((int)simArgs.size(), simArgs.data(), config,
+        resumeFile) || !resumeFile.empty())
+    {
+        printUsage();
+        return 1;
+    }
+    if (config.insurance != INSURANCE_NEVER || config.shardCount > 1
+        || config.precision > 0.0 || config.perfCounters
+        || !config.checkpointFile.empty() || !config.resultFile.empty()
+        || !config.transcriptFile.empty())
+    {
+        cerr << "sidebets measures a plain run of a dealt shoe" << endl;
+        return 1;
+    }
+    if (config.machineSlots > 0)
+    {
+        cerr << "sidebets needs a dealt shoe, not a continuous shuffler"
+            << endl;
+        return 1;
+    }
+
+    cout << fixed << setprecision(4);
+    if (exact)
+    {
+        int counts[SIDE_CARDS];
+        double edges[SIDE_BETS];
+        istringstream list(remove);
+        string text;
+        card aCard;
+
+        for (int i = 0; i < SIDE_CARDS; i++)
+            counts[i] = config.decks;
+        while (getline(list, text, ','))
+        {
+            if (!parseCard(text, aCard) || counts[sideIndex(aCard)] == 0)
+            {
+                cerr << "Cannot remove " << text << " from the shoe" << endl;
+                return 1;
+            }
+            counts[sideIndex(aCard)]--;
+        }
+
+        exactSideBets(counts, edges);
+        cout << "Exact side bet edges, " << config.decks << " deck"
+            << (config.decks > 1 ? "s" : "");
+        if (!remove.empty())
+            cout << " without " << remove;
+        cout << "\n";
+        for (int bet = 0; bet < SIDE_BETS; bet++)
+            cout << left << setw(14) << names[bet] << right << setw(9)
+                << edges[bet] << "%\n";
+        cout.flush();
+        cout.unsetf(ios::floatfield);
+        return 0;
+    }
+
+    vector<SideStats> parts(config.threads);
+    vector<thread> threads;
+    SideStats total;
+
+    for (int w = 0; w < config.threads; w++)
+        threads.emplace_back(runSideBetWorker, cref(config), w,
+            ref(parts[w]));
+    for (thread& worker : threads)
+        worker.join();
+
+    for (const SideStats& part : parts)
+    {
+        for (int b = 0; b < TC_BUCKETS; b++)
+        {
+            total.rounds[b] += part.rounds[b];
+            for (int bet = 0; bet < SIDE_BETS; bet++)
+            {
+                total.net[bet][b] += part.net[bet][b];
+                total.netSquares[bet][b] += part.netSquares[bet][b];
+            }
+        }
+    }
+
+    uint64_t deals = 0;
+
+    for (int b = 0; b < TC_BUCKETS; b++)
+        deals += total.rounds[b];
+
+    cout << "Side bet edges by true count, " << config.decks << " decks, "
+        << deals << " deals\n";
+    cout << "  TC    Deals %";
+    for (int bet = 0; bet < SIDE_BETS; bet++)
+        cout << setw(19) << names[bet];
+    cout << "\n";
+    // Every bucket's row, then the whole run's row as bucket TC_BUCKETS
+    for (int b = 0; b <= TC_BUCKETS; b++)
+    {
+        uint64_t rounds = 0;
+        int64_t net[SIDE_BETS] = {};
+        uint64_t squares[SIDE_BETS] = {};
+
+        for (int k = (b == TC_BUCKETS ? 0 : b);
+            k < (b == TC_BUCKETS ? TC_BUCKETS : b + 1); k++)
+        {
+            rounds += total.rounds[k];
+            for (int bet = 0; bet < SIDE_BETS; bet++)
+            {
+                net[bet] += total.net[bet][k];
+                squares[bet] += total.netSquares[bet][k];
+            }
+        }
+        if (rounds == 0)
+            continue;
+
+        if (b == TC_BUCKETS)
+            cout << " All";
+        else
+            cout << showpos << setw(4) << b + TC_MIN << noshowpos;
+        cout << setw(11) << 100.0 * rounds / max<uint64_t>(deals, 1);
+        for (int bet = 0; bet < SIDE_BETS; bet++)
+        {
+            double mean = (double)net[bet] / rounds;
+            double variance = max(0.0, (double)squares[bet] / rounds
+                - mean * mean);
+
+            cout << setw(10) << -mean * 100.0 << " +/-" << setw(5)
+                << setprecision(1) << 196.0 * sqrt(variance / rounds)
+                << setprecision(4);
+        }
+        cout << "\n";
+    }
+    cout.flush();
+    cout.unsetf(ios::floatfield);
+    return 0;
+}
+
+/** **********************************************************************
+ * @brief Numbers a card for the side bet lookup tables.
+ *
+ * @param[in] aCard The card.
+ *
+ * @returns 4 times the face value less one, plus the suit: 0 through 51.
+ *
+ * @par Example
+ * @code{.cpp}
+ * int index = sideIndex(pHand.cards[0]);
+ * @endcode
+ ************************************************************************/
+int sideIndex(card aCard)
+{
+    return (aCard.faceValue - 1) * 4 + aCard.suit;
+}
+
+/** **********************************************************************
+ * @brief Reads a card in the short form used on screen, such as "AH" or
+ *        "10S".
+ *
+ * @param[in] text The card text.
+ * @param[out] aCard The card.
+ *
+ * @returns `true` if the text names a card.
+ *
+ * @par Example
+ * @code{.cpp}
+ * card aCard;
+ * parseCard("QH", aCard);
+ * @endcode
+ ************************************************************************/
+bool parseCard(const string& text, card& aCard)
+{
+    const string faces = "A234567890JQK";
+    const string suits = "HDCS";
+    string face = text.substr(0, text.size() > 0 ? text.size() - 1 : 0);
+
+    if (face == "10")
+        face = "0";
+    if (face.size() != 1 || faces.find(face[0]) == string::npos
+        || suits.find(text.back()) == string::npos)
+        return false;
+
+    aCard.faceValue = (int)faces.find(face[0]) + 1;
+    aCard.suit = (int)suits.find(text.back());
+    return true;
+}
+
+/** **********************************************************************
+ * @brief Returns the 21+3 net result of three cards.
+ *
+ * @param[in] first sideIndex() of the player's first card.
+ * @param[in] second sideIndex() of the player's second card.
+ * @param[in] upcard sideIndex() of the dealer's upcard.
+ *
+ * @returns The net result in bets, -1 for a loss.
+ *
+ * @par Example
+ * @code{.cpp}
+ * int net = twentyOnePlusThree(0, 4, 8);
+ * @endcode
+ ************************************************************************/
+int twentyOnePlusThree(int first, int second, int upcard)
+{
+    int faces[3] = { first / 4 + 1, second / 4 + 1, upcard / 4 + 1 };
+    bool flush = (first % 4 == second % 4) && (first % 4 == upcard % 4);
+    int mask = 0;
+
+    if (faces[0] == faces[1] && faces[0] == faces[2])
+        return flush ? 100 : 30;
+
+    for (int k = 0; k < 3; k++)
+        mask |= 1 << faces[k];
+
+    if (SIDE_TABLES.straights[mask])
+        return flush ? 40 : 10;
+    return flush ? 5 : -1;
+}
+
+/** **********************************************************************
+ * @brief Returns whether the dealer's two cards are a natural.
+ *
+ * @param[in] upcard sideIndex() of the dealer's upcard.
+ * @param[in] hole sideIndex() of the dealer's hole card.
+ *
+ * @returns `true` for an ace and a ten-value card.
+ *
+ * @par Example
+ * @code{.cpp}
+ * bool natural = dealerNatural(0, 40);
+ * @endcode
+ ************************************************************************/
+bool dealerNatural(int upcard, int hole)
+{
+    return (upcard < 4 && hole >= 36) || (hole < 4 && upcard >= 36);
+}
+
+/** **********************************************************************
+ * @brief Adds the next round's opening cards to a batch.
+ *
+ * @details The four cards are read from the shoe in dealing order without
+ *          dealing them, together with the true count before the deal.
+ *          The shoe must hold at least four more cards.
+ *
+ * @param[in,out] batch The batch, which must not be full.
+ * @param[in] shoe The shoe the round is about to be dealt from.
+ *
+ * @par Example
+ * @code{.cpp}
+ * addDeal(batch, state.shoe);
+ * @endcode
+ ************************************************************************/
+void addDeal(SideBatch& batch, const Shoe& shoe)
+{
+    for (int k = 0; k < 4; k++)
+        batch.cards[k][batch.count] = (unsigned char)sideIndex(
+            shoe.cards[shoe.position + k]);
+    batch.buckets[batch.count] = (unsigned char)trueCountBucket(shoe);
+    batch.count++;
+}
+
+/** **********************************************************************
+ * @brief Scores every deal in a batch and empties it.
+ *
+ * @details Each side bet is scored in its own pass over the batch, which
+ *          keeps each pass to a few table reads per deal.
+ *
+ * @param[in,out] batch The batch.
+ * @param[in,out] stats The totals the results are added to.
+ *
+ * @par Example
+ * @code{.cpp}
+ * if (batch.count == SIDE_BATCH)
+ *     scoreSideBatch(batch, stats);
+ * @endcode
+ ************************************************************************/
+void scoreSideBatch(SideBatch& batch, SideStats& stats)
+{
+    const unsigned char* first = batch.cards[0];
+    const unsigned char* upcard = batch.cards[1];
+    const unsigned char* second = batch.cards[2];
+    const unsigned char* hole = batch.cards[3];
+    int net;
+
+    for (int i = 0; i < batch.count; i++)
+    {
+        stats.rounds[batch.buckets[i]]++;
+
+        net = SIDE_TABLES.pairs[first[i]][second[i]];
+        stats.net[SIDE_PERFECT_PAIRS][batch.buckets[i]] += net;
+        stats.netSquares[SIDE_PERFECT_PAIRS][batch.buckets[i]] += net * net;
+    }
+
+    for (int i = 0; i < batch.count; i++)
+    {
+        net = twentyOnePlusThree(first[i], second[i], upcard[i]);
+        stats.net[SIDE_21_PLUS_3][batch.buckets[i]] += net;
+        stats.netSquares[SIDE_21_PLUS_3][batch.buckets[i]] += net * net;
+    }
+
+    for (int i = 0; i < batch.count; i++)
+    {
+        net = SIDE_TABLES.ladies[first[i]][second[i]];
+        if (net == 125 && dealerNatural(upcard[i], hole[i]))
+            net = 1000;
+        stats.net[SIDE_LUCKY_LADIES][batch.buckets[i]] += net;
+        stats.netSquares[SIDE_LUCKY_LADIES][batch.buckets[i]] += net * net;
+    }
+
+    batch.count = 0;
+}
+
+/** **********************************************************************
+ * @brief Plays one worker's share of a side bet simulation.
+ *
+ * @details Worker w plays blocks w, w + threads, w + 2 * threads and so on,
+ *          exactly as runWorker() does, with a basic strategy player
+ *          betting the main game so that the shoe is used up as it is at
+ *          the table. Before each round the opening cards are added to the
+ *          batch, except in the rare round dealt across a reshuffle.
+ *
+ * @param[in] config The simulation parameters.
+ * @param[in] worker The worker's index.
+ * @param[in,out] stats The worker's totals.
+ *
+ * @par Example
+ * @code{.cpp}
+ * thread worker(runSideBetWorker, cref(config), 0, ref(stats));
+ * @endcode
+ ************************************************************************/
+void runSideBetWorker(const SimConfig& config, int worker, SideStats& stats)
+{
+    uint64_t blocks = (config.rounds + config.blockRounds - 1)
+        / config.blockRounds;
+    SimWorkerState state;
+    Strategy strategy;
+    SideBatch batch;
+
+    basicStrategy(strategy);
+    for (uint64_t block = worker; block < blocks; block += config.threads)
+    {
+        uint64_t rounds = min(config.blockRounds,
+            config.rounds - block * config.blockRounds);
+
+        state.block = block;
+        startBlock(state, config);
+
+        for (uint64_t round = 0; round < rounds; round++)
+        {
+            Shoe& shoe = state.shoe;
+
+            if (shoe.position >= shoe.cutCard)
+                shuffleShoe(shoe, state.engine);
+            if (shoe.position + 4 <= (int)shoe.cards.size())
+            {
+                addDeal(batch, shoe);
+                if (batch.count == SIDE_BATCH)
+                    scoreSideBatch(batch, stats);
+            }
+
+            simulateRound(shoe, state.engine, state.player, strategy,
+                config.bet, config.rules, state.stats);
+        }
+    }
+    scoreSideBatch(batch, stats);
+}
+
+/** **********************************************************************
+ * @brief Works out the exact side bet edges for a shoe.
+ *
+ * @details Every ordered choice of the player's two cards is weighed by
+ *          its chance of being dealt, and for 21+3 every upcard as well.
+ *          The cards are dealt in turn, so the player's two cards and the
+ *          upcard are equally likely in any order. For two queens of
+ *          hearts, Lucky Ladies also needs the chance that the dealer's
+ *          two cards from what is left make a natural.
+ *
+ * @param[in] counts How many of each card the shoe holds, by sideIndex().
+ * @param[out] edges The house edge of each side bet, in percent.
+ *
+ * @par Example
+ * @code{.cpp}
+ * int counts[SIDE_CARDS];
+ * fill(counts, counts + SIDE_CARDS, 6);
+ * double edges[SIDE_BETS];
+ * exactSideBets(counts, edges);
+ * @endcode
+ ************************************************************************/
+void exactSideBets(const int counts[SIDE_CARDS], double edges[SIDE_BETS])
+{
+    double cards = 0.0;
+    double aces = 0.0;
+    double tens = 0.0;
+    double ev[SIDE_BETS] = {};
+    int left[SIDE_CARDS];
+
+    for (int i = 0; i < SIDE_CARDS; i++)
+    {
+        cards += counts[i];
+        aces += i < 4 ? counts[i] : 0;
+        tens += i >= 36 ? counts[i] : 0;
+        left[i] = counts[i];
+    }
+
+    for (int i = 0; i < SIDE_CARDS; i++)
+    {
+        if (left[i] == 0)
+            continue;
+        double chance = left[i] / cards;
+        left[i]--;
+
+        for (int j = 0; j < SIDE_CARDS; j++)
+        {
+            if (left[j] == 0)
+                continue;
+            double pair = chance * left[j] / (cards - 1);
+            int ladies = SIDE_TABLES.ladies[i][j];
+
+            if (ladies == 125)
+            {
+                // Two queens of hearts leave two fewer ten-value cards
+                double natural = 2.0 * aces * (tens - 2)
+                    / ((cards - 2) * (cards - 3));
+                ev[SIDE_LUCKY_LADIES] += pair * (natural * 1000
+                    + (1.0 - natural) * 125);
+            }
+            else
+                ev[SIDE_LUCKY_LADIES] += pair * ladies;
+            ev[SIDE_PERFECT_PAIRS] += pair * SIDE_TABLES.pairs[i][j];
+
+            left[j]--;
+            for (int k = 0; k < SIDE_CARDS; k++)
+                if (left[k] > 0)
+                    ev[SIDE_21_PLUS_3] += pair * left[k] / (cards - 2)
+                        * twentyOnePlusThree(i, j, k);
+            left[j]++;
+        }
+        left[i]++;
+    }
+
+    for (int bet = 0; bet < SIDE_BETS; bet++)
+        edges[bet] = -ev[bet] * 100.0;
+}
@@ -0,0 +1,1526 @@
+/** **********************************************************************
+* @file
+*
+* @brief This file contains the definitions for the headless simulation
+*        engine of the Blackjack game, which plays rounds automatically
+*        with a basic strategy player across several worker threads.
+************************************************************************/
+
+#include "blackjack.h"
+
+/** ***************************************************************************
+*                           Simulation Definitions
+******************************************************************************/
+
+const uint64_t SNAPSHOT_ROUNDS = 4096; // Rounds between published snapshots
+const size_t TRANSCRIPT_BYTES = 1 << 20; // Each worker's transcript buffer
+const size_t TRANSCRIPT_ROUND_BYTES = 512; // More than any round's log
+
+/** **********************************************************************
+ * @brief Runs the program in command line (non-interactive) mode.
+ *
+ * @details This function is called by main whenever arguments are given.
+ *          A leading command word selects one of the analysis tools.
+ *          Otherwise it parses the simulation options, optionally reloads
+ *          a checkpoint written by an earlier run, plays every remaining
+ *          round and prints the final report. The totals are also saved
+ *          to a result file when one was requested, so that the shards of
+ *          a split run can be merged, and every round is logged to a
+ *          transcript file when one was requested.
+ *
+ * @param[in] argc The number of command line arguments.
+ * @param[in] argv The command line arguments.
+ *
+ * @returns 0 if the simulation ran, 1 if the arguments or the checkpoint
+ *          file could not be read or the result or transcript file could
+ *          not be written.
+ *
+ * @par Example
+ * @code{.cpp}
+ * return runCommand(argc, argv);
+ * @endcode
+ ************************************************************************/
+int runCommand(int argc, char* argv[])
+{
+    SimConfig config;
+    string resumeFile;
+    vector<SimWorkerState> workers;
+    string command = argv[1];
+
+    if (command == "indices")
+        return runIndexCommand(argc - 1, argv + 1);
+    if (command == "merge")
+        return runMergeCommand(argc - 1, argv + 1);
+    if (command == "ev")
+        return runEvCommand(argc - 1, argv + 1);
+    if (command == "sweep")
+        return runSweepCommand(argc - 1, argv + 1);
+    if (command == "exact")
+        return runExactCommand(argc - 1, argv + 1);
+    if (command == "alloccheck")
+        return runAllocCheckCommand(argc - 1, argv + 1);
+    if (command == "record")
+        return runRecordCommand(argc - 1, argv + 1);
+    if (command == "replay")
+        return runReplayCommand(argc - 1, argv + 1);
+    if (command == "chart")
+        return runChartCommand(argc - 1, argv + 1);
+    if (command == "history")
+        return runHistoryCommand(argc - 1, argv + 1);
+    if (command == "whatif")
+        return runWhatIfCommand(argc - 1, argv + 1);
+    if (command == "learn")
+        return runLearnCommand(argc - 1, argv + 1);
+    if (command == "sidebets")
+        return runSideBetCommand(argc - 1, argv + 1);
+    if (command == "sessions")
+        return runSessionCommand(argc - 1, argv + 1);
+    if (command == "lockstep")
+        return runLockstepCommand(argc - 1, argv + 1);
+    if (command == "variance")
+        return runVarianceCommand(argc - 1, argv + 1);
+    if (command == "daemon")
+        return runDaemonCommand(argc - 1, argv + 1);
+    if (command == "job")
+        return runJobCommand(argc - 1, argv + 1);
+
+    if (!parseSimArgs(argc, argv, config, resumeFile))
+    {
+        printUsage();
+        return 1;
+    }
+
+    if (!resumeFile.empty() && !config.transcriptFile.empty())
+    {
+        cerr << "--transcript cannot be used with --resume" << endl;
+        return 1;
+    }
+
+    if (config.perfCounters)
+    {
+        if (!resumeFile.empty() || config.precision > 0.0
+            || config.shardCount > 1 || !config.checkpointFile.empty()
+            || !config.resultFile.empty() || !config.transcriptFile.empty())
+        {
+            cerr << "--perf-counters profiles a plain run" << endl;
+            return 1;
+        }
+        return runPerfProfile(config);
+    }
+
+    if (!resumeFile.empty())
+    {
+        string checkpointFile = config.checkpointFile;
+        int checkpointSeconds = config.checkpointSeconds;
+        string resultFile = config.resultFile;
+
+        if (!loadCheckpoint(resumeFile, config, workers))
+        {
+            cerr << "Unable to read checkpoint " << resumeFile << endl;
+            return 1;
+        }
+
+        // Keep checkpointing into the resumed file unless told otherwise
+        config.checkpointFile = checkpointFile.empty() ? resumeFile
+            : checkpointFile;
+        config.checkpointSeconds = checkpointSeconds;
+        config.resultFile = resultFile;
+    }
+
+    TranscriptFile transcript;
+    if (!config.transcriptFile.empty()
+        && !openTranscript(transcript, config.transcriptFile))
+    {
+        cerr << "Unable to write transcript " << config.transcriptFile
+            << endl;
+        return 1;
+    }
+
+    SimStats stats = runSimulation(config, workers,
+        transcript.file ? &transcript : nullptr);
+    printSimReport(stats, config);
+
+    if (transcript.file && (fclose(transcript.file) != 0
+        || transcript.failed))
+    {
+        cerr << "Unable to write transcript " << config.transcriptFile
+            << endl;
+        return 1;
+    }
+
+    if (!config.resultFile.empty() && !saveResult(config.resultFile, config,
+        stats))
+    {
+        cerr << "Unable to write result " << config.resultFile << endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+/** **********************************************************************
+ * @brief Displays the command line options of the simulator.
+ *
+ * @par Example
+ * @code{.cpp}
+ * printUsage();
+ * @endcode
+ ************************************************************************/
+void printUsage()
+{
+    cout << "Usage: blackjack [options]\n"
+        << "       blackjack indices [--samples N] [--cache FILE] [options]\n"
+        << "       blackjack merge RESULT_FILE... [--result FILE]\n"
+        << "       blackjack ev [--h17]\n"
+        << "       blackjack sweep GRID_FILE [--cache FILE] [--out FILE]"
+        << " [--threads T]\n"
+        << "       blackjack exact [--decks D] [--rules s17|h17]"
+        << " [--threads T]\n"
+        << "       blackjack alloccheck [options]\n"
+        << "       blackjack record FILE [--rounds N] [--seed S]"
+        << " [--tokens T]\n"
+        << "       blackjack replay FILE\n"
+        << "       blackjack chart [CHART_FILE]\n"
+        << "       blackjack history FILE [options]\n"
+        << "       blackjack whatif FILE [--threads T]"
+        << " [--chart CHART_FILE|basic [--ramp TC:BET,...]]...\n"
+        << "       blackjack learn [--epochs E] [--out CHART_FILE]"
+        << " [options]\n"
+        << "       blackjack sidebets [--exact] [--remove CARD,...]"
+        << " [options]\n"
+        << "       blackjack sessions FILE [--count N] [--seed S]\n"
+        << "       blackjack lockstep [options]\n"
+        << "       blackjack variance [options]\n"
+        << "       blackjack daemon SOCKET [--threads T] [--cache FILE]\n"
+        << "       blackjack job SOCKET submit|status|watch|cancel|list"
+        << "|shutdown [ARGS...]\n"
+        << "   --simulate N             Rounds to simulate\n"
+        << "   --threads T              Worker threads\n"
+        << "   --seed S                 Master random seed\n"
+        << "   --decks D                Decks in the shoe\n"
+        << "   --penetration P          Fraction dealt before a shuffle\n"
+        << "   --bet B                  Flat bet per round\n"
+        << "   --block R                Rounds per random stream block\n"
+        << "   --csm SLOTS              Deal from a continuous shuffler\n"
+        << "   --rules s17|h17          Dealer stands on or hits soft 17\n"
+        << "   --insurance perfect      Insure when the cards favour it\n"
+        << "   --checkpoint FILE        Periodically save progress to FILE\n"
+        << "   --checkpoint-interval S  Seconds between checkpoints\n"
+        << "   --resume FILE            Continue the run saved in FILE\n"
+        << "   --shard I/N              Play only slice I of N of the run\n"
+        << "   --result FILE            Save mergeable totals to FILE\n"
+        << "   --precision P            Stop once the edge is known to +/-P%\n"
+        << "   --transcript FILE        Log every round played to FILE\n"
+        << "   --perf-counters          Profile the run with CPU counters\n"
+        << "Run without options to play interactively." << endl;
+}
+
+/** **********************************************************************
+ * @brief Reads an unsigned integer from a command line argument.
+ *
+ * @param[in] text The argument text.
+ * @param[out] value The parsed value.
+ *
+ * @returns `true` if the whole argument was a valid number.
+ *
+ * @par Example
+ * @code{.cpp}
+ * uint64_t rounds;
+ * parseCount("1000", rounds);
+ * @endcode
+ ************************************************************************/
+bool parseCount(const char* text, uint64_t& value)
+{
+    istringstream in(text);
+    char extra;
+
+    if (text[0] == '-' || !(in >> value))
+        return false;
+    return !(in >> extra);
+}
+
+/** **********************************************************************
+ * @brief Reads a real number from a command line argument.
+ *
+ * @param[in] text The argument text.
+ * @param[out] value The parsed value.
+ *
+ * @returns `true` if the whole argument was a valid number.
+ *
+ * @par Example
+ * @code{.cpp}
+ * double penetration;
+ * parseReal("0.75", penetration);
+ * @endcode
+ ************************************************************************/
+bool parseReal(const char* text, double& value)
+{
+    istringstream in(text);
+    char extra;
+
+    if (!(in >> value))
+        return false;
+    return !(in >> extra);
+}
+
+/** **********************************************************************
+ * @brief Reads a shard selection of the form "I/N" from a command line
+ *        argument.
+ *
+ * @param[in] text The argument text.
+ * @param[out] index The zero-based shard index I.
+ * @param[out] count The number of shards N.
+ *
+ * @returns `true` if the argument was valid and I is less than N.
+ *
+ * @par Example
+ * @code{.cpp}
+ * uint64_t index, count;
+ * parseShard("2/8", index, count);
+ * @endcode
+ ************************************************************************/
+bool parseShard(const char* text, uint64_t& index, uint64_t& count)
+{
+    string shard = text;
+    size_t slash = shard.find('/');
+
+    if (slash == string::npos)
+        return false;
+
+    string first = shard.substr(0, slash);
+    string second = shard.substr(slash + 1);
+
+    return parseCount(first.c_str(), index)
+        && parseCount(second.c_str(), count) && count >= 1 && index < count;
+}
+
+/** **********************************************************************
+ * @brief Reads a dealer rule variant from a command line argument.
+ *
+ * @param[in] text The argument text, "s17" or "h17".
+ * @param[out] rules RULES_S17 or RULES_H17.
+ *
+ * @returns `true` if the argument named a rule variant.
+ *
+ * @par Example
+ * @code{.cpp}
+ * parseRules("h17", config.rules);
+ * @endcode
+ ************************************************************************/
+bool parseRules(const char* text, int& rules)
+{
+    string name = text;
+
+    if (name == "s17")
+        rules = RULES_S17;
+    else if (name == "h17")
+        rules = RULES_H17;
+    else
+        return false;
+    return true;
+}
+
+/** **********************************************************************
+ * @brief Applies one of the options shared by every simulation command.
+ *
+ * @details Numeric options are checked for range so that the engine never
+ *          sees an empty shoe, a zero block size or a bet that is not a
+ *          positive multiple of 10, which mirrors the rule enforced by
+ *          betMenu().
+ *
+ * @param[in] option The option name, such as "--decks".
+ * @param[in] value The option's value.
+ * @param[in,out] config The simulation parameters to update.
+ *
+ * @returns `true` if the option was recognised and its value was valid.
+ *
+ * @par Example
+ * @code{.cpp}
+ * SimConfig config;
+ * parseSimOption("--decks", "2", config);
+ * @endcode
+ ************************************************************************/
+bool parseSimOption(const string& option, const char* value,
+    SimConfig& config)
+{
+    uint64_t number;
+    double real;
+
+    if (option == "--simulate" && parseCount(value, number))
+        config.rounds = number;
+    else if (option == "--threads" && parseCount(value, number)
+        && number >= 1 && number <= 1024)
+        config.threads = (int)number;
+    else if (option == "--seed" && parseCount(value, number))
+        config.seed = number;
+    else if (option == "--decks" && parseCount(value, number)
+        && number >= 1 && number <= 8)
+        config.decks = (int)number;
+    else if (option == "--penetration" && parseReal(value, real)
+        && real > 0.0 && real <= 1.0)
+        config.penetration = real;
+    else if (option == "--bet" && parseCount(value, number)
+        && number >= 10 && number % 10 == 0 && number <= 100000)
+        config.bet = (int)number;
+    else if (option == "--block" && parseCount(value, number)
+        && number >= 1)
+        config.blockRounds = number;
+    else if (option == "--csm" && parseCount(value, number) && number <= 64)
+        config.machineSlots = (int)number;
+    else
+        return false;
+    return true;
+}
+
+/** **********************************************************************
+ * @brief Parses the simulation options from the command line.
+ *
+ * @details Every option but `--perf-counters` takes exactly one value.
+ *          Besides the options handled by parseSimOption(), this accepts
+ *          the checkpoint, shard, result, transcript, rules, insurance,
+ *          precision and performance counter options of a plain simulation
+ *          run.
+ *          With a precision target the round count becomes a cap, which is
+ *          practically unlimited unless `--simulate` is also given. Shards
+ *          cannot stop early together, so they cannot take a target.
+ *
+ * @param[in] argc The number of command line arguments.
+ * @param[in] argv The command line arguments.
+ * @param[out] config The parsed simulation parameters.
+ * @param[out] resumeFile The checkpoint to resume from, or empty.
+ *
+ * @returns `true` if every argument was understood, `false` otherwise.
+ *
+ * @par Example
+ * @code{.cpp}
+ * SimConfig config;
+ * string resumeFile;
+ * parseSimArgs(argc, argv, config, resumeFile);
+ * @endcode
+ ************************************************************************/
+bool parseSimArgs(int argc, char* argv[], SimConfig& config,
+    string& resumeFile)
+{
+    uint64_t number;
+    bool roundsGiven = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string option = argv[i];
+
+        if (option == "--perf-counters")
+        {
+            config.perfCounters = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+            return false;
+
+        const char* value = argv[++i];
+
+        if (parseSimOption(option, value, config))
+            roundsGiven = roundsGiven || option == "--simulate";
+        else if (option == "--checkpoint")
+            config.checkpointFile = value;
+        else if (option == "--checkpoint-interval"
+            && parseCount(value, number) && number >= 1)
+            config.checkpointSeconds = (int)number;
+        else if (option == "--resume")
+            resumeFile = value;
+        else if (option == "--shard"
+            && parseShard(value, config.shardIndex, config.shardCount))
+            continue;
+        else if (option == "--result")
+            config.resultFile = value;
+        else if (option == "--transcript")
+            config.transcriptFile = value;
+        else if (option == "--rules" && parseRules(value, config.rules))
+            continue;
+        else if (option == "--insurance"
+            && parseInsurance(value, config.insurance))
+            continue;
+        else if (option == "--precision" && parseReal(value, config.precision)
+            && config.precision > 0.0)
+            continue;
+        else
+        {
+            cerr << "Invalid option: " << option << " " << value << endl;
+            return false;
+        }
+    }
+
+    if (config.precision > 0.0 && config.shardCount > 1)
+    {
+        cerr << "--precision cannot be used with --shard" << endl;
+        return false;
+    }
+    if (config.precision > 0.0 && !roundsGiven)
+        config.rounds = PRECISION_ROUND_LIMIT;
+    return true;
+}
+
+/** **********************************************************************
+ * @brief Generates a uniform random integer in the range [0, bound).
+ *
+ * @details Rejection sampling on the raw engine output is used instead of
+ *          uniform_int_distribution, whose algorithm differs between
+ *          standard libraries. This keeps shuffles identical on every
+ *          compiler for the same seed.
+ *
+ * @param[in,out] engine The random engine to draw from.
+ * @param[in] bound The exclusive upper limit, which must be positive.
+ *
+ * @returns A random integer between 0 and bound - 1 (inclusive).
+ *
+ * @par Example
+ * @code{.cpp}
+ * mt19937_64 engine(1);
+ * uint64_t index = randBelow(engine, 52);
+ * @endcode
+ ************************************************************************/
+uint64_t randBelow(mt19937_64& engine, uint64_t bound)
+{
+    uint64_t limit = UINT64_MAX - UINT64_MAX % bound;
+    uint64_t value;
+
+    do
+    {
+        value = engine();
+    } while (value >= limit);
+
+    return value % bound;
+}
+
+/** **********************************************************************
+ * @brief Builds an unshuffled shoe of the requested size.
+ *
+ * @details The cards and cut card are set up by resetShoe(). When a
+ *          shuffling machine is requested,
+ *          its slots are sized to hold twice their share of the shoe, and
+ *          the cards are loaded into it by shuffleShoe().
+ *
+ * @param[in] deckCount The number of 52-card decks.
+ * @param[in] penetration Fraction of the shoe dealt before a shuffle.
+ * @param[in] machineSlots Slots of the continuous shuffling machine, or 0
+ *                         to deal the shoe by hand.
+ *
+ * @par Example
+ * @code{.cpp}
+ * Shoe shoe(6, 0.75);
+ * @endcode
+ ************************************************************************/
+Shoe::Shoe(int deckCount, double penetration, int machineSlots)
+    : cards(52 * deckCount), position(0), decks(deckCount), cutCard(0),
+    runningCount(0), continuous(machineSlots > 0), recorded(nullptr),
+    recordedShoes(0), nextShoe(0)
+{
+    int size = (int)cards.size();
+
+    resetShoe(*this, penetration);
+
+    if (continuous)
+    {
+        machine.slotCount = machineSlots;
+        machine.slotCapacity = 2 * ((size + machineSlots - 1) / machineSlots)
+            + 4;
+        machine.slots.resize(machine.slotCount * machine.slotCapacity);
+        machine.slotSizes.assign(machine.slotCount, 0);
+        machine.filledIndex.assign(machine.slotCount, -1);
+        machine.filled.reserve(machine.slotCount);
+        machine.tray.resize(size);
+    }
+}
+
+/** **********************************************************************
+ * @brief Puts a shoe's cards back in their unshuffled order.
+ *
+ * @details Cards are laid out deck by deck with the same face value and
+ *          suit encoding as generateDeck(). The cut card is placed after
+ *          the given fraction of the shoe, but never before the first
+ *          round's worth of cards. The shoe's storage is reused, so a
+ *          worker can start block after block without allocating.
+ *
+ * @param[in,out] shoe The shoe to reset.
+ * @param[in] penetration Fraction of the shoe dealt before a shuffle.
+ *
+ * @par Example
+ * @code{.cpp}
+ * resetShoe(state.shoe, config.penetration);
+ * @endcode
+ ************************************************************************/
+void resetShoe(Shoe& shoe, double penetration)
+{
+    int size = (int)shoe.cards.size();
+
+    for (int i = 0; i < size; i++)
+    {
+        shoe.cards[i].faceValue = (i % 13) + 1;
+        shoe.cards[i].suit = (i / 13) % 4;
+    }
+
+    shoe.position = 0;
+    shoe.runningCount = 0;
+    shoe.cutCard = max(4, (int)(size * penetration));
+    fillComposition(shoe.composition, shoe.decks);
+}
+
+/** **********************************************************************
+ * @brief Shuffles every card back into the shoe.
+ *
+ * @details A Fisher-Yates shuffle is applied to the whole shoe, then the
+ *          deal position, running count and composition are reset. A
+ *          shoe with a shuffling machine is instead loaded into the
+ *          machine, and a shoe replaying a history deals the next
+ *          recorded shoe.
+ *
+ * @param[in,out] shoe The shoe to shuffle.
+ * @param[in,out] engine The random engine that drives the shuffle.
+ *
+ * @par Example
+ * @code{.cpp}
+ * Shoe shoe(6, 0.75);
+ * mt19937_64 engine(1);
+ * shuffleShoe(shoe, engine);
+ * @endcode
+ ************************************************************************/
+void shuffleShoe(Shoe& shoe, mt19937_64& engine)
+{
+    PhaseScope scope(PHASE_SHUFFLE);
+
+    if (shoe.continuous)
+    {
+        loadMachine(shoe, engine);
+        return;
+    }
+    if (shoe.recorded)
+    {
+        loadRecordedShoe(shoe);
+        return;
+    }
+
+    for (int i = (int)shoe.cards.size() - 1; i > 0; i--)
+        swap(shoe.cards[i], shoe.cards[randBelow(engine, i + 1)]);
+
+    shoe.position = 0;
+    shoe.runningCount = 0;
+    fillComposition(shoe.composition, shoe.decks);
+}
+
+/** **********************************************************************
+ * @brief Deals the next card from the shoe and updates the running count.
+ *
+ * @details If the shoe runs out in the middle of a round it is reshuffled
+ *          on the spot, which can only happen with a penetration close to
+ *          a full shoe. A shoe with a shuffling machine deals from the
+ *          machine's tray instead.
+ *
+ * @param[in,out] shoe The shoe to deal from.
+ * @param[in,out] engine The random engine used if a reshuffle is needed.
+ *
+ * @returns The dealt card.
+ *
+ * @par Example
+ * @code{.cpp}
+ * card aCard = drawCard(shoe, engine);
+ * @endcode
+ ************************************************************************/
+card drawCard(Shoe& shoe, mt19937_64& engine)
+{
+    if (shoe.continuous)
+        return machineDraw(shoe, engine);
+
+    if (shoe.position >= (int)shoe.cards.size())
+        shuffleShoe(shoe, engine);
+
+    card aCard = shoe.cards[shoe.position++];
+    shoe.runningCount += hiLoValue(aCard);
+    removeRank(shoe.composition, cardRank(aCard));
+
+    return aCard;
+}
+
+/** **********************************************************************
+ * @brief Returns the Hi-Lo counting value of a card.
+ *
+ * @param[in] aCard The card being counted.
+ *
+ * @returns +1 for 2 through 6, -1 for ten-value cards and aces, and 0 for
+ *          7 through 9.
+ *
+ * @par Example
+ * @code{.cpp}
+ * shoe.runningCount += hiLoValue(aCard);
+ * @endcode
+ ************************************************************************/
+int hiLoValue(card aCard)
+{
+    if (aCard.faceValue >= 2 && aCard.faceValue <= 6)
+        return 1;
+    if (aCard.faceValue >= 10 || aCard.faceValue == 1)
+        return -1;
+    return 0;
+}
+
+/** **********************************************************************
+ * @brief Returns the true count bucket of the next card dealt from a shoe.
+ *
+ * @details The true count is the running count per deck left, rounded
+ *          and clamped to the buckets of the index search.
+ *
+ * @param[in] shoe The shoe.
+ *
+ * @returns The bucket, 0 for TC_MIN through TC_BUCKETS - 1 for TC_MAX.
+ *
+ * @par Example
+ * @code{.cpp}
+ * int bucket = trueCountBucket(shoe);
+ * @endcode
+ ************************************************************************/
+int trueCountBucket(const Shoe& shoe)
+{
+    int remaining = max(1, (int)shoe.cards.size() - shoe.position);
+    long trueCount = lround(shoe.runningCount * 52.0 / remaining);
+
+    return (int)(min<long>(max<long>(trueCount, TC_MIN), TC_MAX) - TC_MIN);
+}
+
+/** **********************************************************************
+ * @brief Adds a card to a simulated hand and updates its total.
+ *
+ * @details The total follows the same rules as sumHand(): face cards are
+ *          worth 10 and aces are worth 11 until the hand would bust, at
+ *          which point they drop to 1 one at a time.
+ *
+ * @param[in,out] hand The hand receiving the card.
+ * @param[in] aCard The card to add.
+ *
+ * @par Example
+ * @code{.cpp}
+ * SimHand hand;
+ * addCard(hand, drawCard(shoe, engine));
+ * @endcode
+ ************************************************************************/
+void addCard(SimHand& hand, card aCard)
+{
+    PhaseScope scope(PHASE_SCORING);
+
+    if (hand.count < MAX_HAND_CARDS)
+        hand.cards[hand.count++] = aCard;
+
+    if (aCard.faceValue > 10)
+        hand.total += 10;
+    else if (aCard.faceValue == 1)
+    {
+        hand.total += 11;
+        hand.softAces++;
+    }
+    else
+        hand.total += aCard.faceValue;
+
+    while (hand.total > 21 && hand.softAces > 0)
+    {
+        hand.total -= 10; // Convert one ace from 11 to 1
+        hand.softAces--;
+    }
+}
+
+/** **********************************************************************
+ * @brief Fills a strategy chart with basic strategy for this game.
+ *
+ * @details The chart is the standard multi-deck basic strategy for a
+ *          dealer who stands on all 17s. Splitting is not offered by the
+ *          game, so pairs are played by their hard or soft total.
+ *
+ * @param[out] strategy The chart to fill.
+ *
+ * @par Example
+ * @code{.cpp}
+ * Strategy strategy;
+ * basicStrategy(strategy);
+ * @endcode
+ ************************************************************************/
+void basicStrategy(Strategy& strategy)
+{
+    for (int total = 0; total < 22; total++)
+    {
+        for (int up = 0; up < 11; up++)
+        {
+            bool weak = (up >= 2 && up <= 6); // Dealer shows 2 through 6
+            int hard = ACTION_HIT;
+            int soft = ACTION_HIT;
+
+            if (total >= 17)
+                hard = ACTION_STAND;
+            else if (total >= 13)
+                hard = weak ? ACTION_STAND : ACTION_HIT;
+            else if (total == 12)
+                hard = (up >= 4 && up <= 6) ? ACTION_STAND : ACTION_HIT;
+            else if (total == 11)
+                hard = (up != 1) ? ACTION_DOUBLE : ACTION_HIT;
+            else if (total == 10)
+                hard = (up >= 2 && up <= 9) ? ACTION_DOUBLE : ACTION_HIT;
+            else if (total == 9)
+                hard = (up >= 3 && up <= 6) ? ACTION_DOUBLE : ACTION_HIT;
+
+            if (total >= 19)
+                soft = ACTION_STAND;
+            else if (total == 18)
+            {
+                if (up >= 3 && up <= 6)
+                    soft = ACTION_DOUBLE_STAND;
+                else if (up == 2 || up == 7 || up == 8)
+                    soft = ACTION_STAND;
+            }
+            else if (total == 17)
+                soft = (up >= 3 && up <= 6) ? ACTION_DOUBLE : ACTION_HIT;
+            else if (total >= 15)
+                soft = (up >= 4 && up <= 6) ? ACTION_DOUBLE : ACTION_HIT;
+            else if (total >= 13)
+                soft = (up >= 5 && up <= 6) ? ACTION_DOUBLE : ACTION_HIT;
+
+            strategy.hard[total][up] = hard;
+            strategy.soft[total][up] = soft;
+        }
+    }
+}
+
+/** **********************************************************************
+ * @brief Looks up the strategy chart for the player's next move.
+ *
+ * @details Chart entries that ask to double are converted to a hit or a
+ *          stand when doubling is no longer allowed, so the value returned
+ *          is always a valid processChoice() menu choice.
+ *
+ * @param[in] strategy The chart to consult.
+ * @param[in] hand The player's hand.
+ * @param[in] upcard The dealer's upcard value (1 = Ace, 10 = ten-value).
+ * @param[in] canDoubleDown Whether the player may still double down.
+ *
+ * @returns ACTION_HIT, ACTION_DOUBLE or ACTION_STAND.
+ *
+ * @par Example
+ * @code{.cpp}
+ * int choice = strategyAction(strategy, pHand, 6, true);
+ * @endcode
+ ************************************************************************/
+int strategyAction(const Strategy& strategy, const SimHand& hand,
+    int upcard, bool canDoubleDown)
+{
+    int total = min(hand.total, 21);
+    int action = (hand.softAces > 0) ? strategy.soft[total][upcard]
+        : strategy.hard[total][upcard];
+
+    if (action == ACTION_DOUBLE_STAND)
+        return canDoubleDown ? ACTION_DOUBLE : ACTION_STAND;
+    if (action == ACTION_DOUBLE && !canDoubleDown)
+        return ACTION_HIT;
+    return action;
+}
+
+/** **********************************************************************
+ * @brief Plays out the dealer's hand under the stand() rule.
+ *
+ * @details The dealer keeps drawing while the hand total is below 17,
+ *          which means the dealer stands on a soft 17 exactly like the
+ *          interactive game. Under RULES_H17 the dealer also draws to a
+ *          soft 17.
+ *
+ * @param[in,out] shoe The shoe to deal from.
+ * @param[in,out] engine The random engine used if a reshuffle is needed.
+ * @param[in,out] dHand The dealer's hand.
+ * @param[in] rules The dealer rule variant, RULES_S17 or RULES_H17.
+ *
+ * @returns The dealer's final total.
+ *
+ * @par Example
+ * @code{.cpp}
+ * int dealerTotal = dealerPlay(shoe, engine, dHand, RULES_S17);
+ * @endcode
+ ************************************************************************/
+int dealerPlay(Shoe& shoe, mt19937_64& engine, SimHand& dHand, int rules)
+{
+    PhaseScope scope(PHASE_DEALER);
+
+    while (dHand.total < 17 || (rules == RULES_H17 && dHand.total == 17
+        && dHand.softAces > 0))
+        addCard(dHand, drawCard(shoe, engine));
+
+    return dHand.total;
+}
+
+/** **********************************************************************
+ * @brief Compares a standing player hand against the finished dealer hand.
+ *
+ * @details The outcome mirrors the end of stand(): a dealer bust or a
+ *          higher player total wins, equal totals push, except that a 21
+ *          made with more cards than the dealer's 21 loses.
+ *
+ * @param[in] pHand The player's hand, which must not be bust.
+ * @param[in] dHand The dealer's finished hand.
+ *
+ * @returns 1 for a player win, 2 for a push and 3 for a player loss.
+ *
+ * @par Example
+ * @code{.cpp}
+ * int whoWon = settleHands(pHand, dHand);
+ * @endcode
+ ************************************************************************/
+int settleHands(SimHand& pHand, SimHand& dHand)
+{
+    PhaseScope scope(PHASE_SCORING);
+
+    if (dHand.total > 21 || pHand.total > dHand.total)
+        return 1;
+    if (pHand.total < dHand.total)
+        return 3;
+    if (pHand.total == 21 && pHand.count > dHand.count)
+        return 3;
+    return 2;
+}
+
+/** **********************************************************************
+ * @brief Plays one complete round without any console input or output.
+ *
+ * @details The round follows playRound() step by step: the cards are dealt
+ *          alternately, a natural 21 stands automatically, the player
+ *          then acts on the strategy chart, the dealer draws to 17 and the
+ *          bet is settled with the same arithmetic as playRound() and
+ *          doubleDown(). The net result is left in player.bet and added to
+ *          player.totalTokens, just as main() does. With a shuffling
+ *          machine, both hands are returned to it once the round is over.
+ *          When a transcript is given, the round's log is added to it.
+ *          When a script is given and it holds recorded choices, those are
+ *          played instead of the chart's; an empty script instead has the
+ *          chart's choices recorded into it. Under INSURANCE_PERFECT, a
+ *          dealer ace is met with insurance or even money whenever the
+ *          unseen cards make it worth taking, as shoeInsuranceEV() finds
+ *          from the shoe's composition. Insurance is half the bet and is
+ *          settled at once, since the dealer never peeks, and the round
+ *          then goes on as usual.
+ *
+ * @param[in,out] shoe The shoe to deal from. It is reshuffled first if the
+ *                     cut card has been reached, which never happens with
+ *                     a shuffling machine since its deal position stays
+ *                     at 0.
+ * @param[in,out] engine The random engine used for reshuffles.
+ * @param[in,out] player The player placing the bet.
+ * @param[in] strategy The chart the player follows.
+ * @param[in] bet The bet placed on this round.
+ * @param[in] rules The dealer rule variant, RULES_S17 or RULES_H17.
+ * @param[in,out] stats The totals the round's result is added to.
+ * @param[in,out] transcript The stream the round is logged to, or nullptr.
+ * @param[in,out] script The round's choices, or nullptr to follow the
+ *                       chart without recording.
+ * @param[in] insurance The insurance policy, INSURANCE_NEVER or
+ *                      INSURANCE_PERFECT.
+ *
+ * @returns The outcome: 1 for a player win, 2 for a push, 3 for a loss.
+ *
+ * @par Example
+ * @code{.cpp}
+ * SimStats stats;
+ * simulateRound(shoe, engine, player, strategy, 10, RULES_S17, stats);
+ * @endcode
+ ************************************************************************/
+int simulateRound(Shoe& shoe, mt19937_64& engine, Player& player,
+    const Strategy& strategy, int bet, int rules, SimStats& stats,
+    ostream* transcript, RoundScript* script, int insurance)
+{
+    SimHand pHand, dHand;
+    int whoWon = 0;
+    int insured = 0; // Net result of the insurance bet
+    bool doubled = false;
+    bool evenMoney = false;
+
+    if (shoe.position >= shoe.cutCard)
+        shuffleShoe(shoe, engine);
+
+    player.bet = bet;
+    for (int i = 0; i < 2; i++)
+    {
+        addCard(pHand, drawCard(shoe, engine));
+        addCard(dHand, drawCard(shoe, engine));
+    }
+
+    int upcard = min(dHand.cards[0].faceValue, 10);
+
+    if (insurance == INSURANCE_PERFECT && upcard == 1)
+    {
+        InsuranceEV ev = shoeInsuranceEV(shoe, dHand, pHand.total == 21,
+            rules);
+
+        if (pHand.total == 21)
+            evenMoney = ev.evenMoney > 0.0;
+        else if (ev.insurance > 0.0
+            && player.totalTokens - bet >= bet / 2)
+            insured = cardRank(dHand.cards[1]) == 10 ? bet : -(bet / 2);
+    }
+
+    if (pHand.total == 21)
+    {
+        // Natural 21, the player stands automatically
+        if (evenMoney)
+            whoWon = 1;
+        else if (dHand.total == 21)
+            whoWon = 2;
+        else
+        {
+            dealerPlay(shoe, engine, dHand, rules);
+            whoWon = settleHands(pHand, dHand);
+        }
+    }
+    else
+    {
+        bool canDoubleDown = true;
+        int choice = ACTION_HIT;
+
+        while (whoWon == 0 && choice == ACTION_HIT)
+        {
+            bool doubleAllowed = canDoubleDown
+                && player.totalTokens >= player.bet * 2;
+
+            if (script && script->actions != script->recorded)
+            {
+                choice = nextScriptAction(*script);
+                if (choice < ACTION_HIT || choice > ACTION_STAND
+                    || (choice == ACTION_DOUBLE && !doubleAllowed))
+                {
+                    script->failed = true;
+                    choice = ACTION_STAND;
+                }
+            }
+            else
+            {
+                choice = strategyAction(strategy, pHand, upcard,
+                    doubleAllowed);
+                if (script && script->actionCount < MAX_SCRIPT_ACTIONS)
+                    script->recorded[script->actionCount++] =
+                        (unsigned char)choice;
+            }
+
+            if (choice == ACTION_HIT || choice == ACTION_DOUBLE)
+            {
+                addCard(pHand, drawCard(shoe, engine));
+                doubled = (choice == ACTION_DOUBLE);
+                canDoubleDown = false;
+                if (pHand.total > 21)
+                    whoWon = 3; // Player bust
+            }
+        }
+
+        if (whoWon == 0)
+        {
+            dealerPlay(shoe, engine, dHand, rules);
+            whoWon = settleHands(pHand, dHand);
+        }
+    }
+
+    if (doubled && (whoWon == 1 || whoWon == 3))
+        player.bet = player.bet * 2;
+
+    if (whoWon == 1)
+    {
+        if (pHand.total == 21 && pHand.count == 2)
+        {
+            if (!evenMoney)
+                player.bet = (player.bet * 3) / 2;
+            stats.blackjacks++;
+        }
+        stats.wins++;
+    }
+    else if (whoWon == 2)
+    {
+        player.bet = 0;
+        stats.pushes++;
+    }
+    else
+    {
+        player.bet *= -1;
+        stats.losses++;
+    }
+
+    player.bet += insured;
+    player.totalTokens += player.bet;
+
+    if (transcript)
+        writeRoundLog(*transcript, pHand, dHand, whoWon, player.bet);
+
+    if (shoe.continuous)
+    {
+        returnHand(shoe, engine, pHand);
+        returnHand(shoe, engine, dHand);
+    }
+
+    stats.rounds++;
+    stats.doubles += doubled ? 1 : 0;
+    stats.wagered += bet;
+    stats.net += player.bet;
+    stats.netSquares += (uint64_t)((int64_t)player.bet * player.bet);
+
+    return whoWon;
+}
+
+/** **********************************************************************
+ * @brief Adds one set of simulation totals into another.
+ *
+ * @param[in,out] total The totals being accumulated.
+ * @param[in] part The totals to add.
+ *
+ * @par Example
+ * @code{.cpp}
+ * SimStats total, part;
+ * mergeStats(total, part);
+ * @endcode
+ ************************************************************************/
+void mergeStats(SimStats& total, const SimStats& part)
+{
+    total.rounds += part.rounds;
+    total.wins += part.wins;
+    total.pushes += part.pushes;
+    total.losses += part.losses;
+    total.blackjacks += part.blackjacks;
+    total.doubles += part.doubles;
+    total.wagered += part.wagered;
+    total.net += part.net;
+    total.netSquares += part.netSquares;
+}
+
+/** **********************************************************************
+ * @brief Prepares a worker to play the first round of its current block.
+ *
+ * @details The block's random stream is reseeded from the master seed, a
+ *          fresh shoe is shuffled and a new player is seated, so every
+ *          block starts from a state that depends only on its index. Once
+ *          the worker's shoe has the right number of decks and slots it is
+ *          reset in place rather than rebuilt, so that after the first
+ *          block a worker never touches the heap.
+ *
+ * @param[in,out] state The worker whose block is starting.
+ * @param[in] config The simulation parameters.
+ *
+ * @par Example
+ * @code{.cpp}
+ * SimWorkerState state;
+ * startBlock(state, config);
+ * @endcode
+ ************************************************************************/
+void startBlock(SimWorkerState& state, const SimConfig& config)
+{
+    state.engine.seed(blockSeed(config.seed, state.block));
+    if (state.shoe.decks == config.decks
+        && state.shoe.machine.slotCount == config.machineSlots)
+        resetShoe(state.shoe, config.penetration);
+    else
+        state.shoe = Shoe(config.decks, config.penetration,
+            config.machineSlots);
+    shuffleShoe(state.shoe, state.engine);
+    state.player = Player(config.bankroll);
+}
+
+/** **********************************************************************
+ * @brief Plays every block assigned to one worker thread.
+ *
+ * @details Worker w plays blocks w, w + threads, w + 2 * threads and so on,
+ *          resuming from whatever position its state holds. In a sharded
+ *          run those positions count only the blocks of this shard, which
+ *          are the blocks whose number leaves the shard index as remainder
+ *          when divided by the shard count. With a precision target, the
+ *          worker checks in at the wave gate before each block that starts
+ *          a new wave, and stops if the target has been reached. When
+ *          checkpointing is enabled the state is published to the
+ *          worker's snapshot buffer every few thousand rounds, which costs
+ *          one copy and never waits on the checkpoint writer. With a
+ *          transcript, rounds are logged into the worker's own buffer,
+ *          which is written out in one piece whenever it is nearly full.
+ *          A failed write is recorded in the transcript, so the run can
+ *          report it.
+ *          Each log starts with its block and round, since the workers'
+ *          pieces interleave in the file.
+ *
+ * @param[in,out] state The worker's state.
+ * @param[in] config The simulation parameters.
+ * @param[in] strategy The chart the player follows.
+ * @param[in,out] snapshots The worker's snapshot buffer, or nullptr when
+ *                          checkpointing is disabled.
+ * @param[in,out] gate The wave gate, or nullptr without a precision
+ *                     target.
+ * @param[in,out] transcript The shared transcript file, or nullptr.
+ *
+ * @par Example
+ * @code{.cpp}
+ * runWorker(state, config, strategy, nullptr, nullptr, nullptr);
+ * @endcode
+ ************************************************************************/
+void runWorker(SimWorkerState& state, const SimConfig& config,
+    const Strategy& strategy, SnapshotBuffer* snapshots, WaveGate* gate,
+    TranscriptFile* transcript)
+{
+    uint64_t blocks = (config.rounds + config.blockRounds - 1)
+        / config.blockRounds;
+    uint64_t sincePublish = 0;
+
+    if (state.done)
+        return; // Finished before the checkpoint it was restored from
+
+    FrameBuffer frame(transcript ? transcript->file : nullptr,
+        transcript ? TRANSCRIPT_BYTES : 0,
+        transcript ? &transcript->lock : nullptr);
+    ostream log(&frame);
+
+    while (state.block < blocks)
+    {
+        uint64_t blockSize = min(config.blockRounds,
+            config.rounds - state.block * config.blockRounds);
+
+        if (state.blockRound == 0)
+        {
+            if (gate && !waitForWave(*gate, config, state))
+                break;
+            startBlock(state, config);
+        }
+
+        while (state.blockRound < blockSize)
+        {
+            if (transcript)
+            {
+                frame.makeRoom(TRANSCRIPT_ROUND_BYTES);
+                log << "Block " << state.block << " round "
+                    << state.blockRound << ": ";
+            }
+
+            simulateRound(state.shoe, state.engine, state.player, strategy,
+                config.bet, config.rules, state.stats,
+                transcript ? &log : nullptr, nullptr, config.insurance);
+            state.blockRound++;
+
+            if (snapshots && ++sincePublish >= SNAPSHOT_ROUNDS)
+            {
+                publishSnapshot(*snapshots, state, false);
+                sincePublish = 0;
+            }
+        }
+
+        state.block += config.threads * config.shardCount;
+        state.blockRound = 0;
+    }
+
+    if (gate)
+        leaveWave(*gate, config);
+    if (transcript && !frame.writeFrame())
+        transcript->failed = true;
+
+    state.done = true;
+    if (snapshots)
+        publishSnapshot(*snapshots, state, true);
+}
+
+/** **********************************************************************
+ * @brief Finds the wave boundary a run with a precision target starts at.
+ *
+ * @details A new run starts before the first boundary. A run resumed from
+ *          a checkpoint starts at the boundary after the latest block any
+ *          worker had begun, since no worker can have begun a block beyond
+ *          the boundary the gate was at. If that boundary had in fact
+ *          already been checked, it is simply checked again with the same
+ *          totals and the same outcome.
+ *
+ * @param[in] config The simulation parameters.
+ * @param[in] workers The worker states.
+ *
+ * @returns The first block of the wave after the current one.
+ *
+ * @par Example
+ * @code{.cpp}
+ * gate.waveEnd = firstWaveEnd(config, workers);
+ * @endcode
+ ************************************************************************/
+uint64_t firstWaveEnd(const SimConfig& config,
+    const vector<SimWorkerState>& workers)
+{
+    uint64_t begun = 0; // One past the latest block begun by any worker
+
+    for (const SimWorkerState& worker : workers)
+    {
+        if (worker.blockRound > 0)
+            begun = max(begun, worker.block + 1);
+        else if (worker.block >= (uint64_t)config.threads)
+            begun = max(begun, worker.block - config.threads + 1);
+    }
+
+    return max<uint64_t>(1, (begun + WAVE_BLOCKS - 1) / WAVE_BLOCKS)
+        * WAVE_BLOCKS;
+}
+
+/** **********************************************************************
+ * @brief Waits at the wave gate until a worker may start its next block.
+ *
+ * @details A worker whose next block lies beyond the current wave waits
+ *          for every other active worker to get there too. The last to
+ *          arrive checks the totals, and the worker then either goes on or
+ *          waits at the next boundary if its block is further still.
+ *
+ * @param[in,out] gate The wave gate.
+ * @param[in] config The simulation parameters.
+ * @param[in] state The worker's state, about to start state.block.
+ *
+ * @returns `false` if the precision target was reached and the worker
+ *          should stop.
+ *
+ * @par Example
+ * @code{.cpp}
+ * if (!waitForWave(gate, config, state))
+ *     break;
+ * @endcode
+ ************************************************************************/
+bool waitForWave(WaveGate& gate, const SimConfig& config,
+    const SimWorkerState& state)
+{
+    unique_lock<mutex> lock(gate.lock);
+
+    while (!gate.stop && state.block >= gate.waveEnd)
+    {
+        if (++gate.waiting == gate.active)
+            checkWave(gate, config);
+        else
+        {
+            uint64_t generation = gate.generation;
+            gate.released.wait(lock, [&gate, generation]
+                { return gate.generation != generation; });
+        }
+    }
+    return !gate.stop;
+}
+
+/** **********************************************************************
+ * @brief Checks the totals at a wave boundary and releases the workers.
+ *
+ * @details Every active worker is waiting and every other worker has
+ *          finished, so all totals are settled and cover exactly the
+ *          blocks before the boundary. This is the only place the margin
+ *          of error is computed, once per wave rather than per round. The
+ *          caller must hold the gate's lock.
+ *
+ * @param[in,out] gate The wave gate.
+ * @param[in] config The simulation parameters.
+ *
+ * @par Example
+ * @code{.cpp}
+ * checkWave(gate, config);
+ * @endcode
+ ************************************************************************/
+void checkWave(WaveGate& gate, const SimConfig& config)
+{
+    SimStats total;
+
+    for (const SimWorkerState& worker : *gate.workers)
+        mergeStats(total, worker.stats);
+
+    if (edgeMargin(total) <= config.precision)
+        gate.stop = true;
+    else
+        gate.waveEnd += WAVE_BLOCKS;
+
+    gate.waiting = 0;
+    gate.generation++;
+    gate.released.notify_all();
+}
+
+/** **********************************************************************
+ * @brief Removes a worker that has run out of blocks from the wave gate.
+ *
+ * @details If every remaining worker is already waiting, the boundary is
+ *          checked now since nobody else will arrive.
+ *
+ * @param[in,out] gate The wave gate.
+ * @param[in] config The simulation parameters.
+ *
+ * @par Example
+ * @code{.cpp}
+ * leaveWave(gate, config);
+ * @endcode
+ ************************************************************************/
+void leaveWave(WaveGate& gate, const SimConfig& config)
+{
+    lock_guard<mutex> lock(gate.lock);
+
+    gate.active--;
+    if (!gate.stop && gate.active > 0 && gate.waiting == gate.active)
+        checkWave(gate, config);
+}
+
+/** **********************************************************************
+ * @brief Runs a full simulation across the configured worker threads.
+ *
+ * @details Workers that were restored from a checkpoint continue where
+ *          they stopped; otherwise one fresh worker is created per thread.
+ *          A separate thread writes checkpoints while the workers run. The
+ *          final totals are merged in worker order, and because every
+ *          block is seeded independently they are identical whether or
+ *          not the run was interrupted. Likewise the totals of the shards
+ *          of a split run add up to those of the whole run. With a
+ *          precision target the workers share a wave gate, so the run
+ *          stops after the same block whatever the thread count.
+ *
+ * @param[in] config The simulation parameters.
+ * @param[in,out] workers The worker states, empty for a new run.
+ * @param[in,out] transcript The open transcript file, or nullptr.
+ *
+ * @returns The combined totals of every round played.
+ *
+ * @par Example
+ * @code{.cpp}
+ * SimConfig config;
+ * vector<SimWorkerState> workers;
+ * SimStats stats = runSimulation(config, workers);
+ * @endcode
+ ************************************************************************/
+SimStats runSimulation(const SimConfig& config,
+    vector<SimWorkerState>& workers, TranscriptFile* transcript)
+{
+    Strategy strategy;
+    SimStats total;
+    vector<thread> threads;
+    vector<SnapshotBuffer> snapshots(config.threads);
+    bool checkpointing = !config.checkpointFile.empty();
+    mutex doneLock;
+    condition_variable doneSignal;
+    bool allDone = false;
+    WaveGate gate;
+
+    basicStrategy(strategy);
+
+    if (workers.empty())
+    {
+        workers.resize(config.threads);
+        for (int w = 0; w < config.threads; w++)
+            workers[w].block = config.shardIndex + w * config.shardCount;
+    }
+
+    gate.workers = &workers;
+    gate.waveEnd = firstWaveEnd(config, workers);
+    for (const SimWorkerState& worker : workers)
+        gate.active += worker.done ? 0 : 1;
+
+    for (int w = 0; w < config.threads; w++)
+        snapshots[w].slots[0] = workers[w];
+
+    for (int w = 0; w < config.threads; w++)
+        threads.emplace_back(runWorker, ref(workers[w]), cref(config),
+            cref(strategy), checkpointing ? &snapshots[w] : nullptr,
+            config.precision > 0.0 ? &gate : nullptr, transcript);
+
+    thread writer;
+    if (checkpointing)
+        writer = thread(checkpointLoop, cref(config), ref(snapshots),
+            ref(doneLock), ref(doneSignal), ref(allDone));
+
+    for (thread& worker : threads)
+        worker.join();
+
+    if (checkpointing)
+    {
+        {
+            lock_guard<mutex> lock(doneLock);
+            allDone = true;
+        }
+        doneSignal.notify_one();
+        writer.join();
+    }
+
+    for (const SimWorkerState& worker : workers)
+        mergeStats(total, worker.stats);
+
+    return total;
+}
+
+/** **********************************************************************
+ * @brief Returns the house edge of a set of totals.
+ *
+ * @details The house edge is the player's net loss per token of initial
+ *          bet.
+ *
+ * @param[in] stats The totals.
+ *
+ * @returns The house edge in percent.
+ *
+ * @par Example
+ * @code{.cpp}
+ * double edge = houseEdge(stats);
+ * @endcode
+ ************************************************************************/
+double houseEdge(const SimStats& stats)
+{
+    double rounds = (double)max<uint64_t>(stats.rounds, 1);
+    double meanBet = max<double>((double)stats.wagered / rounds, 1.0);
+    double mean = (double)stats.net / rounds;
+
+    return (-mean / meanBet) * 100.0;
+}
+
+/** **********************************************************************
+ * @brief Returns the margin of error of a house edge.
+ *
+ * @details The margin is derived from the variance of the per-round net
+ *          result at a 95% confidence level.
+ *
+ * @param[in] stats The totals.
+ *
+ * @returns The half-width of the confidence interval, in percent.
+ *
+ * @par Example
+ * @code{.cpp}
+ * bool precise = edgeMargin(stats) <= 0.05;
+ * @endcode
+ ************************************************************************/
+double edgeMargin(const SimStats& stats)
+{
+    double rounds = (double)max<uint64_t>(stats.rounds, 1);
+    double meanBet = max<double>((double)stats.wagered / rounds, 1.0);
+    double mean = (double)stats.net / rounds;
+    double variance = max(0.0, (double)stats.netSquares / rounds
+        - mean * mean);
+
+    return 1.96 * sqrt(variance / rounds) / meanBet * 100.0;
+}
+
+/** **********************************************************************
+ * @brief Displays the results of a simulation run.
+ *
+ * @details The house edge is shown with its margin of error at a 95%
+ *          confidence level.
+ *
+ * @param[in] stats The totals of the run.
+ * @param[in] config The simulation parameters.
+ *
+ * @par Example
+ * @code{.cpp}
+ * printSimReport(stats, config);
+ * @endcode
+ ************************************************************************/
+void printSimReport(const SimStats& stats, const SimConfig& config)
+{
+    cout << fixed << setprecision(4);
+    cout << "Rounds played: " << stats.rounds << endl;
+    cout << "Decks: " << config.decks << "  Seed: " << config.seed;
+    if (config.rules == RULES_H17)
+        cout << "  Dealer hits soft 17";
+    if (config.insurance == INSURANCE_PERFECT)
+        cout << "  Count-perfect insurance";
+    if (config.machineSlots > 0)
+        cout << "  Continuous shuffler: " << config.machineSlots << " slots";
+    if (config.shardCount > 1)
+        cout << "  Shard: " << config.shardIndex << "/" << config.shardCount;
+    cout << endl;
+    cout << "Wins: " << stats.wins << "  Pushes: " << stats.pushes
+        << "  Losses: " << stats.losses << endl;
+    cout << "Blackjacks: " << stats.blackjacks << "  Doubles: "
+        << stats.doubles << endl;
+    cout << "Net tokens: " << stats.net << endl;
+    cout << "House edge: " << houseEdge(stats) << "% +/- "
+        << edgeMargin(stats) << "%" << endl;
+    if (config.precision > 0.0)
+        cout << "Target margin: " << config.precision << "% "
+            << (edgeMargin(stats) <= config.precision ? "(reached)"
+            : "(round limit reached first)") << endl;
+    cout.unsetf(ios::floatfield);
+}
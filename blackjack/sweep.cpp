@@ -0,0 +1,660 @@
+/** **********************************************************************
+* @file
+*
+* @brief This file contains the definitions for the parameter sweep, which
+*        simulates every cell of a grid of rule and shoe parameters across
+*        all cores, caching finished cells and stopping cells early once
+*        their house edge is known precisely enough.
+************************************************************************/
+
+#include "blackjack.h"
+
+/** ***************************************************************************
+*                             Sweep Definitions
+******************************************************************************/
+
+/** **********************************************************************
+ * @brief Runs the sweep command from the command line.
+ *
+ * @details The grid file lists the values of each parameter, and every
+ *          combination becomes one cell. Cells found in the cache file
+ *          are not simulated again. The others are shared out block by
+ *          block to the worker threads, and each cell is appended to the
+ *          cache and to the report file as soon as it finishes, so an
+ *          interrupted sweep loses only the cells still running. The full
+ *          table is printed in grid order at the end.
+ *
+ * @param[in] argc The number of arguments after the program name.
+ * @param[in] argv The arguments, starting with the command word.
+ *
+ * @returns 0 if the sweep ran, 1 if the arguments, the grid or the cache
+ *          could not be used.
+ *
+ * @par Example
+ * @code{.cpp}
+ * return runSweepCommand(argc - 1, argv + 1);
+ * @endcode
+ ************************************************************************/
+int runSweepCommand(int argc, char* argv[])
+{
+    SweepQueue queue;
+    vector<thread> workers;
+    Strategy strategy;
+    string cacheFile, outFile;
+    int threads = SimConfig().threads;
+    uint64_t number;
+
+    if (argc < 2 || !readSweepGrid(argv[1], queue.cells, queue.precision))
+    {
+        cerr << "Unable to read sweep grid" << endl;
+        printUsage();
+        return 1;
+    }
+
+    for (int i = 2; i < argc; i += 2)
+    {
+        string option = argv[i];
+
+        if (i + 1 >= argc)
+        {
+            printUsage();
+            return 1;
+        }
+        else if (option == "--cache")
+            cacheFile = argv[i + 1];
+        else if (option == "--out")
+            outFile = argv[i + 1];
+        else if (option == "--threads" && parseCount(argv[i + 1], number)
+            && number >= 1 && number <= 1024)
+            threads = (int)number;
+        else
+        {
+            cerr << "Invalid option: " << argv[i] << " " << argv[i + 1]
+                << endl;
+            printUsage();
+            return 1;
+        }
+    }
+
+    for (SweepCell& cell : queue.cells)
+    {
+        cell.key = sweepKey(cell.config, queue.precision, cell.rampText);
+        cell.hash = hashText(cell.key);
+        cell.run.blocks = runBlocks(cell.config);
+        cell.finished = (cell.run.blocks == 0);
+    }
+
+    if (!cacheFile.empty())
+    {
+        bool exists = (bool)ifstream(cacheFile);
+
+        if (exists && !loadSweepCache(cacheFile, queue.cells))
+        {
+            cerr << cacheFile << " is not a sweep cache" << endl;
+            return 1;
+        }
+
+        queue.cacheFile.open(cacheFile, ios::app);
+        if (!exists)
+            queue.cacheFile << "BJSWEEP 1\n";
+    }
+
+    if (!outFile.empty())
+    {
+        queue.outFile.open(outFile);
+        for (const SweepCell& cell : queue.cells)
+        {
+            if (cell.cached)
+                writeSweepLine(queue.outFile, cell);
+        }
+        queue.outFile.flush();
+    }
+
+    basicStrategy(strategy);
+    for (int w = 0; w < threads; w++)
+        workers.emplace_back(runSweepWorker, ref(queue), cref(strategy));
+    for (thread& worker : workers)
+        worker.join();
+
+    cout << "Rules Decks Penetration CSM   Bet       Rounds    Edge%  "
+        << "Margin%  Ramp" << endl;
+    for (const SweepCell& cell : queue.cells)
+        writeSweepLine(cout, cell);
+
+    if (queue.cacheFile.is_open() && !queue.cacheFile)
+        cerr << "Unable to write sweep cache " << cacheFile << endl;
+    return 0;
+}
+
+/** **********************************************************************
+ * @brief Reads a sweep grid file.
+ *
+ * @details Each line names a parameter followed by the values to sweep,
+ *          such as "decks 1 2 6 8", and text after a '#' is ignored. The
+ *          parameters are those of a plain simulation without the dashes
+ *          (simulate, seed, decks, penetration, bet, block, csm, rules),
+ *          plus "ramp", a bet ramp as parseBetRamp() reads it, and
+ *          "precision", the margin of error in percent at which a cell
+ *          stops early. A ramp places each round's bet by the true count
+ *          in place of the flat bet, so it needs a dealt shoe. The grid
+ *          holds every combination of values, with the last line's
+ *          parameter changing fastest.
+ *
+ * @param[in] fileName The grid file.
+ * @param[out] grid Every cell, with its configuration and ramp set.
+ * @param[out] precision The early stopping margin, 0 if not given.
+ *
+ * @returns `true` if every line was understood and no cell combines a
+ *          ramp with a continuous shuffler.
+ *
+ * @par Example
+ * @code{.cpp}
+ * vector<SweepCell> grid;
+ * double precision;
+ * readSweepGrid("nightly.grid", grid, precision);
+ * @endcode
+ ************************************************************************/
+bool readSweepGrid(const string& fileName, vector<SweepCell>& grid,
+    double& precision)
+{
+    ifstream file(fileName);
+    string line;
+    vector<string> names;
+    vector<vector<string>> values;
+
+    if (!file)
+        return false;
+
+    precision = 0.0;
+    while (getline(file, line))
+    {
+        istringstream in(line.substr(0, line.find('#')));
+        string name, value;
+
+        if (!(in >> name))
+            continue;
+
+        if (name == "precision")
+        {
+            if (!(in >> value) || !parseReal(value.c_str(), precision)
+                || precision < 0.0 || (in >> value))
+                return false;
+            continue;
+        }
+        if (name == "threads")
+            return false; // Threads are a property of the machine, not a cell
+
+        names.push_back(name);
+        values.emplace_back();
+        while (in >> value)
+        {
+            SimConfig check;
+            BetRamp ramp;
+
+            if (name == "ramp" ? !parseBetRamp(value.c_str(), ramp)
+                : !(name == "rules" ? parseRules(value.c_str(), check.rules)
+                : parseSimOption("--" + name, value.c_str(), check)))
+                return false;
+            values.back().push_back(value);
+        }
+        if (values.back().empty())
+            return false;
+    }
+
+    vector<size_t> digit(names.size(), 0);
+    grid.clear();
+    while (true)
+    {
+        SweepCell cell;
+
+        for (size_t n = 0; n < names.size(); n++)
+        {
+            const char* value = values[n][digit[n]].c_str();
+
+            if (names[n] == "ramp")
+            {
+                cell.rampText = value;
+                parseBetRamp(value, cell.ramp);
+            }
+            else if (names[n] == "rules")
+                parseRules(value, cell.config.rules);
+            else
+                parseSimOption("--" + names[n], value, cell.config);
+        }
+        if (!cell.rampText.empty() && cell.config.machineSlots > 0)
+            return false; // A shuffling machine leaves no count to bet on
+        grid.push_back(cell);
+
+        // Step to the next combination like an odometer
+        size_t n = names.size();
+        while (n > 0 && ++digit[n - 1] == values[n - 1].size())
+            digit[--n] = 0;
+        if (n == 0)
+            break;
+    }
+    return true;
+}
+
+/** **********************************************************************
+ * @brief Builds the text that identifies a sweep cell's results.
+ *
+ * @details Every parameter that changes the rounds played is included,
+ *          along with the early stopping margin, the number of blocks
+ *          between its checks and the engine version, so cached results
+ *          are never reused after any of them changes. A bet ramp is
+ *          added only when there is one, so flat cells keep their keys.
+ *
+ * @param[in] config The cell's parameters.
+ * @param[in] precision The early stopping margin.
+ * @param[in] ramp The cell's bet ramp as written in the grid, or empty.
+ *
+ * @returns The key text.
+ *
+ * @par Example
+ * @code{.cpp}
+ * string key = sweepKey(config, 0.05);
+ * @endcode
+ ************************************************************************/
+string sweepKey(const SimConfig& config, double precision,
+    const string& ramp)
+{
+    ostringstream key;
+
+    key << "engine=" << SIM_ENGINE_VERSION << " rules=" << config.rules
+        << " decks=" << config.decks << " penetration="
+        << setprecision(17) << config.penetration << " csm="
+        << config.machineSlots << " bet=" << config.bet << " bankroll="
+        << config.bankroll << " rounds=" << config.rounds << " block="
+        << config.blockRounds << " seed=" << config.seed << " precision="
+        << precision;
+    if (precision > 0.0)
+        key << " wave=" << WAVE_BLOCKS; // Where an early stop can happen
+    if (!ramp.empty())
+        key << " ramp=" << ramp;
+    return key.str();
+}
+
+/** **********************************************************************
+ * @brief Hashes a string with 64-bit FNV-1a.
+ *
+ * @param[in] text The text to hash.
+ *
+ * @returns The hash, which is the same on every platform.
+ *
+ * @par Example
+ * @code{.cpp}
+ * uint64_t hash = hashText(sweepKey(config, 0.0));
+ * @endcode
+ ************************************************************************/
+uint64_t hashText(const string& text)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+
+    for (unsigned char c : text)
+    {
+        hash ^= c;
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+/** **********************************************************************
+ * @brief Marks every cell found in a sweep cache file as finished.
+ *
+ * @param[in] fileName The cache file, which must exist.
+ * @param[in,out] cells The sweep's cells.
+ *
+ * @returns `false` if the file is not a sweep cache.
+ *
+ * @par Example
+ * @code{.cpp}
+ * loadSweepCache("sweep.cache", queue.cells);
+ * @endcode
+ ************************************************************************/
+bool loadSweepCache(const string& fileName, vector<SweepCell>& cells)
+{
+    ifstream file(fileName);
+    string line, tag;
+    uint64_t hash;
+    SimStats stats;
+
+    if (!getline(file, line) || line != "BJSWEEP 1")
+        return false;
+
+    while (file >> tag >> hex >> hash >> dec && tag == "cell"
+        && readStats(file, stats))
+    {
+        for (SweepCell& cell : cells)
+        {
+            if (cell.hash == hash)
+            {
+                cell.run.stats = stats;
+                cell.finished = true;
+                cell.cached = true;
+            }
+        }
+    }
+    return true;
+}
+
+/** **********************************************************************
+ * @brief Records a cell that has just finished.
+ *
+ * @details The cell is appended to the cache and report files and both
+ *          are flushed, so a finished cell survives an interrupted sweep.
+ *          The caller must hold the queue's lock.
+ *
+ * @param[in,out] queue The sweep queue.
+ * @param[in,out] cell The cell that finished.
+ *
+ * @par Example
+ * @code{.cpp}
+ * finishSweepCell(queue, cell);
+ * @endcode
+ ************************************************************************/
+void finishSweepCell(SweepQueue& queue, SweepCell& cell)
+{
+    cell.finished = true;
+    cell.run.pending.clear();
+
+    if (queue.cacheFile.is_open())
+    {
+        queue.cacheFile << "cell " << hex << cell.hash << dec << " ";
+        writeStats(queue.cacheFile, cell.run.stats);
+        queue.cacheFile.flush();
+    }
+
+    if (queue.outFile.is_open())
+    {
+        writeSweepLine(queue.outFile, cell);
+        queue.outFile.flush();
+    }
+}
+
+/** **********************************************************************
+ * @brief Counts the blocks of a run that is never stopped early.
+ *
+ * @param[in] config The simulation parameters.
+ *
+ * @returns The number of blocks, the last of which may be short.
+ *
+ * @par Example
+ * @code{.cpp}
+ * cell.run.blocks = runBlocks(cell.config);
+ * @endcode
+ ************************************************************************/
+uint64_t runBlocks(const SimConfig& config)
+{
+    return (config.rounds + config.blockRounds - 1) / config.blockRounds;
+}
+
+/** **********************************************************************
+ * @brief Checks whether a run has a block to hand to a worker.
+ *
+ * @details With a precision target, a run hands out at most two waves of
+ *          blocks beyond those already counted, so little work is wasted
+ *          once it stops.
+ *
+ * @param[in] run The run.
+ * @param[in] precision The margin of error that stops the run, 0 for none.
+ *
+ * @returns `true` if run.nextBlock may be played now.
+ *
+ * @par Example
+ * @code{.cpp}
+ * if (blockAvailable(cell.run, queue.precision))
+ *     block = cell.run.nextBlock++;
+ * @endcode
+ ************************************************************************/
+bool blockAvailable(const BlockRun& run, double precision)
+{
+    return run.nextBlock < run.blocks && (precision <= 0.0
+        || run.nextBlock < run.doneBlocks + 2 * WAVE_BLOCKS);
+}
+
+/** **********************************************************************
+ * @brief Adds a finished block to a run.
+ *
+ * @details Blocks are counted strictly in order, so a block that finishes
+ *          early waits in the run's pending list. The early stopping test
+ *          is only made every WAVE_BLOCKS blocks, as a plain run makes it,
+ *          which makes the blocks counted and the point where a run stops
+ *          the same as for a plain run and for any thread count. The
+ *          caller must hold whatever lock guards the run.
+ *
+ * @param[in,out] run The run.
+ * @param[in] block The block number.
+ * @param[in] stats The block's totals.
+ * @param[in] precision The margin of error that stops the run, 0 for none.
+ *
+ * @returns `true` once the run is finished, either because every block has
+ *          been counted or because the precision target was reached.
+ *
+ * @par Example
+ * @code{.cpp}
+ * if (countRunBlock(cell.run, block, stats, queue.precision))
+ *     finishSweepCell(queue, cell);
+ * @endcode
+ ************************************************************************/
+bool countRunBlock(BlockRun& run, uint64_t block, const SimStats& stats,
+    double precision)
+{
+    run.pending[block] = stats;
+    while (!run.pending.empty() && run.pending.begin()->first == run.doneBlocks)
+    {
+        mergeStats(run.stats, run.pending.begin()->second);
+        run.pending.erase(run.pending.begin());
+        run.doneBlocks++;
+
+        if (run.doneBlocks == run.blocks || (precision > 0.0
+            && run.doneBlocks % WAVE_BLOCKS == 0
+            && edgeMargin(run.stats) <= precision))
+            return true;
+    }
+    return false;
+}
+
+/** **********************************************************************
+ * @brief Takes the next block to play from the sweep queue.
+ *
+ * @details The earliest unfinished cell with a block available is
+ *          served first, so when early stopping holds a cell back the next
+ *          cell is served meanwhile. If no block can be handed out yet,
+ *          the caller waits for one to finish.
+ *
+ * @param[in,out] queue The sweep queue.
+ * @param[out] cell The index of the block's cell.
+ * @param[out] block The block number within the cell.
+ *
+ * @returns `false` once every cell has finished.
+ *
+ * @par Example
+ * @code{.cpp}
+ * while (nextSweepBlock(queue, cell, block))
+ *     countSweepBlock(queue, cell, block, playBlock(config, strategy, block));
+ * @endcode
+ ************************************************************************/
+bool nextSweepBlock(SweepQueue& queue, size_t& cell, uint64_t& block)
+{
+    unique_lock<mutex> lock(queue.lock);
+
+    while (true)
+    {
+        bool allFinished = true;
+
+        while (queue.firstOpen < queue.cells.size()
+            && (queue.cells[queue.firstOpen].finished
+            || queue.cells[queue.firstOpen].run.nextBlock
+            >= queue.cells[queue.firstOpen].run.blocks))
+            queue.firstOpen++;
+
+        for (size_t c = 0; c < queue.cells.size(); c++)
+        {
+            SweepCell& candidate = queue.cells[c];
+
+            if (candidate.finished)
+                continue;
+            allFinished = false;
+
+            if (c < queue.firstOpen
+                || !blockAvailable(candidate.run, queue.precision))
+                continue;
+
+            cell = c;
+            block = candidate.run.nextBlock++;
+            return true;
+        }
+
+        if (allFinished)
+            return false;
+        queue.changed.wait(lock);
+    }
+}
+
+/** **********************************************************************
+ * @brief Adds a finished block to its cell.
+ *
+ * @details The block is counted by countRunBlock(), and the cell is
+ *          written out once that finishes it. Blocks that finish after
+ *          their cell has stopped are dropped.
+ *
+ * @param[in,out] queue The sweep queue.
+ * @param[in] cell The index of the block's cell.
+ * @param[in] block The block number within the cell.
+ * @param[in] stats The block's totals.
+ *
+ * @par Example
+ * @code{.cpp}
+ * countSweepBlock(queue, cell, block, stats);
+ * @endcode
+ ************************************************************************/
+void countSweepBlock(SweepQueue& queue, size_t cell, uint64_t block,
+    const SimStats& stats)
+{
+    lock_guard<mutex> lock(queue.lock);
+    SweepCell& target = queue.cells[cell];
+
+    if (!target.finished
+        && countRunBlock(target.run, block, stats, queue.precision))
+        finishSweepCell(queue, target);
+    queue.changed.notify_all();
+}
+
+/** **********************************************************************
+ * @brief Plays one block of a simulation from its start on a worker's
+ *        state.
+ *
+ * @details The block is set up exactly as runWorker() would set it up, so
+ *          a run played block by block has the same totals as a plain run
+ *          with the same parameters. startBlock() resets the shoe in place
+ *          whenever the previous block had the same shoe size, so a warm
+ *          worker does not allocate between blocks.
+ *
+ * @param[in,out] state The worker's state, which is overwritten.
+ * @param[in] config The simulation parameters.
+ * @param[in] strategy The chart the player follows.
+ * @param[in] block The block number.
+ * @param[in] ramp The bet ramp that places each round's bet by the true
+ *                 count, or nullptr for the flat bet of the config.
+ *
+ * @returns The totals of the block's rounds.
+ *
+ * @par Example
+ * @code{.cpp}
+ * SimStats stats = playBlock(state, config, strategy, 0);
+ * @endcode
+ ************************************************************************/
+SimStats playBlock(SimWorkerState& state, const SimConfig& config,
+    const Strategy& strategy, uint64_t block, const BetRamp* ramp)
+{
+    uint64_t blockSize = min(config.blockRounds,
+        config.rounds - block * config.blockRounds);
+
+    state.block = block;
+    state.stats = SimStats();
+    startBlock(state, config);
+    for (uint64_t round = 0; round < blockSize; round++)
+        simulateRound(state.shoe, state.engine, state.player, strategy,
+            ramp ? rampBet(*ramp, state.shoe) : config.bet, config.rules,
+            state.stats);
+
+    return state.stats;
+}
+
+/** **********************************************************************
+ * @brief Plays one block of a simulation from its start on a fresh state.
+ *
+ * @param[in] config The simulation parameters.
+ * @param[in] strategy The chart the player follows.
+ * @param[in] block The block number.
+ *
+ * @returns The totals of the block's rounds.
+ *
+ * @par Example
+ * @code{.cpp}
+ * SimStats stats = playBlock(config, strategy, 0);
+ * @endcode
+ ************************************************************************/
+SimStats playBlock(const SimConfig& config, const Strategy& strategy,
+    uint64_t block)
+{
+    SimWorkerState state;
+
+    return playBlock(state, config, strategy, block);
+}
+
+/** **********************************************************************
+ * @brief Plays blocks from the sweep queue until every cell is finished.
+ *
+ * @details A cell's parameters never change once the sweep starts, so
+ *          they are read without the queue's lock. The worker keeps one
+ *          state for all of its blocks.
+ *
+ * @param[in,out] queue The sweep queue.
+ * @param[in] strategy The chart the player follows.
+ *
+ * @par Example
+ * @code{.cpp}
+ * thread worker(runSweepWorker, ref(queue), cref(strategy));
+ * @endcode
+ ************************************************************************/
+void runSweepWorker(SweepQueue& queue, const Strategy& strategy)
+{
+    SimWorkerState state;
+    size_t cell;
+    uint64_t block;
+
+    while (nextSweepBlock(queue, cell, block))
+    {
+        const SweepCell& target = queue.cells[cell];
+        SimStats stats = playBlock(state, target.config, strategy, block,
+            target.rampText.empty() ? nullptr : &target.ramp);
+        countSweepBlock(queue, cell, block, stats);
+    }
+}
+
+/** **********************************************************************
+ * @brief Writes one sweep cell as a line of the results table.
+ *
+ * @param[in,out] out The output stream.
+ * @param[in] cell The finished cell.
+ *
+ * @par Example
+ * @code{.cpp}
+ * writeSweepLine(cout, cell);
+ * @endcode
+ ************************************************************************/
+void writeSweepLine(ostream& out, const SweepCell& cell)
+{
+    const SimConfig& config = cell.config;
+
+    out << (config.rules == RULES_H17 ? "h17  " : "s17  ") << setw(5)
+        << config.decks << " " << fixed << setprecision(4) << setw(11)
+        << config.penetration << " " << setw(3) << config.machineSlots << " "
+        << setw(5) << config.bet << " " << setw(12) << cell.run.stats.rounds
+        << " " << setw(7) << houseEdge(cell.run.stats) << " " << setw(8)
+        << edgeMargin(cell.run.stats) << "  "
+        << (cell.rampText.empty() ? "-" : cell.rampText)
+        << (cell.cached ? "  cached" : "") << "\n";
+    out.unsetf(ios::floatfield);
+}
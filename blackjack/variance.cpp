@@ -0,0 +1,192 @@
+/** **********************************************************************
+* @file
+*
+* @brief This file contains the definitions for the variance command, which
+*        measures how precisely a run pins down the house edge from the
+*        spread between its blocks, and compares that with the margin a
+*        simulation reports.
+*
+* @details A simulation's margin treats every round as independent. Rounds
+*          dealt from the same shoe are not quite, since they share its
+*          cards, but blocks are: each has its own seed and shoe. The
+*          spread between blocks therefore gives a margin that makes no
+*          assumption about rounds, and the ratio of the two variances
+*          shows how far the per-round margin can be trusted.
+************************************************************************/
+
+#include "blackjack.h"
+
+/** ***************************************************************************
+*                            Variance Definitions
+******************************************************************************/
+
+const uint64_t VARIANCE_ROUNDS = 4000000; // Default rounds measured
+const uint64_t VARIANCE_BLOCK_ROUNDS = 2000; // Default rounds per block
+const double VARIANCE_TARGET = 0.1; // Margin used without --precision
+
+/** **********************************************************************
+ * @brief Plays blocks for the variance command.
+ *
+ * @details Worker w plays blocks w, w + threads and so on, and keeps the
+ *          totals of each block apart, since blocks are the independent
+ *          samples.
+ *
+ * @param[in] config The simulation parameters.
+ * @param[in] strategy The chart the player follows.
+ * @param[in] worker The worker's number.
+ * @param[out] samples The totals of every block, of which the worker
+ *                     fills in its own.
+ *
+ * @par Example
+ * @code{.cpp}
+ * thread worker(runSampleWorker, cref(config), cref(strategy), w,
+ *     ref(samples));
+ * @endcode
+ ************************************************************************/
+void runSampleWorker(const SimConfig& config, const Strategy& strategy,
+    int worker, vector<SimStats>& samples)
+{
+    SimWorkerState state;
+
+    for (size_t block = worker; block < samples.size();
+        block += config.threads)
+    {
+        state.block = block;
+        state.stats = SimStats();
+        startBlock(state, config);
+        for (uint64_t round = 0; round < config.blockRounds; round++)
+            simulateRound(state.shoe, state.engine, state.player, strategy,
+                config.bet, config.rules, state.stats, nullptr, nullptr,
+                config.insurance);
+        samples[block] = state.stats;
+    }
+}
+
+/** **********************************************************************
+ * @brief Measures the margin of error of the house edge from independent
+ *        samples, rather than from single rounds as edgeMargin() does.
+ *
+ * @details Rounds within a sample need not be independent, so only the
+ *          spread between samples shows how precise the edge is without
+ *          assuming they are. The edge is a ratio of net result to amount
+ *          wagered, and its variance is estimated by the usual
+ *          linearisation.
+ *
+ * @param[in] samples The totals of each sample, at least two.
+ *
+ * @returns The 95% margin of error of the edge, in percent.
+ *
+ * @par Example
+ * @code{.cpp}
+ * double margin = sampleMargin(samples);
+ * @endcode
+ ************************************************************************/
+double sampleMargin(const vector<SimStats>& samples)
+{
+    SimStats total;
+    double squares = 0.0;
+
+    for (const SimStats& sample : samples)
+        mergeStats(total, sample);
+
+    double ratio = (double)total.net / max<double>((double)total.wagered, 1.0);
+    for (const SimStats& sample : samples)
+    {
+        double residual = sample.net - ratio * sample.wagered;
+        squares += residual * residual;
+    }
+
+    double n = (double)samples.size();
+    double variance = squares * n / max(n - 1.0, 1.0);
+    return 1.96 * sqrt(variance) / max<double>((double)total.wagered, 1.0)
+        * 100.0;
+}
+
+/** **********************************************************************
+ * @brief Runs the variance command, which measures the margin of the
+ *        house edge from the spread between blocks and compares it with
+ *        the per-round margin.
+ *
+ * @details The ratio is the block variance over the per-round variance,
+ *          about 1 when rounds behave as independent. The block variance
+ *          is itself only known to within about sqrt(2 / blocks), which
+ *          the report gives as the ratio's standard error. The rounds
+ *          needed for a margin come from the block variance. The usual
+ *          simulation options describe the run, with more rounds and
+ *          smaller blocks by default, and `--precision` sets the margin
+ *          that the rounds needed are worked out for.
+ *
+ * @param[in] argc The number of arguments after the program name.
+ * @param[in] argv The arguments, starting with the command word.
+ *
+ * @returns 0 on success, 1 if the options were not understood.
+ *
+ * @par Example
+ * @code{.cpp}
+ * return runVarianceCommand(argc - 1, argv + 1);
+ * @endcode
+ ************************************************************************/
+int runVarianceCommand(int argc, char* argv[])
+{
+    SimConfig config;
+    string resumeFile;
+    Strategy strategy;
+    double target;
+
+    config.rounds = VARIANCE_ROUNDS;
+    config.blockRounds = VARIANCE_BLOCK_ROUNDS;
+    if (!parseSimArgs(argc, argv, config, resumeFile))
+    {
+        printUsage();
+        return 1;
+    }
+    if (!resumeFile.empty() || config.shardCount > 1
+        || !config.checkpointFile.empty() || !config.resultFile.empty()
+        || !config.transcriptFile.empty())
+    {
+        cerr << "variance measures a plain run" << endl;
+        return 1;
+    }
+
+    target = config.precision > 0.0 ? config.precision : VARIANCE_TARGET;
+    if (config.rounds == PRECISION_ROUND_LIMIT)
+        config.rounds = VARIANCE_ROUNDS; // No --simulate with the target
+    config.precision = 0.0;
+    basicStrategy(strategy);
+
+    vector<SimStats> samples((size_t)max<uint64_t>(2,
+        config.rounds / config.blockRounds));
+    vector<thread> threads;
+    SimStats total;
+
+    for (int w = 0; w < config.threads; w++)
+        threads.emplace_back(runSampleWorker, cref(config), cref(strategy), w,
+            ref(samples));
+    for (thread& worker : threads)
+        worker.join();
+    for (const SimStats& sample : samples)
+        mergeStats(total, sample);
+
+    double margin = sampleMargin(samples);
+    double perRound = edgeMargin(total);
+    double variance = margin * margin;
+
+    cout << "Rounds: " << total.rounds << " in " << samples.size()
+        << " blocks of " << config.blockRounds << " rounds  Decks: "
+        << config.decks << "\n"
+        << "House edge   Margin  Per-round  Ratio  Rounds for +/-" << fixed
+        << setprecision(2) << target << "%\n"
+        << setprecision(4) << setw(9) << houseEdge(total) << "%"
+        << setw(8) << margin << "%" << setw(10) << perRound << "%"
+        << setprecision(2) << setw(6)
+        << variance / max(perRound * perRound, 1e-300) << "x"
+        << setprecision(0) << setw(21)
+        << total.rounds * variance / (target * target) << "\n";
+    cout << "Margins are at 95% confidence. Margin is measured from the"
+        << " spread between\nblocks. Per-round is the margin the simulation"
+        << " reports, which assumes\nindependent rounds. The ratio has a"
+        << " standard error of about " << setprecision(2)
+        << sqrt(2.0 / (double)samples.size()) << "x." << endl;
+    cout.unsetf(ios::floatfield);
+    return 0;
+}
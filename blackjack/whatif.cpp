@@ -0,0 +1,605 @@
+/** **********************************************************************
+* @file
+*
+* @brief This file contains the definitions for recording the shoes and
+*        decisions of a simulated session as a history, and for the
+*        what-if engine, which replays the same cards under other
+*        strategies and bet ramps.
+*
+* @details A history file starts with a 48 byte header: the text
+*          "BJHISTRY", then the format version, decks, dealer rules, cut
+*          card position, starting tokens and shoe count as 32-bit
+*          integers, then the round count and the offset of the shoes as
+*          64-bit integers. The round records follow the header. Each takes
+*          9 bytes plus one per choice: the bet and the net result as
+*          32-bit integers, the number of choices, and the choices
+*          themselves (1 hit, 2 double down, 3 stand). The shoes come last,
+*          one byte per card (the face value plus 16 times the suit) in
+*          dealing order. Integers are stored little-endian.
+*
+*          Replays treat the shoes as one stream of cards rather than as
+*          the cards of each recorded round. A strategy that draws a card
+*          the original did not shifts every later card of the shoe to a
+*          different hand, and may reach the cut card a round earlier or
+*          later, exactly as it would have at the table.
+************************************************************************/
+
+#include "blackjack.h"
+
+/** ***************************************************************************
+*                             What-if Definitions
+******************************************************************************/
+
+const char HISTORY_MAGIC[8] = { 'B', 'J', 'H', 'I', 'S', 'T', 'R', 'Y' };
+const uint32_t HISTORY_VERSION = 1; // Bumped whenever the layout changes
+const size_t HISTORY_HEADER_BYTES = 48; // Magic through shoe offset
+const size_t HISTORY_ROUND_BYTES = 9; // Round record before its choices
+
+/** **********************************************************************
+ * @brief Adds the cards of a freshly shuffled shoe to a history's shoes.
+ *
+ * @param[in,out] shoes The shoes recorded so far, one byte per card.
+ * @param[in] shoe The shoe, in dealing order.
+ *
+ * @par Example
+ * @code{.cpp}
+ * saveShoe(shoes, shoe);
+ * @endcode
+ ************************************************************************/
+void saveShoe(vector<unsigned char>& shoes, const Shoe& shoe)
+{
+    for (const card& aCard : shoe.cards)
+        shoes.push_back((unsigned char)(aCard.faceValue + 16 * aCard.suit));
+}
+
+/** **********************************************************************
+ * @brief Runs the history command, which simulates a session with basic
+ *        strategy and a flat bet and saves it as a history file.
+ *
+ * @details The session is one continuous stream of shoes drawn from
+ *          `--seed`, and every shoe is saved as it is shuffled. Recording
+ *          goes on past `--simulate` rounds until the cut card is reached,
+ *          so the history ends with a whole shoe and a replay of any
+ *          strategy sees exactly the same cards.
+ *
+ * @param[in] argc The number of arguments after the program name.
+ * @param[in] argv The arguments, starting with the command word.
+ *
+ * @returns 0 if the file was written, 1 otherwise.
+ *
+ * @par Example
+ * @code{.cpp}
+ * return runHistoryCommand(argc - 1, argv + 1);
+ * @endcode
+ ************************************************************************/
+int runHistoryCommand(int argc, char* argv[])
+{
+    SimConfig config;
+    string resumeFile;
+
+    if (argc < 2 || string(argv[1]).compare(0, 2, "--") == 0
+        || !parseSimArgs(argc - 1, argv + 1, config, resumeFile))
+    {
+        printUsage();
+        return 1;
+    }
+
+    if (config.machineSlots > 0 || config.shardCount > 1
+        || config.insurance != INSURANCE_NEVER || config.precision > 0.0
+        || !resumeFile.empty()
+        || !config.checkpointFile.empty() || !config.resultFile.empty()
+        || !config.transcriptFile.empty())
+    {
+        cerr << "history records a single dealt shoe session and takes no"
+            << " shuffler, insurance, checkpoint, shard, result,"
+            << " transcript or precision options" << endl;
+        return 1;
+    }
+
+    ofstream out(argv[1], ios::binary);
+    if (!out)
+    {
+        cerr << "Unable to write " << argv[1] << endl;
+        return 1;
+    }
+
+    mt19937_64 engine(blockSeed(config.seed, 0));
+    Shoe shoe(config.decks, config.penetration);
+    Player player(config.bankroll);
+    Strategy strategy;
+    RoundScript script;
+    SimStats stats;
+    vector<unsigned char> shoes;
+
+    basicStrategy(strategy);
+    out.write(HISTORY_MAGIC, sizeof(HISTORY_MAGIC));
+    writeLittle(out, HISTORY_VERSION, 4);
+    writeLittle(out, (uint32_t)config.decks, 4);
+    writeLittle(out, (uint32_t)config.rules, 4);
+    writeLittle(out, (uint32_t)shoe.cutCard, 4);
+    writeLittle(out, (uint32_t)config.bankroll, 4);
+    writeLittle(out, 0, 4); // Shoe count, filled in at the end
+    writeLittle(out, 0, 8); // Round count, filled in at the end
+    writeLittle(out, 0, 8); // Shoe offset, filled in at the end
+
+    shuffleShoe(shoe, engine);
+    saveShoe(shoes, shoe);
+    for (uint64_t round = 0; round < config.rounds
+        || shoe.position < shoe.cutCard; round++)
+    {
+        int before = shoe.position;
+
+        script.actionCount = 0;
+        simulateRound(shoe, engine, player, strategy, config.bet,
+            config.rules, stats, nullptr, &script);
+
+        // The round reshuffled at the cut card or when the shoe ran out
+        if (before >= shoe.cutCard || shoe.position < before)
+            saveShoe(shoes, shoe);
+
+        writeLittle(out, (uint32_t)config.bet, 4);
+        writeLittle(out, (uint32_t)player.bet, 4);
+        out.put((char)script.actionCount);
+        out.write((const char*)script.recorded, script.actionCount);
+    }
+
+    uint64_t shoeOffset = (uint64_t)out.tellp();
+    uint32_t shoeCount = (uint32_t)(shoes.size() / shoe.cards.size());
+
+    out.write((const char*)shoes.data(), shoes.size());
+    out.seekp(28);
+    writeLittle(out, shoeCount, 4);
+    writeLittle(out, stats.rounds, 8);
+    writeLittle(out, shoeOffset, 8);
+    out.close();
+    if (!out)
+    {
+        cerr << "Unable to write " << argv[1] << endl;
+        return 1;
+    }
+
+    cout << "Recorded " << stats.rounds << " rounds over " << shoeCount
+        << " shoes, net tokens " << stats.net << endl;
+    return 0;
+}
+
+/** **********************************************************************
+ * @brief Opens a history file and checks its layout and cards.
+ *
+ * @param[in] fileName The history file.
+ * @param[out] history The history, which refers to the mapped file.
+ *
+ * @returns `true` if the file is a complete history.
+ *
+ * @par Example
+ * @code{.cpp}
+ * History history;
+ * loadHistory("session.bjh", history);
+ * @endcode
+ ************************************************************************/
+bool loadHistory(const string& fileName, History& history)
+{
+    if (!mapFile(fileName, history.file))
+        return false;
+
+    const unsigned char* data = history.file.data;
+    size_t size = history.file.size;
+
+    if (size < HISTORY_HEADER_BYTES
+        || memcmp(data, HISTORY_MAGIC, sizeof(HISTORY_MAGIC)) != 0
+        || readLittle(data + 8, 4) != HISTORY_VERSION)
+        return false;
+
+    uint64_t decks = readLittle(data + 12, 4);
+    uint64_t rules = readLittle(data + 16, 4);
+    uint64_t cutCard = readLittle(data + 20, 4);
+    uint64_t bankroll = readLittle(data + 24, 4);
+    uint64_t shoeCount = readLittle(data + 28, 4);
+    uint64_t shoeOffset = readLittle(data + 40, 8);
+
+    if (decks < 1 || decks > 8 || rules >= RULE_VARIANTS || cutCard < 4
+        || cutCard > 52 * decks || bankroll > INT32_MAX || shoeCount < 1
+        || shoeOffset < HISTORY_HEADER_BYTES || shoeOffset > size
+        || (size - shoeOffset) != shoeCount * 52 * decks)
+        return false;
+
+    history.decks = (int)decks;
+    history.rules = (int)rules;
+    history.cutCard = (int)cutCard;
+    history.bankroll = (int)bankroll;
+    history.shoeCount = (uint32_t)shoeCount;
+    history.roundCount = readLittle(data + 32, 8);
+    history.rounds = data + HISTORY_HEADER_BYTES;
+    history.roundBytes = shoeOffset - HISTORY_HEADER_BYTES;
+    history.shoes = data + shoeOffset;
+
+    for (size_t i = shoeOffset; i < size; i++)
+        if ((data[i] & 15) < 1 || (data[i] & 15) > 13 || data[i] >> 4 > 3)
+            return false;
+    return true;
+}
+
+/** **********************************************************************
+ * @brief Deals the next recorded shoe in place of a shuffle.
+ *
+ * @details The deal position, running count and composition are reset as
+ *          shuffleShoe() does. Once every recorded shoe has been dealt the
+ *          cards are left as they are and only the shoe index moves on,
+ *          which tells the replay that the history has run out.
+ *
+ * @param[in,out] shoe The shoe replaying a history.
+ *
+ * @par Example
+ * @code{.cpp}
+ * loadRecordedShoe(shoe);
+ * @endcode
+ ************************************************************************/
+void loadRecordedShoe(Shoe& shoe)
+{
+    int size = (int)shoe.cards.size();
+
+    if (shoe.nextShoe < shoe.recordedShoes)
+    {
+        const unsigned char* cards = shoe.recorded
+            + (size_t)shoe.nextShoe * size;
+
+        for (int i = 0; i < size; i++)
+        {
+            shoe.cards[i].faceValue = cards[i] & 15;
+            shoe.cards[i].suit = cards[i] >> 4;
+        }
+    }
+
+    shoe.nextShoe++;
+    shoe.position = 0;
+    shoe.runningCount = 0;
+    fillComposition(shoe.composition, shoe.decks);
+}
+
+/** **********************************************************************
+ * @brief Reads a bet ramp from a command line argument.
+ *
+ * @details The ramp is a comma-separated list of "count:bet" steps in
+ *          rising count order, such as "1:10,2:20,3:40,4:80". Each bet
+ *          applies from its true count up to the next step, and the first
+ *          bet also applies below its count. A single bet with no count
+ *          is a flat bet. Bets follow the same rules as `--bet`.
+ *
+ * @param[in] text The argument text.
+ * @param[out] ramp The ramp.
+ *
+ * @returns `true` if the ramp is valid.
+ *
+ * @par Example
+ * @code{.cpp}
+ * BetRamp ramp;
+ * parseBetRamp("1:10,2:20,3:40", ramp);
+ * @endcode
+ ************************************************************************/
+bool parseBetRamp(const char* text, BetRamp& ramp)
+{
+    istringstream in(text);
+    string step;
+    int previous = TC_MIN - 1;
+    bool first = true;
+
+    while (getline(in, step, ','))
+    {
+        size_t colon = step.find(':');
+        string count = colon == string::npos ? to_string(TC_MIN)
+            : step.substr(0, colon);
+        string betText = colon == string::npos ? step
+            : step.substr(colon + 1);
+        char* end = nullptr;
+        long trueCount = strtol(count.c_str(), &end, 10);
+        uint64_t bet;
+
+        if (count.empty() || *end != '\0' || trueCount <= previous
+            || trueCount > TC_MAX || (colon == string::npos && !first)
+            || !parseCount(betText.c_str(), bet) || bet < 10
+            || bet % 10 != 0 || bet > 100000)
+            return false;
+
+        for (int b = first ? 0 : (int)trueCount - TC_MIN; b < TC_BUCKETS;
+            b++)
+            ramp.bets[b] = (int)bet;
+        previous = (int)trueCount;
+        first = false;
+    }
+    return !first;
+}
+
+/** **********************************************************************
+ * @brief Returns the bet a ramp places on the next round of a shoe.
+ *
+ * @details The bet follows trueCountBucket(), except that a shoe that
+ *          is about to be reshuffled counts as a fresh shoe.
+ *
+ * @param[in] ramp The bet ramp.
+ * @param[in] shoe The shoe the round is dealt from.
+ *
+ * @returns The bet.
+ *
+ * @par Example
+ * @code{.cpp}
+ * int bet = rampBet(candidate.ramp, shoe);
+ * @endcode
+ ************************************************************************/
+int rampBet(const BetRamp& ramp, const Shoe& shoe)
+{
+    if (shoe.position >= shoe.cutCard)
+        return ramp.bets[-TC_MIN];
+    return ramp.bets[trueCountBucket(shoe)];
+}
+
+/** **********************************************************************
+ * @brief Replays a whole history under one candidate.
+ *
+ * @details The candidate's shoe deals the recorded shoes in order, and its
+ *          rounds are played by simulateRound() exactly as in a
+ *          simulation, so a reshuffle simply moves on to the next recorded
+ *          shoe. A candidate that replays the original choices plays every
+ *          recorded round and checks its net result. Any other candidate
+ *          plays until the last shoe reaches its cut card; a round that
+ *          would need more cards than the history holds is not counted.
+ *
+ * @param[in] history The history, which is only read.
+ * @param[in,out] candidate The candidate, whose totals are filled in.
+ *
+ * @par Example
+ * @code{.cpp}
+ * replayHistory(history, candidates[0]);
+ * @endcode
+ ************************************************************************/
+void replayHistory(const History& history, WhatIfCandidate& candidate)
+{
+    Shoe shoe(history.decks, 1.0);
+    mt19937_64 engine; // Never drawn from, since every shuffle is recorded
+    Player player(history.bankroll);
+    RoundScript script;
+    size_t offset = 0;
+
+    shoe.cutCard = history.cutCard;
+    shoe.recorded = history.shoes;
+    shoe.recordedShoes = history.shoeCount;
+    shuffleShoe(shoe, engine);
+
+    for (uint64_t round = 1; candidate.problem.empty(); round++)
+    {
+        int bet = 0;
+        int expected = 0;
+        SimStats roundStats;
+
+        if (candidate.recordedChoices)
+        {
+            if (round > history.roundCount)
+                break;
+            if (history.roundBytes - offset < HISTORY_ROUND_BYTES
+                || history.roundBytes - offset - HISTORY_ROUND_BYTES
+                < history.rounds[offset + 8])
+            {
+                candidate.problem = "the file ends early";
+                break;
+            }
+
+            const unsigned char* record = history.rounds + offset;
+
+            bet = (int)readLittle(record, 4);
+            expected = (int)(int32_t)readLittle(record + 4, 4);
+            script.actions = record + HISTORY_ROUND_BYTES;
+            script.actionCount = record[8];
+            script.nextAction = 0;
+            script.failed = false;
+            offset += HISTORY_ROUND_BYTES + script.actionCount;
+
+            if (bet < 10 || bet % 10 != 0 || bet > 100000)
+                candidate.problem = "the bet is invalid";
+        }
+        else
+        {
+            if (shoe.position >= shoe.cutCard
+                && shoe.nextShoe >= shoe.recordedShoes)
+                break;
+            bet = rampBet(candidate.ramp, shoe);
+        }
+
+        if (!candidate.problem.empty())
+            break;
+
+        simulateRound(shoe, engine, player, candidate.strategy, bet,
+            history.rules, roundStats, nullptr,
+            candidate.recordedChoices ? &script : nullptr);
+
+        if (shoe.nextShoe > shoe.recordedShoes)
+        {
+            if (candidate.recordedChoices)
+                candidate.problem = "the recorded shoes run out";
+            break;
+        }
+        if (candidate.recordedChoices && (script.failed
+            || script.nextAction != script.actionCount))
+            candidate.problem = "the recorded choices do not fit the cards";
+        else if (candidate.recordedChoices && player.bet != expected)
+            candidate.problem = "expected a net of " + to_string(expected)
+                + ", got " + to_string(player.bet);
+
+        if (!candidate.problem.empty())
+            candidate.problem = "round " + to_string(round) + ": "
+                + candidate.problem;
+        else
+            mergeStats(candidate.stats, roundStats);
+    }
+}
+
+/** **********************************************************************
+ * @brief Replays the history under candidates until none are left.
+ *
+ * @details Every worker reads the same mapped history, and takes the next
+ *          candidate from a shared counter, so long and short replays
+ *          balance out across the threads.
+ *
+ * @param[in] history The history, which is only read.
+ * @param[in,out] candidates Every candidate.
+ * @param[in,out] next Index of the next candidate to replay.
+ *
+ * @par Example
+ * @code{.cpp}
+ * atomic<size_t> next(0);
+ * runWhatIfWorker(history, candidates, next);
+ * @endcode
+ ************************************************************************/
+void runWhatIfWorker(const History& history,
+    vector<WhatIfCandidate>& candidates, atomic<size_t>& next)
+{
+    for (size_t c = next++; c < candidates.size(); c = next++)
+        replayHistory(history, candidates[c]);
+}
+
+/** **********************************************************************
+ * @brief Runs the whatif command, which replays a history under each
+ *        candidate strategy and bet ramp and compares the results.
+ *
+ * @details Each `--chart` starts a new candidate that plays the given
+ *          chart file (or "basic") with the flat bet of the original
+ *          session, and a `--ramp` after it bets by the true count
+ *          instead. The original bets and choices are always replayed
+ *          first, which checks the history and gives the row every
+ *          candidate is compared with.
+ *
+ * @param[in] argc The number of arguments after the program name.
+ * @param[in] argv The arguments, starting with the command word.
+ *
+ * @returns 0 if every candidate was replayed, 1 if the arguments or the
+ *          history were invalid.
+ *
+ * @par Example
+ * @code{.cpp}
+ * return runWhatIfCommand(argc - 1, argv + 1);
+ * @endcode
+ ************************************************************************/
+int runWhatIfCommand(int argc, char* argv[])
+{
+    SimConfig config;
+    History history;
+    vector<WhatIfCandidate> candidates(1);
+    vector<thread> threads;
+    atomic<size_t> next(0);
+    string fileName;
+
+    candidates[0].name = "recorded";
+    candidates[0].recordedChoices = true;
+    basicStrategy(candidates[0].strategy);
+
+    for (int i = 1; i < argc; i++)
+    {
+        string option = argv[i];
+
+        if (option.compare(0, 2, "--") != 0 && fileName.empty())
+        {
+            fileName = option;
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            printUsage();
+            return 1;
+        }
+
+        const char* value = argv[++i];
+
+        if (option == "--threads" && parseSimOption(option, value, config))
+            continue;
+        else if (option == "--chart")
+        {
+            candidates.emplace_back();
+            candidates.back().name = value;
+            if (!loadStrategyChart(value, candidates.back().strategy))
+            {
+                cerr << "Unable to read chart " << value << endl;
+                return 1;
+            }
+        }
+        else if (option == "--ramp" && candidates.size() > 1
+            && parseBetRamp(value, candidates.back().ramp))
+            candidates.back().name += string(" ramp ") + value;
+        else
+        {
+            cerr << "Invalid option: " << option << " " << value << endl;
+            return 1;
+        }
+    }
+
+    if (fileName.empty())
+    {
+        printUsage();
+        return 1;
+    }
+
+    if (!loadHistory(fileName, history))
+    {
+        cerr << fileName << " is not a readable history file" << endl;
+        unmapFile(history.file);
+        return 1;
+    }
+
+    if (candidates.size() == 1)
+    {
+        candidates.emplace_back();
+        candidates.back().name = "basic";
+        basicStrategy(candidates.back().strategy);
+    }
+
+    // Candidates without a ramp bet what the original player bet
+    int flatBet = history.roundBytes >= 4
+        ? (int)readLittle(history.rounds, 4) : 10;
+    for (WhatIfCandidate& candidate : candidates)
+        if (candidate.ramp.bets[0] == 0)
+            candidate.ramp = BetRamp(flatBet);
+
+    auto start = chrono::steady_clock::now();
+    int workers = (int)min<size_t>(config.threads, candidates.size());
+
+    for (int t = 0; t < workers; t++)
+        threads.emplace_back(runWhatIfWorker, cref(history), ref(candidates),
+            ref(next));
+    for (thread& worker : threads)
+        worker.join();
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now()
+        - start).count();
+    unmapFile(history.file);
+
+    if (!candidates[0].problem.empty())
+    {
+        cerr << "The recorded choices failed at " << candidates[0].problem
+            << endl;
+        return 1;
+    }
+
+    size_t width = 9;
+    for (const WhatIfCandidate& candidate : candidates)
+        width = max(width, candidate.name.size());
+
+    const SimStats& original = candidates[0].stats;
+
+    cout << "History: " << original.rounds << " rounds over "
+        << history.shoeCount << " shoes of " << history.decks
+        << " decks, dealer " << (history.rules == RULES_H17 ? "hits"
+        : "stands on") << " soft 17\n";
+    cout << left << setw(width) << "Candidate" << right << setw(10)
+        << "Rounds" << setw(13) << "Wagered" << setw(11) << "Net"
+        << setw(10) << "Edge %" << setw(9) << "+/- %" << setw(13)
+        << "vs recorded" << "\n";
+    cout << fixed << setprecision(4);
+    for (const WhatIfCandidate& candidate : candidates)
+        cout << left << setw(width) << candidate.name << right << setw(10)
+            << candidate.stats.rounds << setw(13) << candidate.stats.wagered
+            << setw(11) << candidate.stats.net << setw(10)
+            << houseEdge(candidate.stats) << setw(9)
+            << edgeMargin(candidate.stats) << setw(13) << showpos
+            << candidate.stats.net - original.net << noshowpos << "\n";
+    cout << setprecision(3) << "Replayed " << candidates.size()
+        << " candidates in " << seconds << " s" << endl;
+    cout.unsetf(ios::floatfield);
+    return 0;
+}